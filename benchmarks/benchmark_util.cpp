@@ -0,0 +1,167 @@
+#include "benchmark_util.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <format>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> allocations{0};
+}  // namespace
+
+// Counted rather than timed, so that a change which saves allocations shows
+// up even when the allocator is fast enough to hide it.  new[] goes through
+// this one too.
+// NOLINTBEGIN
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t /*size*/) noexcept {
+  std::free(ptr);
+}
+// NOLINTEND
+
+uint64_t Allocations() {
+  return allocations.load(std::memory_order_relaxed);
+}
+
+void ReportPerCall(benchmark::State& state, std::size_t bytes,
+                   uint64_t allocations_made) {
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+  if (bytes != 0) {
+    state.counters["time_per_byte"] = benchmark::Counter(
+        static_cast<double>(bytes),
+        benchmark::Counter::kIsIterationInvariantRate |
+            benchmark::Counter::kInvert);
+  }
+  state.counters["allocs_per_call"] =
+      benchmark::Counter(static_cast<double>(allocations_made),
+                         benchmark::Counter::kAvgIterations);
+}
+
+std::string ServiceRootPayload() {
+  return R"({
+  "@odata.id": "/redfish/v1",
+  "@odata.type": "#ServiceRoot.v1_15_0.ServiceRoot",
+  "AccountService": {"@odata.id": "/redfish/v1/AccountService"},
+  "CertificateService": {"@odata.id": "/redfish/v1/CertificateService"},
+  "Chassis": {"@odata.id": "/redfish/v1/Chassis"},
+  "EventService": {"@odata.id": "/redfish/v1/EventService"},
+  "Id": "RootService",
+  "JsonSchemas": {"@odata.id": "/redfish/v1/JsonSchemas"},
+  "Links": {
+    "ManagerProvidingService": {"@odata.id": "/redfish/v1/Managers/bmc"},
+    "Sessions": {"@odata.id": "/redfish/v1/SessionService/Sessions"}
+  },
+  "Managers": {"@odata.id": "/redfish/v1/Managers"},
+  "Name": "Root Service",
+  "ProtocolFeaturesSupported": {
+    "DeepOperations": {"DeepPATCH": false, "DeepPOST": false},
+    "ExcerptQuery": false,
+    "ExpandQuery": {
+      "ExpandAll": true,
+      "Levels": true,
+      "Links": true,
+      "MaxLevels": 6,
+      "NoLinks": true
+    },
+    "FilterQuery": false,
+    "OnlyMemberQuery": true,
+    "SelectQuery": true
+  },
+  "RedfishVersion": "1.17.0",
+  "Registries": {"@odata.id": "/redfish/v1/Registries"},
+  "SessionService": {"@odata.id": "/redfish/v1/SessionService"},
+  "Systems": {"@odata.id": "/redfish/v1/Systems"},
+  "Tasks": {"@odata.id": "/redfish/v1/TaskService"},
+  "TelemetryService": {"@odata.id": "/redfish/v1/TelemetryService"},
+  "UUID": "6a1a3e5e-7c0f-4f5e-9d3b-2f6a8f3c1b2d",
+  "UpdateService": {"@odata.id": "/redfish/v1/UpdateService"}
+})";
+}
+
+std::string SensorCollectionPayload(int64_t sensors) {
+  std::string payload = R"({
+  "@odata.id": "/redfish/v1/Chassis/chassis/Sensors",
+  "@odata.type": "#SensorCollection.SensorCollection",
+  "Description": "Collection of Sensors for this Chassis",
+  "Members": [)";
+  for (int64_t i = 0; i < sensors; i++) {
+    if (i != 0) {
+      payload += ",";
+    }
+    payload += std::format(
+        R"(
+    {{
+      "@odata.id": "/redfish/v1/Chassis/chassis/Sensors/temperature_{0}",
+      "@odata.type": "#Sensor.v1_2_0.Sensor",
+      "Id": "temperature_{0}",
+      "Name": "Temp {0}",
+      "Reading": {1}.{2},
+      "ReadingRangeMax": 127.0,
+      "ReadingRangeMin": -128.0,
+      "ReadingType": "Temperature",
+      "ReadingUnits": "Cel",
+      "Status": {{"Health": "OK", "State": "Enabled"}},
+      "Thresholds": {{
+        "LowerCaution": {{"Reading": 5.0}},
+        "LowerCritical": {{"Reading": 0.0}},
+        "UpperCaution": {{"Reading": 80.0}},
+        "UpperCritical": {{"Reading": 95.0}}
+      }}
+    }})",
+        i, 20 + i % 50, i % 10);
+  }
+  payload += std::format(R"(
+  ],
+  "Members@odata.count": {},
+  "Name": "Sensors"
+}})",
+                         sensors);
+  return payload;
+}
+
+std::string LogEntriesPayload(int64_t entries) {
+  std::string payload = R"({
+  "@odata.id": "/redfish/v1/Systems/system/LogServices/EventLog/Entries",
+  "@odata.type": "#LogEntryCollection.LogEntryCollection",
+  "Description": "Collection of System Event Log Entries",
+  "Members": [)";
+  for (int64_t i = 0; i < entries; i++) {
+    if (i != 0) {
+      payload += ",";
+    }
+    payload += std::format(
+        R"(
+    {{
+      "@odata.id": "/redfish/v1/Systems/system/LogServices/EventLog/Entries/{0}",
+      "@odata.type": "#LogEntry.v1_9_0.LogEntry",
+      "Created": "2024-03-{1:02}T{2:02}:{3:02}:{4:02}+00:00",
+      "EntryType": "Event",
+      "Id": "{0}",
+      "Message": "Sensor temperature_{5} reading {6}.0 exceeds upper caution threshold 80.0.",
+      "MessageArgs": ["temperature_{5}", "{6}.0", "80.0"],
+      "MessageId": "OpenBMC.0.1.SensorThresholdWarningHigh",
+      "Name": "System Event Log Entry",
+      "Resolution": "None.",
+      "Severity": "Warning"
+    }})",
+        i, 1 + i % 28, i % 24, i % 60, (i * 7) % 60, i % 64, 80 + i % 15);
+  }
+  payload += std::format(R"(
+  ],
+  "Members@odata.count": {0},
+  "Members@odata.nextLink": "/redfish/v1/Systems/system/LogServices/EventLog/Entries?$skip={0}",
+  "Name": "System Event Log Entries"
+}})",
+                         entries);
+  return payload;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Heap allocations made by the process so far, counted by the operator new
+// that benchmark_util.cpp replaces
+uint64_t Allocations();
+
+// Reports bytes per second, time per byte and allocations per call for a
+// benchmark that handles bytes of input each iteration, and made
+// allocations over all of its iterations
+void ReportPerCall(benchmark::State& state, std::size_t bytes,
+                   uint64_t allocations);
+
+// Payloads shaped like what a BMC sends.  Sensors and log entries are
+// expanded inline, the way a service answers $expand, or a log page.
+std::string ServiceRootPayload();
+std::string SensorCollectionPayload(int64_t sensors);
+std::string LogEntriesPayload(int64_t entries);
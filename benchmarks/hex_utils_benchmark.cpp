@@ -0,0 +1,63 @@
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.hpp"
+#include "hex_utils.hpp"
+
+namespace {
+
+std::vector<uint8_t> MakeBytes(int64_t size) {
+  std::vector<uint8_t> bytes(static_cast<std::size_t>(size));
+  for (std::size_t i = 0; i < bytes.size(); i++) {
+    bytes[i] = static_cast<uint8_t>(i * 37);
+  }
+  return bytes;
+}
+
+void BmIntToHexString(benchmark::State& state) {
+  std::size_t digits = static_cast<std::size_t>(state.range(0));
+  uint64_t value = 0x0123456789ABCDEF;
+  uint64_t allocations = Allocations();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(IntToHexString(value, digits));
+  }
+  // Measured per digit written, as the value is always the one word
+  ReportPerCall(state, digits, Allocations() - allocations);
+}
+
+void BmBytesToHexString(benchmark::State& state) {
+  std::vector<uint8_t> bytes = MakeBytes(state.range(0));
+  uint64_t allocations = Allocations();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(BytesToHexString(bytes));
+  }
+  ReportPerCall(state, bytes.size(), Allocations() - allocations);
+}
+
+void BmHexStringToBytes(benchmark::State& state) {
+  std::string hex = BytesToHexString(MakeBytes(state.range(0)));
+  uint64_t allocations = Allocations();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(HexStringToBytes(hex));
+  }
+  ReportPerCall(state, hex.size(), Allocations() - allocations);
+}
+
+}  // namespace
+
+// Register widths, then buffers from a GUID up to a firmware chunk
+BENCHMARK(BmIntToHexString)->Arg(2)->Arg(8)->Arg(16);
+BENCHMARK(BmBytesToHexString)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK(BmHexStringToBytes)->Arg(16)->Arg(256)->Arg(4096);
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::info);
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
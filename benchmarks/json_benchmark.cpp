@@ -0,0 +1,75 @@
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+
+#include <boost/json.hpp>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+#include "benchmark_util.hpp"
+#include "json.hpp"
+
+namespace {
+
+// Throws away whatever's written to it, so only the printing is measured
+class NullBuffer : public std::streambuf {
+ protected:
+  int_type overflow(int_type ch) override { return ch; }
+  std::streamsize xsputn(const char_type* /*s*/,
+                         std::streamsize count) override {
+    return count;
+  }
+};
+
+void PrettyPrintPayload(benchmark::State& state, const std::string& payload) {
+  boost::json::value value = boost::json::parse(payload);
+  NullBuffer buffer;
+  std::ostream os(&buffer);
+  uint64_t allocations = Allocations();
+  for (auto _ : state) {
+    PrettyPrint(os, value);
+  }
+  ReportPerCall(state, payload.size(), Allocations() - allocations);
+}
+
+// boost::json's own serializer, as a baseline for PrettyPrint
+void SerializePayload(benchmark::State& state, const std::string& payload) {
+  boost::json::value value = boost::json::parse(payload);
+  uint64_t allocations = Allocations();
+  for (auto _ : state) {
+    std::string out = boost::json::serialize(value);
+    benchmark::DoNotOptimize(out);
+  }
+  ReportPerCall(state, payload.size(), Allocations() - allocations);
+}
+
+void BmPrettyPrintServiceRoot(benchmark::State& state) {
+  PrettyPrintPayload(state, ServiceRootPayload());
+}
+
+void BmPrettyPrintSensorCollection(benchmark::State& state) {
+  PrettyPrintPayload(state, SensorCollectionPayload(state.range(0)));
+}
+
+void BmPrettyPrintLogEntries(benchmark::State& state) {
+  PrettyPrintPayload(state, LogEntriesPayload(state.range(0)));
+}
+
+void BmSerializeSensorCollection(benchmark::State& state) {
+  SerializePayload(state, SensorCollectionPayload(state.range(0)));
+}
+
+}  // namespace
+
+BENCHMARK(BmPrettyPrintServiceRoot);
+BENCHMARK(BmPrettyPrintSensorCollection)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK(BmPrettyPrintLogEntries)->Arg(100)->Arg(1000);
+BENCHMARK(BmSerializeSensorCollection)->Arg(16)->Arg(256)->Arg(4096);
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::info);
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
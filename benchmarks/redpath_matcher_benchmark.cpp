@@ -0,0 +1,187 @@
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+
+#include <boost/json/basic_parser_impl.hpp>
+#include <format>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.hpp"
+#include "path_parser.hpp"
+#include "redpath_parser.hpp"
+
+namespace {
+
+// The matching strategy RedpathParser used before redpaths were compiled:
+// every string value is compared against every redpath, building the
+// candidate key for each comparison.  Kept here as a baseline.
+// NOLINTBEGIN
+struct LinearHandler {
+  std::vector<redfish::filter_ast::path> redpaths;
+  std::size_t matches = 0;
+  std::string current_key = "/";
+  std::string current_value;
+  constexpr static std::size_t max_object_size = std::size_t(-1);
+  constexpr static std::size_t max_array_size = std::size_t(-1);
+  constexpr static std::size_t max_key_size = std::size_t(-1);
+  constexpr static std::size_t max_string_size = std::size_t(-1);
+
+  explicit LinearHandler(std::vector<redfish::filter_ast::path>&& redpaths_in)
+      : redpaths(std::move(redpaths_in)) {}
+
+  void pop_value() {
+    current_key = current_key.substr(0, current_key.rfind('/'));
+    current_key = current_key.substr(0, current_key.rfind('/') + 1);
+  }
+  static bool on_document_begin(std::error_code&) { return true; }
+  static bool on_document_end(std::error_code&) { return true; }
+  static bool on_object_begin(std::error_code&) { return true; }
+  bool on_object_end(std::size_t, std::error_code&) {
+    pop_value();
+    return true;
+  }
+  static bool on_array_begin(std::error_code&) { return true; }
+  static bool on_array_end(std::size_t, std::error_code&) { return true; }
+  bool on_key_part(std::string_view key, std::size_t, std::error_code&) {
+    current_key += key;
+    return true;
+  }
+  bool on_key(std::string_view key, std::size_t size, std::error_code& ec) {
+    on_key_part(key, size, ec);
+    current_key += "/";
+    return true;
+  }
+  bool on_string_part(std::string_view str, std::size_t, std::error_code&) {
+    current_value += str;
+    return true;
+  }
+  bool on_string(std::string_view str, std::size_t size, std::error_code& ec) {
+    on_string_part(str, size, ec);
+    for (const redfish::filter_ast::path& redpath : redpaths) {
+      if (const redfish::filter_ast::key_name* match =
+              std::get_if<redfish::filter_ast::key_name>(&redpath.first)) {
+        if ("/" + match->str() + "/@odata.id/" == current_key) {
+          matches++;
+          break;
+        }
+      }
+      if (const redfish::filter_ast::key_filter* path =
+              std::get_if<redfish::filter_ast::key_filter>(&redpath.first)) {
+        if ("/" + path->key + "/@odata.id/" == current_key) {
+          matches++;
+        }
+      }
+    }
+    pop_value();
+    current_value = "";
+    return true;
+  }
+  bool on_bool(bool, std::error_code&) {
+    pop_value();
+    return true;
+  }
+  static bool on_number_part(std::string_view, std::error_code&) {
+    return true;
+  }
+  bool on_int64(std::int64_t, std::string_view, std::error_code&) {
+    pop_value();
+    return true;
+  }
+  bool on_uint64(std::uint64_t, std::string_view, std::error_code&) {
+    pop_value();
+    return true;
+  }
+  bool on_double(double, std::string_view, std::error_code&) {
+    pop_value();
+    return true;
+  }
+  bool on_null(std::error_code&) {
+    pop_value();
+    return true;
+  }
+  static bool on_comment_part(std::string_view, std::error_code&) {
+    return false;
+  }
+  static bool on_comment(std::string_view, std::error_code&) { return false; }
+};
+// NOLINTEND
+
+// A resource with the given number of link properties, each carrying a few
+// scalar siblings the way real Redfish resources do
+std::string MakePayload(int64_t properties) {
+  std::string payload = "{";
+  for (int64_t i = 0; i < properties; i++) {
+    if (i != 0) {
+      payload += ",";
+    }
+    payload += std::format(
+        R"("Prop{0}": {{"@odata.id": "/redfish/v1/Prop{0}"}},)"
+        R"("Name{0}": "Property {0}", "Reading{0}": {0}.5)",
+        i);
+  }
+  payload += "}";
+  return payload;
+}
+
+std::vector<redfish::filter_ast::path> MakeRedpaths(int64_t count) {
+  std::vector<redfish::filter_ast::path> redpaths;
+  for (int64_t i = 0; i < count; i++) {
+    redpaths.push_back(*parseRedfishPath(std::format("Prop{}", i * 2)));
+  }
+  return redpaths;
+}
+
+void BmLinearMatch(benchmark::State& state) {
+  std::string payload = MakePayload(state.range(1));
+  std::vector<redfish::filter_ast::path> redpaths =
+      MakeRedpaths(state.range(0));
+  uint64_t allocations = Allocations();
+  for (auto _ : state) {
+    boost::json::basic_parser<LinearHandler> parser(
+        boost::json::parse_options(),
+        std::vector<redfish::filter_ast::path>(redpaths));
+    boost::system::error_code ec;
+    parser.write_some(false, payload.data(), payload.size(), ec);
+    benchmark::DoNotOptimize(parser.handler().matches);
+  }
+  ReportPerCall(state, payload.size(), Allocations() - allocations);
+}
+
+void BmCompiledMatch(benchmark::State& state) {
+  std::string payload = MakePayload(state.range(1));
+  std::vector<redfish::filter_ast::path> redpaths =
+      MakeRedpaths(state.range(0));
+  uint64_t allocations = Allocations();
+  for (auto _ : state) {
+    std::size_t matches = 0;
+    RedpathParser parser(std::vector<redfish::filter_ast::path>(redpaths),
+                         [&matches](RedpathMatch&&) { matches++; });
+    boost::system::error_code ec;
+    parser.Write(payload.data(), payload.size(), ec);
+    parser.Finish(ec);
+    benchmark::DoNotOptimize(matches);
+  }
+  ReportPerCall(state, payload.size(), Allocations() - allocations);
+}
+
+// {number of redpaths, number of properties in the payload}
+void MatchArgs(benchmark::internal::Benchmark* b) {
+  for (int64_t redpaths : {1, 16, 256}) {
+    for (int64_t properties : {16, 256, 4096}) {
+      b->Args({redpaths, properties});
+    }
+  }
+}
+
+}  // namespace
+
+BENCHMARK(BmLinearMatch)->Apply(MatchArgs);
+BENCHMARK(BmCompiledMatch)->Apply(MatchArgs);
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::info);
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
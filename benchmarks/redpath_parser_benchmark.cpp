@@ -0,0 +1,104 @@
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+
+#include <boost/json.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmark_util.hpp"
+#include "path_parser.hpp"
+#include "redpath_parser.hpp"
+
+namespace {
+
+std::vector<redfish::filter_ast::path> ParseRedpaths(
+    const std::vector<std::string_view>& redpaths) {
+  std::vector<redfish::filter_ast::path> parsed;
+  for (std::string_view redpath : redpaths) {
+    parsed.push_back(*parseRedfishPath(redpath));
+  }
+  return parsed;
+}
+
+// Matches redpaths against payload the way a query reads each response
+void MatchPayload(benchmark::State& state, const std::string& payload,
+                  const std::vector<std::string_view>& redpaths) {
+  std::vector<redfish::filter_ast::path> parsed = ParseRedpaths(redpaths);
+  uint64_t allocations = Allocations();
+  for (auto _ : state) {
+    std::size_t matches = 0;
+    RedpathParser parser(std::vector<redfish::filter_ast::path>(parsed),
+                         [&matches](RedpathMatch&&) { matches++; });
+    boost::system::error_code ec;
+    parser.Write(payload.data(), payload.size(), ec);
+    parser.Finish(ec);
+    benchmark::DoNotOptimize(matches);
+  }
+  ReportPerCall(state, payload.size(), Allocations() - allocations);
+}
+
+void BmMatchServiceRoot(benchmark::State& state) {
+  MatchPayload(state, ServiceRootPayload(),
+               {"Chassis[*]/Sensors[*]/Reading", "Systems[*]/PowerState",
+                "Managers[*]/FirmwareVersion"});
+}
+
+void BmMatchSensorCollection(benchmark::State& state) {
+  MatchPayload(state, SensorCollectionPayload(state.range(0)),
+               {"Members[*]/Reading", "Members[*]/Status/Health"});
+}
+
+void BmMatchLogEntries(benchmark::State& state) {
+  MatchPayload(state, LogEntriesPayload(state.range(0)),
+               {"Members[*]/Message", "Members[*]/Severity"});
+}
+
+// Reading the whole document into a DOM, as a baseline for what streaming
+// it through RedpathParser saves
+void BmParseDom(benchmark::State& state) {
+  std::string payload = SensorCollectionPayload(state.range(0));
+  uint64_t allocations = Allocations();
+  for (auto _ : state) {
+    boost::json::value value = boost::json::parse(payload);
+    benchmark::DoNotOptimize(value);
+  }
+  ReportPerCall(state, payload.size(), Allocations() - allocations);
+}
+
+void BmParseRedfishPath(benchmark::State& state) {
+  std::vector<std::string_view> redpaths = {
+      "Chassis",
+      "Chassis[*]",
+      "Chassis[*]/Sensors[*]/Reading",
+      "Systems[*]/Processors[*]/Status/Health",
+      "Managers[*]/EthernetInterfaces[*]/IPv4Addresses",
+  };
+  std::size_t bytes = 0;
+  for (std::string_view redpath : redpaths) {
+    bytes += redpath.size();
+  }
+  uint64_t allocations = Allocations();
+  for (auto _ : state) {
+    for (std::string_view redpath : redpaths) {
+      benchmark::DoNotOptimize(parseRedfishPath(redpath));
+    }
+  }
+  ReportPerCall(state, bytes, Allocations() - allocations);
+}
+
+}  // namespace
+
+BENCHMARK(BmMatchServiceRoot);
+BENCHMARK(BmMatchSensorCollection)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK(BmMatchLogEntries)->Arg(100)->Arg(1000);
+BENCHMARK(BmParseDom)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK(BmParseRedfishPath);
+
+int main(int argc, char** argv) {
+  spdlog::set_level(spdlog::level::info);
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <memory>
+#include <utility>
+
+namespace http {
+
+// Adapts an asio completion handler to the std::function style callbacks
+// used by Client and RedpathQuery, so that they can be driven by any
+// completion token, including boost::asio::use_awaitable.  The handler is run
+// on its associated executor (or executor, if it has none) with the callback's
+// argument, as a Result.
+template <typename Result, typename Handler, typename Executor>
+auto BindHandler(Handler&& handler, const Executor& executor) {
+  // Completion handlers are move only, and std::function needs to copy
+  auto shared = std::make_shared<std::decay_t<Handler> >(
+      std::forward<Handler>(handler));
+  return [shared, executor](auto&& result) {
+    auto handler_executor =
+        boost::asio::get_associated_executor(*shared, executor);
+    boost::asio::dispatch(
+        handler_executor,
+        [shared,
+         result = Result(std::forward<decltype(result)>(result))]() mutable {
+          std::move(*shared)(std::move(result));
+        });
+  };
+}
+
+}  // namespace http
@@ -0,0 +1,61 @@
+#include "async_handler.hpp"
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <functional>
+#include <memory>
+
+#include "gmock/gmock.h"
+
+namespace {
+
+// An operation built the way Client and RedpathQuery build theirs: on top of
+// a std::function callback that's called later from the io_context
+template <typename CompletionToken>
+auto AsyncDouble(boost::asio::io_context& ioc, int value,
+                 CompletionToken&& token) {
+  return boost::asio::async_initiate<CompletionToken,
+                                     void(std::unique_ptr<int>)>(
+      [&ioc](auto handler, int value) {
+        std::function<void(std::unique_ptr<int>&&)> callback =
+            http::BindHandler<std::unique_ptr<int> >(std::move(handler),
+                                                     ioc.get_executor());
+        boost::asio::post(ioc, [callback, value]() {
+          callback(std::make_unique<int>(value * 2));
+        });
+      },
+      token, value);
+}
+
+TEST(BindHandler, CompletesCallbacks) {
+  boost::asio::io_context ioc;
+  int result = 0;
+  AsyncDouble(ioc, 21, [&result](std::unique_ptr<int> value) {
+    result = *value;
+  });
+  ioc.run();
+  EXPECT_EQ(result, 42);
+}
+
+TEST(BindHandler, ResumesCoroutines) {
+  boost::asio::io_context ioc;
+  int result = 0;
+  boost::asio::co_spawn(
+      ioc,
+      [&ioc, &result]() -> boost::asio::awaitable<void> {
+        std::unique_ptr<int> first =
+            co_await AsyncDouble(ioc, 1, boost::asio::use_awaitable);
+        std::unique_ptr<int> second =
+            co_await AsyncDouble(ioc, *first, boost::asio::use_awaitable);
+        result = *second;
+      },
+      boost::asio::detached);
+  ioc.run();
+  EXPECT_EQ(result, 4);
+}
+
+}  // namespace
@@ -0,0 +1,43 @@
+#include "circuit_breaker.hpp"
+
+#include <spdlog/spdlog.h>
+
+namespace http {
+
+bool CircuitBreaker::Allow(Clock::time_point now) {
+  switch (state_) {
+    case State::closed:
+      return true;
+    case State::open:
+      if (now < openUntil_) {
+        return false;
+      }
+      state_ = State::half_open;
+      return true;
+    case State::half_open:
+      // Only the probe goes through until it's answered
+      return false;
+  }
+  return false;
+}
+
+void CircuitBreaker::OnSuccess() {
+  state_ = State::closed;
+  failures_ = 0;
+}
+
+void CircuitBreaker::OnFailure(Clock::time_point now) {
+  failures_++;
+  if (threshold_ == 0) {
+    return;
+  }
+  if (state_ == State::half_open || failures_ >= threshold_) {
+    if (state_ != State::open) {
+      SPDLOG_DEBUG("Opening circuit breaker after {} failures", failures_);
+    }
+    state_ = State::open;
+    openUntil_ = now + openTime_;
+  }
+}
+
+}  // namespace http
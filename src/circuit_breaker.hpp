@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace http {
+
+// Tracks whether a host is down, so that requests to it can fail straight
+// away instead of each waiting out a connect timeout.  After threshold
+// requests in a row fail without a response the breaker opens, and requests
+// are refused until open_time has passed.  Then a single request is let
+// through to probe the host: if it gets a response the breaker closes, and
+// if not it opens again.
+class CircuitBreaker {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+ private:
+  enum class State { closed, open, half_open };
+
+  std::size_t threshold_;
+  Clock::duration openTime_;
+  State state_ = State::closed;
+  std::size_t failures_ = 0;
+  Clock::time_point openUntil_;
+
+ public:
+  CircuitBreaker(std::size_t threshold, Clock::duration open_time)
+      : threshold_(threshold), openTime_(open_time) {}
+
+  // Whether a request may be sent now.  A threshold of 0 never opens.
+  bool Allow(Clock::time_point now);
+
+  void OnSuccess();
+
+  void OnFailure(Clock::time_point now);
+
+  bool IsOpen() const { return state_ == State::open; }
+};
+
+}  // namespace http
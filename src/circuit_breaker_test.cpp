@@ -0,0 +1,60 @@
+#include "circuit_breaker.hpp"
+
+#include <chrono>
+
+#include "gmock/gmock.h"
+
+namespace http {
+namespace {
+
+using Clock = CircuitBreaker::Clock;
+using std::chrono::seconds;
+
+TEST(CircuitBreaker, OpensAfterConsecutiveFailures) {
+  CircuitBreaker breaker(3, seconds(30));
+  Clock::time_point now;
+  breaker.OnFailure(now);
+  breaker.OnFailure(now);
+  breaker.OnSuccess();
+  breaker.OnFailure(now);
+  breaker.OnFailure(now);
+  EXPECT_TRUE(breaker.Allow(now));
+
+  breaker.OnFailure(now);
+  EXPECT_TRUE(breaker.IsOpen());
+  EXPECT_FALSE(breaker.Allow(now + seconds(29)));
+}
+
+TEST(CircuitBreaker, ProbesOnceOpenTimeHasPassed) {
+  CircuitBreaker breaker(1, seconds(30));
+  Clock::time_point now;
+  breaker.OnFailure(now);
+  EXPECT_FALSE(breaker.Allow(now));
+
+  now += seconds(30);
+  EXPECT_TRUE(breaker.Allow(now));
+  // Only the one probe until it's answered
+  EXPECT_FALSE(breaker.Allow(now));
+
+  // A failed probe opens the breaker again
+  breaker.OnFailure(now);
+  EXPECT_FALSE(breaker.Allow(now + seconds(1)));
+
+  now += seconds(30);
+  EXPECT_TRUE(breaker.Allow(now));
+  breaker.OnSuccess();
+  EXPECT_TRUE(breaker.Allow(now));
+  EXPECT_TRUE(breaker.Allow(now));
+}
+
+TEST(CircuitBreaker, NeverOpensWithoutThreshold) {
+  CircuitBreaker breaker(0, seconds(30));
+  Clock::time_point now;
+  for (int failure = 0; failure < 100; failure++) {
+    breaker.OnFailure(now);
+  }
+  EXPECT_TRUE(breaker.Allow(now));
+}
+
+}  // namespace
+}  // namespace http
@@ -0,0 +1,107 @@
+#include "concurrency_limit.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace http {
+
+void LatencyWindow::Add(Clock::duration latency) {
+  samples_[next_] = latency;
+  next_ = (next_ + 1) % kSize;
+  count_ = std::min(count_ + 1, kSize);
+}
+
+std::optional<LatencyWindow::Clock::duration> LatencyWindow::Percentile(
+    double percentile) const {
+  if (count_ < kMinSamples) {
+    return std::nullopt;
+  }
+  std::array<Clock::duration, kSize> sorted = samples_;
+  double clamped = std::clamp(percentile, 0.0, 100.0);
+  std::size_t rank = std::min(
+      static_cast<std::size_t>(clamped / 100.0 * static_cast<double>(count_)),
+      count_ - 1);
+  std::nth_element(sorted.begin(), sorted.begin() + rank,
+                   sorted.begin() + count_);
+  return sorted[rank];
+}
+
+ConcurrencyLimit::ConcurrencyLimit(std::size_t initial, std::size_t max,
+                                   bool adaptive)
+    : limit_(adaptive ? std::clamp<std::size_t>(initial, 1,
+                                                std::max<std::size_t>(max, 1))
+                      : std::max<std::size_t>(max, 1)),
+      max_(std::max<std::size_t>(max, 1)),
+      adaptive_(adaptive) {}
+
+void ConcurrencyLimit::OnResponse(Clock::duration latency,
+                                  Clock::time_point now) {
+  latencies_.Add(latency);
+  if (!adaptive_) {
+    return;
+  }
+  if (smoothed_ == Clock::duration::zero()) {
+    smoothed_ = latency;
+  } else {
+    smoothed_ += (latency - smoothed_) / 8;
+  }
+  windowResponses_++;
+  if (windowResponses_ < limit_) {
+    return;
+  }
+  windowResponses_ = 0;
+  if (baseline_ == Clock::duration::max() || smoothed_ < baseline_) {
+    baseline_ = smoothed_;
+  } else {
+    baseline_ += (smoothed_ - baseline_) / 16;
+  }
+  if (now < holdUntil_) {
+    return;
+  }
+  if (smoothed_ > baseline_ * kLatencyTolerance) {
+    SPDLOG_DEBUG("Latency climbed to {}us from {}us",
+                 std::chrono::duration_cast<std::chrono::microseconds>(
+                     smoothed_)
+                     .count(),
+                 std::chrono::duration_cast<std::chrono::microseconds>(
+                     baseline_)
+                     .count());
+    Decrease(now);
+    return;
+  }
+  if (limit_ < max_) {
+    limit_++;
+    SPDLOG_DEBUG("Raising connection limit to {}", limit_);
+  }
+}
+
+void ConcurrencyLimit::OnOverload(Clock::time_point now,
+                                  Clock::time_point retry_after) {
+  if (!adaptive_) {
+    return;
+  }
+  Decrease(now);
+  holdUntil_ = std::max(holdUntil_, retry_after);
+}
+
+void ConcurrencyLimit::OnFailure(Clock::time_point now) {
+  if (!adaptive_) {
+    return;
+  }
+  Decrease(now);
+}
+
+void ConcurrencyLimit::Decrease(Clock::time_point now) {
+  if (now < holdUntil_) {
+    return;
+  }
+  limit_ = std::max<std::size_t>(limit_ / 2, 1);
+  windowResponses_ = 0;
+  Clock::duration holdoff = std::max<Clock::duration>(smoothed_ * 2,
+                                                      kMinHoldoff);
+  holdUntil_ = now + holdoff;
+  SPDLOG_DEBUG("Lowering connection limit to {}", limit_);
+}
+
+}  // namespace http
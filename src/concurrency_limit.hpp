@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+namespace http {
+
+// The latencies of a host's most recent responses
+class LatencyWindow {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::size_t kSize = 256;
+  // Fewer samples than this say too little to pick out a percentile
+  static constexpr std::size_t kMinSamples = 20;
+
+ private:
+  std::array<Clock::duration, kSize> samples_{};
+  std::size_t count_ = 0;
+  std::size_t next_ = 0;
+
+ public:
+  void Add(Clock::duration latency);
+
+  // The latency that percentile percent of recent responses came back
+  // within, if enough have been seen
+  std::optional<Clock::duration> Percentile(double percentile) const;
+};
+
+// Decides how many connections a host is sent requests over at once, by
+// additive increase and multiplicative decrease.  BMCs vary widely in how
+// much parallelism they can take, so rather than guess, the limit grows by
+// one connection for every window of responses that come back without
+// latency climbing, and halves when the service says it's overloaded (503 or
+// 429), a connection fails, or latency climbs past kLatencyTolerance times
+// the best seen.
+//
+// While latency holds steady, each connection added is more throughput, so
+// growth stops about where the service stops getting any faster.
+class ConcurrencyLimit {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Latency past this multiple of the baseline counts as the service
+  // queueing requests rather than serving them in parallel
+  static constexpr double kLatencyTolerance = 2.0;
+  // After a decrease, signals from requests that were already outstanding
+  // are ignored for at least this long, so one burst halves the limit once
+  static constexpr std::chrono::milliseconds kMinHoldoff{500};
+
+ private:
+  std::size_t limit_;
+  std::size_t max_;
+  bool adaptive_;
+  // The baseline latency is the best smoothed latency seen, which drifts up
+  // slowly so a service that's become slower overall can still grow again
+  Clock::duration baseline_ = Clock::duration::max();
+  Clock::duration smoothed_ = Clock::duration::zero();
+  // Responses seen in the current window, which is limit_ responses long
+  std::size_t windowResponses_ = 0;
+  // The limit is left alone until this, after a decrease or a Retry-After
+  Clock::time_point holdUntil_;
+  LatencyWindow latencies_;
+
+  void Decrease(Clock::time_point now);
+
+ public:
+  // Starts at initial connections, and never goes past max.  If adaptive is
+  // false, the limit is always max.
+  ConcurrencyLimit(std::size_t initial, std::size_t max, bool adaptive);
+
+  std::size_t Limit() const { return limit_; }
+
+  const LatencyWindow& Latencies() const { return latencies_; }
+
+  // A response was received latency after the request was sent
+  void OnResponse(Clock::duration latency, Clock::time_point now);
+
+  // The service answered 503 or 429.  retry_after is when it asked to be
+  // tried again, if it said.
+  void OnOverload(Clock::time_point now, Clock::time_point retry_after);
+
+  // A request failed without a response, or a connection couldn't be made
+  void OnFailure(Clock::time_point now);
+};
+
+}  // namespace http
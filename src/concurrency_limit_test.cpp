@@ -0,0 +1,120 @@
+#include "concurrency_limit.hpp"
+
+#include <chrono>
+
+#include "gmock/gmock.h"
+
+namespace http {
+namespace {
+
+using Clock = ConcurrencyLimit::Clock;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+// Feeds limit a full window of responses at latency
+void RespondWindow(ConcurrencyLimit& limit, milliseconds latency,
+                   Clock::time_point now) {
+  std::size_t window = limit.Limit();
+  for (std::size_t response = 0; response < window; response++) {
+    limit.OnResponse(latency, now);
+  }
+}
+
+TEST(ConcurrencyLimit, GrowsWhileLatencyHolds) {
+  ConcurrencyLimit limit(2, 16, true);
+  Clock::time_point now;
+  for (int window = 0; window < 5; window++) {
+    RespondWindow(limit, milliseconds(50), now);
+  }
+  EXPECT_EQ(limit.Limit(), 7U);
+
+  for (int window = 0; window < 100; window++) {
+    RespondWindow(limit, milliseconds(50), now);
+  }
+  EXPECT_EQ(limit.Limit(), 16U);
+}
+
+TEST(ConcurrencyLimit, BacksOffWhenLatencyClimbs) {
+  ConcurrencyLimit limit(8, 16, true);
+  Clock::time_point now;
+  RespondWindow(limit, milliseconds(50), now);
+  EXPECT_EQ(limit.Limit(), 9U);
+  for (int window = 0; window < 10; window++) {
+    RespondWindow(limit, milliseconds(500), now);
+    now += seconds(1);
+  }
+  EXPECT_LT(limit.Limit(), 9U);
+}
+
+TEST(ConcurrencyLimit, HalvesOncePerBurstOfFailures) {
+  ConcurrencyLimit limit(8, 16, true);
+  Clock::time_point now;
+  limit.OnFailure(now);
+  limit.OnFailure(now);
+  limit.OnFailure(now);
+  EXPECT_EQ(limit.Limit(), 4U);
+
+  now += seconds(1);
+  limit.OnFailure(now);
+  EXPECT_EQ(limit.Limit(), 2U);
+  now += seconds(1);
+  limit.OnFailure(now);
+  now += seconds(1);
+  limit.OnFailure(now);
+  EXPECT_EQ(limit.Limit(), 1U);
+}
+
+TEST(ConcurrencyLimit, WaitsOutRetryAfter) {
+  ConcurrencyLimit limit(4, 16, true);
+  Clock::time_point now;
+  limit.OnOverload(now, now + seconds(30));
+  EXPECT_EQ(limit.Limit(), 2U);
+
+  now += seconds(10);
+  RespondWindow(limit, milliseconds(50), now);
+  RespondWindow(limit, milliseconds(50), now);
+  EXPECT_EQ(limit.Limit(), 2U);
+
+  now += seconds(30);
+  RespondWindow(limit, milliseconds(50), now);
+  EXPECT_EQ(limit.Limit(), 3U);
+}
+
+TEST(ConcurrencyLimit, FixedWhenNotAdaptive) {
+  ConcurrencyLimit limit(2, 6, false);
+  Clock::time_point now;
+  EXPECT_EQ(limit.Limit(), 6U);
+  limit.OnFailure(now);
+  RespondWindow(limit, milliseconds(50), now);
+  EXPECT_EQ(limit.Limit(), 6U);
+}
+
+TEST(LatencyWindow, NeedsEnoughSamples) {
+  LatencyWindow window;
+  for (std::size_t sample = 1; sample < LatencyWindow::kMinSamples;
+       sample++) {
+    window.Add(milliseconds(50));
+  }
+  EXPECT_EQ(window.Percentile(95), std::nullopt);
+  window.Add(milliseconds(50));
+  EXPECT_EQ(window.Percentile(95), milliseconds(50));
+}
+
+TEST(LatencyWindow, PicksPercentileOfRecentSamples) {
+  LatencyWindow window;
+  for (int sample = 1; sample <= 100; sample++) {
+    window.Add(milliseconds(sample));
+  }
+  EXPECT_EQ(window.Percentile(50), milliseconds(51));
+  EXPECT_EQ(window.Percentile(95), milliseconds(96));
+  EXPECT_EQ(window.Percentile(100), milliseconds(100));
+
+  // Old samples age out
+  for (std::size_t sample = 0; sample < LatencyWindow::kSize; sample++) {
+    window.Add(milliseconds(10));
+  }
+  EXPECT_EQ(window.Percentile(99), milliseconds(10));
+}
+
+}  // namespace
+}  // namespace http
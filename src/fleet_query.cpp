@@ -0,0 +1,139 @@
+#include "fleet_query.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <boost/asio/post.hpp>
+#include <charconv>
+
+namespace {
+std::string_view Trim(std::string_view str) {
+  constexpr std::string_view kWhitespace = " \t\r\n";
+  std::size_t begin = str.find_first_not_of(kWhitespace);
+  if (begin == std::string_view::npos) {
+    return "";
+  }
+  std::size_t end = str.find_last_not_of(kWhitespace);
+  return str.substr(begin, end - begin + 1);
+}
+
+bool ParsePort(std::string_view str, uint16_t& port) {
+  const char* end = str.data() + str.size();
+  auto [ptr, ec] = std::from_chars(str.data(), end, port);
+  return ec == std::errc() && ptr == end && port != 0;
+}
+}  // namespace
+
+std::optional<std::vector<HostConnectData>> ParseHostList(
+    std::istream& in, const HostConnectData& defaults) {
+  std::vector<HostConnectData> hosts;
+  std::string line_buffer;
+  std::size_t line_number = 0;
+  while (std::getline(in, line_buffer)) {
+    line_number++;
+    std::string_view line = line_buffer;
+    line = Trim(line.substr(0, line.find('#')));
+    if (line.empty()) {
+      continue;
+    }
+    HostConnectData host = defaults;
+    std::string_view port;
+    if (line.front() == '[') {
+      std::size_t close = line.find(']');
+      if (close == std::string_view::npos) {
+        SPDLOG_ERROR("Line {}: unterminated [ in {}", line_number, line);
+        return std::nullopt;
+      }
+      host.host = line.substr(1, close - 1);
+      std::string_view rest = line.substr(close + 1);
+      if (!rest.empty()) {
+        if (rest.front() != ':') {
+          SPDLOG_ERROR("Line {}: expected :port after ] in {}", line_number,
+                       line);
+          return std::nullopt;
+        }
+        port = rest.substr(1);
+      }
+    } else if (std::count(line.begin(), line.end(), ':') == 1) {
+      std::size_t colon = line.find(':');
+      host.host = line.substr(0, colon);
+      port = line.substr(colon + 1);
+    } else {
+      // A hostname, IPv4 address, or an IPv6 address without a port
+      host.host = line;
+    }
+    if (!port.empty() && !ParsePort(port, host.port)) {
+      SPDLOG_ERROR("Line {}: invalid port {}", line_number, port);
+      return std::nullopt;
+    }
+    hosts.emplace_back(std::move(host));
+  }
+  return hosts;
+}
+
+FleetQuery::FleetQuery(boost::asio::io_context& ioc_in,
+                       const std::shared_ptr<http::Client>& client,
+                       std::vector<HostConnectData>&& hosts,
+                       std::vector<redfish::filter_ast::path>&& redpaths,
+                       const RedpathQueryOptions& query_options,
+                       const FleetOptions& options,
+                       FleetResultCallback&& on_result,
+                       HostDoneCallback&& on_host_done)
+    : ioc_(ioc_in),
+      client_(client),
+      hosts_(std::move(hosts)),
+      redpaths_(std::move(redpaths)),
+      queryOptions_(query_options),
+      options_(options),
+      onResult_(std::move(on_result)),
+      onHostDone_(std::move(on_host_done)) {}
+
+void FleetQuery::Start() {
+  std::size_t in_flight = std::max<std::size_t>(options_.max_hosts_in_flight, 1);
+  for (std::size_t count = 0; count < in_flight; count++) {
+    StartNextHost();
+  }
+}
+
+void FleetQuery::StartNextHost() {
+  if (nextHost_ >= hosts_.size()) {
+    return;
+  }
+  // A host's first request is the start of a fan out, so hosts aren't
+  // started while requests already made are waiting for room
+  if (!client_->HasRoom()) {
+    client_->WhenRoom(
+        std::bind_front(&FleetQuery::StartNextHost, shared_from_this()));
+    return;
+  }
+  std::size_t index = nextHost_++;
+  const HostConnectData& host = hosts_[index];
+  SPDLOG_DEBUG("Starting {} ({} of {})", host.host, index + 1, hosts_.size());
+  if (!host.username.empty()) {
+    client_->Authenticate(host.host, host.port,
+                          http::Credentials{.username = host.username,
+                                            .password = host.password});
+  }
+  std::vector<redfish::filter_ast::path> redpaths = redpaths_;
+  auto query = std::make_shared<RedpathQuery>(
+      client_, host, std::move(redpaths), queryOptions_,
+      std::bind_front(&FleetQuery::OnResult, shared_from_this(), index));
+  query->Start(
+      std::bind_front(&FleetQuery::OnHostDone, shared_from_this(), index));
+}
+
+void FleetQuery::OnResult(std::size_t index, std::string_view redpath,
+                          std::string_view value) {
+  onResult_(hosts_[index], redpath, value);
+}
+
+void FleetQuery::OnHostDone(std::size_t index, const QueryStatus& status) {
+  onHostDone_(hosts_[index], status);
+  // This is called from within a response callback for the host, so its
+  // connections are closed once that's unwound
+  boost::asio::post(ioc_, [self = shared_from_this(), index]() {
+    const HostConnectData& host = self->hosts_[index];
+    self->client_->Close(host.host, host.port);
+    self->StartNextHost();
+  });
+}
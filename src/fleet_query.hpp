@@ -0,0 +1,72 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "http_client.hpp"
+#include "path_parser_ast.hpp"
+#include "redpath_query.hpp"
+
+// Reads a list of hosts, one per line, as host, host:port or [v6addr]:port.
+// Blank lines and anything after a # are ignored.  Every host is given
+// defaults' port and credentials unless the line says otherwise.
+std::optional<std::vector<HostConnectData>> ParseHostList(
+    std::istream& in, const HostConnectData& defaults);
+
+struct FleetOptions {
+  // Hosts queried at the same time
+  std::size_t max_hosts_in_flight = 64;
+};
+
+// Called with each value a redpath resolves to, on the host it was found on
+using FleetResultCallback = std::function<void(
+    const HostConnectData& host, std::string_view redpath,
+    std::string_view value)>;
+
+// Called once a host has nothing left to fetch
+using HostDoneCallback = std::function<void(const HostConnectData& host,
+                                            const QueryStatus& status)>;
+
+// Runs the same redpaths against many hosts from one client, so that every
+// host shares the one TLS context, response cache and io_context.  Hosts are
+// queried max_hosts_in_flight at a time, and a host's connections are closed
+// as soon as it's done.  New hosts are held back while the client has no
+// room for more requests.
+class FleetQuery : public std::enable_shared_from_this<FleetQuery> {
+ private:
+  boost::asio::io_context& ioc_;
+  std::shared_ptr<http::Client> client_;
+  std::vector<HostConnectData> hosts_;
+  std::vector<redfish::filter_ast::path> redpaths_;
+  RedpathQueryOptions queryOptions_;
+  FleetOptions options_;
+  FleetResultCallback onResult_;
+  HostDoneCallback onHostDone_;
+  std::size_t nextHost_ = 0;
+
+  void StartNextHost();
+
+  void OnResult(std::size_t index, std::string_view redpath,
+                std::string_view value);
+
+  void OnHostDone(std::size_t index, const QueryStatus& status);
+
+ public:
+  FleetQuery(boost::asio::io_context& ioc_in,
+             const std::shared_ptr<http::Client>& client,
+             std::vector<HostConnectData>&& hosts,
+             std::vector<redfish::filter_ast::path>&& redpaths,
+             const RedpathQueryOptions& query_options,
+             const FleetOptions& options, FleetResultCallback&& on_result,
+             HostDoneCallback&& on_host_done);
+
+  void Start();
+};
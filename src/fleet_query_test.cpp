@@ -0,0 +1,51 @@
+#include "fleet_query.hpp"
+
+#include <sstream>
+
+#include "gmock/gmock.h"
+
+namespace {
+
+std::optional<std::vector<HostConnectData>> Parse(const std::string& list) {
+  std::istringstream in(list);
+  return ParseHostList(in, HostConnectData{.host = "",
+                                           .port = 443,
+                                           .username = "root",
+                                           .password = "pass"});
+}
+
+TEST(ParseHostList, ParsesHostsAndPorts) {
+  std::optional<std::vector<HostConnectData>> hosts =
+      Parse("bmc1\n"
+            "  bmc2:8443  # lab\n"
+            "\n"
+            "# bmc3\n"
+            "10.0.0.1:80\n"
+            "[fe80::1]:8443\n"
+            "[::1]\n"
+            "fe80::2\n");
+  ASSERT_TRUE(hosts);
+  ASSERT_EQ(hosts->size(), 6U);
+  EXPECT_EQ((*hosts)[0].host, "bmc1");
+  EXPECT_EQ((*hosts)[0].port, 443);
+  EXPECT_EQ((*hosts)[0].username, "root");
+  EXPECT_EQ((*hosts)[1].host, "bmc2");
+  EXPECT_EQ((*hosts)[1].port, 8443);
+  EXPECT_EQ((*hosts)[2].host, "10.0.0.1");
+  EXPECT_EQ((*hosts)[2].port, 80);
+  EXPECT_EQ((*hosts)[3].host, "fe80::1");
+  EXPECT_EQ((*hosts)[3].port, 8443);
+  EXPECT_EQ((*hosts)[4].host, "::1");
+  EXPECT_EQ((*hosts)[4].port, 443);
+  EXPECT_EQ((*hosts)[5].host, "fe80::2");
+}
+
+TEST(ParseHostList, RejectsInvalidPorts) {
+  EXPECT_FALSE(Parse("bmc1:http\n"));
+  EXPECT_FALSE(Parse("bmc1:70000\n"));
+  EXPECT_FALSE(Parse("bmc1:0\n"));
+  EXPECT_FALSE(Parse("[fe80::1\n"));
+  EXPECT_FALSE(Parse("[fe80::1]8443\n"));
+}
+
+}  // namespace
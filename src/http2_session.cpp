@@ -0,0 +1,311 @@
+#include "http2_session.hpp"
+
+#include <nghttp2/nghttp2.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <boost/beast/http/field.hpp>
+#include <cctype>
+#include <charconv>
+#include <iterator>
+
+namespace http {
+
+namespace {
+// Plenty for a collection to arrive in one round trip, rather than the
+// 64KiB HTTP/2 starts with
+constexpr int32_t kHttp2WindowSize = 1 << 20;
+
+// Header fields that only mean something to HTTP/1.1, and mustn't be sent
+// over HTTP/2.  Host is carried by :authority instead.
+bool IsConnectionSpecific(boost::beast::http::field name) {
+  using boost::beast::http::field;
+  return name == field::connection || name == field::keep_alive ||
+         name == field::proxy_connection ||
+         name == field::transfer_encoding || name == field::upgrade ||
+         name == field::host;
+}
+
+nghttp2_nv MakeNv(std::string_view name, std::string_view value) {
+  // nghttp2 copies the names and values, and never writes to them
+  return {const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(name.data())),
+          const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(value.data())),
+          name.size(), value.size(), NGHTTP2_NV_FLAG_NONE};
+}
+
+Response NoResponse() {
+  Response res;
+  res.string_response->result(boost::beast::http::status::unknown);
+  return res;
+}
+}  // namespace
+
+struct Http2Callbacks {
+  static Http2Session& Self(void* user_data) {
+    return *static_cast<Http2Session*>(user_data);
+  }
+
+  static int OnHeader(nghttp2_session* /*session*/, const nghttp2_frame* frame,
+                      const uint8_t* name, size_t namelen,
+                      const uint8_t* value, size_t valuelen,
+                      uint8_t /*flags*/, void* user_data) {
+    if (frame->hd.type != NGHTTP2_HEADERS) {
+      return 0;
+    }
+    Http2Session& self = Self(user_data);
+    auto it = self.streams_.find(frame->hd.stream_id);
+    if (it == self.streams_.end()) {
+      return 0;
+    }
+    std::string_view key(reinterpret_cast<const char*>(name), namelen);
+    std::string_view val(reinterpret_cast<const char*>(value), valuelen);
+    Response::ResponseType& res = it->second.res;
+    if (key == ":status") {
+      // Starts each response, including any 1xx ahead of the real one
+      unsigned status = 0;
+      std::from_chars(val.data(), val.data() + val.size(), status);
+      res = Response::ResponseType();
+      res.result(status);
+      return 0;
+    }
+    if (!key.starts_with(':')) {
+      res.insert(key, val);
+    }
+    return 0;
+  }
+
+  static int OnFrameRecv(nghttp2_session* /*session*/,
+                         const nghttp2_frame* frame, void* user_data) {
+    if (frame->hd.type == NGHTTP2_GOAWAY) {
+      SPDLOG_DEBUG("{} is going away", Self(user_data).authority_);
+      Self(user_data).goaway_ = true;
+    }
+    return 0;
+  }
+
+  static int OnDataChunk(nghttp2_session* /*session*/, uint8_t /*flags*/,
+                         int32_t stream_id, const uint8_t* data, size_t len,
+                         void* user_data) {
+    Http2Session& self = Self(user_data);
+    auto it = self.streams_.find(stream_id);
+    if (it == self.streams_.end() || !it->second.callback) {
+      return 0;
+    }
+    Http2Session::Stream& stream = it->second;
+    std::string_view chunk(reinterpret_cast<const char*>(data), len);
+    if (stream.sink) {
+      boost::system::error_code ec;
+      stream.sink(stream.res.base(), chunk, ec);
+      if (ec) {
+        self.Reset(stream_id, stream);
+      }
+      return 0;
+    }
+    if (stream.res.body().size() + chunk.size() > kHttpReadBodyLimit) {
+      SPDLOG_ERROR("Response from {} is over {} bytes", self.authority_,
+                   kHttpReadBodyLimit);
+      self.Reset(stream_id, stream);
+      return 0;
+    }
+    stream.res.body() += chunk;
+    return 0;
+  }
+
+  static int OnStreamClose(nghttp2_session* /*session*/, int32_t stream_id,
+                           uint32_t error_code, void* user_data) {
+    Http2Session& self = Self(user_data);
+    auto it = self.streams_.find(stream_id);
+    if (it == self.streams_.end()) {
+      return 0;
+    }
+    Http2Session::Stream& stream = it->second;
+    if (stream.callback) {
+      self.completed_.emplace_back(std::move(stream.callback),
+                                   error_code == NGHTTP2_NO_ERROR
+                                       ? Response(std::move(stream.res))
+                                       : NoResponse());
+    }
+    self.streams_.erase(it);
+    return 0;
+  }
+
+  static ssize_t ReadBody(nghttp2_session* /*session*/, int32_t stream_id,
+                          uint8_t* buf, size_t length, uint32_t* data_flags,
+                          nghttp2_data_source* /*source*/, void* user_data) {
+    Http2Session& self = Self(user_data);
+    auto it = self.streams_.find(stream_id);
+    if (it == self.streams_.end()) {
+      return NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE;
+    }
+    Http2Session::Stream& stream = it->second;
+    std::string_view rest =
+        std::string_view(stream.req.body()).substr(stream.body_sent);
+    std::size_t size = std::min(length, rest.size());
+    std::copy_n(rest.data(), size, buf);
+    stream.body_sent += size;
+    if (stream.body_sent == stream.req.body().size()) {
+      *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+    return static_cast<ssize_t>(size);
+  }
+};
+
+Http2Session::Http2Session(std::string authority)
+    : authority_(std::move(authority)) {
+  nghttp2_session_callbacks* callbacks = nullptr;
+  nghttp2_session_callbacks_new(&callbacks);
+  nghttp2_session_callbacks_set_on_header_callback(callbacks,
+                                                   &Http2Callbacks::OnHeader);
+  nghttp2_session_callbacks_set_on_frame_recv_callback(
+      callbacks, &Http2Callbacks::OnFrameRecv);
+  nghttp2_session_callbacks_set_on_data_chunk_recv_callback(
+      callbacks, &Http2Callbacks::OnDataChunk);
+  nghttp2_session_callbacks_set_on_stream_close_callback(
+      callbacks, &Http2Callbacks::OnStreamClose);
+  nghttp2_session_client_new(&session_, callbacks, this);
+  nghttp2_session_callbacks_del(callbacks);
+
+  std::array<nghttp2_settings_entry, 2> settings{{
+      {NGHTTP2_SETTINGS_ENABLE_PUSH, 0},
+      {NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, kHttp2WindowSize},
+  }};
+  nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, settings.data(),
+                          settings.size());
+  nghttp2_session_set_local_window_size(session_, NGHTTP2_FLAG_NONE, 0,
+                                        kHttp2WindowSize);
+}
+
+Http2Session::~Http2Session() { nghttp2_session_del(session_); }
+
+std::optional<int32_t> Http2Session::Submit(PendingRequest&& pending) {
+  if (!CanSubmit()) {
+    return std::nullopt;
+  }
+  const boost::beast::http::request<boost::beast::http::string_body>& req =
+      pending.req;
+  // HTTP/2 field names are lower case.  They're kept here until nghttp2 has
+  // copied them, so reserved up front to keep them from moving.
+  std::vector<std::string> names;
+  names.reserve(
+      static_cast<std::size_t>(std::distance(req.begin(), req.end())));
+  std::vector<nghttp2_nv> headers{
+      MakeNv(":method", req.method_string()),
+      MakeNv(":scheme", "https"),
+      MakeNv(":authority", authority_),
+      MakeNv(":path", req.target()),
+  };
+  for (const auto& field : req) {
+    if (IsConnectionSpecific(field.name())) {
+      continue;
+    }
+    std::string& name = names.emplace_back(field.name_string());
+    std::ranges::transform(name, name.begin(), [](unsigned char c) {
+      return static_cast<char>(std::tolower(c));
+    });
+    headers.push_back(MakeNv(name, field.value()));
+  }
+
+  nghttp2_data_provider body{};
+  body.read_callback = &Http2Callbacks::ReadBody;
+  int32_t stream_id = nghttp2_submit_request(
+      session_, nullptr, headers.data(), headers.size(),
+      req.body().empty() ? nullptr : &body, nullptr);
+  if (stream_id < 0) {
+    SPDLOG_ERROR("Failed to open a stream to {}: {}", authority_,
+                 nghttp2_strerror(stream_id));
+    return std::nullopt;
+  }
+  Stream& stream = streams_[stream_id];
+  stream.req = std::move(pending.req);
+  stream.callback = std::move(pending.callback);
+  stream.sink = std::move(pending.sink);
+  return stream_id;
+}
+
+void Http2Session::Cancel(int32_t stream_id) {
+  auto it = streams_.find(stream_id);
+  if (it == streams_.end()) {
+    return;
+  }
+  Reset(stream_id, it->second);
+  Finish();
+}
+
+void Http2Session::Reset(int32_t stream_id, Stream& stream) {
+  if (stream.callback) {
+    completed_.emplace_back(std::move(stream.callback), NoResponse());
+    stream.callback = nullptr;
+  }
+  nghttp2_submit_rst_stream(session_, NGHTTP2_FLAG_NONE, stream_id,
+                            NGHTTP2_CANCEL);
+}
+
+bool Http2Session::Receive(std::string_view data) {
+  ssize_t read = nghttp2_session_mem_recv(
+      session_, reinterpret_cast<const uint8_t*>(data.data()), data.size());
+  if (read < 0) {
+    SPDLOG_ERROR("HTTP/2 error from {}: {}", authority_,
+                 nghttp2_strerror(static_cast<int>(read)));
+  }
+  Finish();
+  return read >= 0;
+}
+
+std::string Http2Session::Send() {
+  std::string out;
+  while (true) {
+    const uint8_t* data = nullptr;
+    ssize_t size = nghttp2_session_mem_send(session_, &data);
+    if (size < 0) {
+      SPDLOG_ERROR("HTTP/2 error sending to {}: {}", authority_,
+                   nghttp2_strerror(static_cast<int>(size)));
+      break;
+    }
+    if (size == 0) {
+      break;
+    }
+    out.append(reinterpret_cast<const char*>(data),
+               static_cast<std::size_t>(size));
+  }
+  return out;
+}
+
+bool Http2Session::CanSubmit() const {
+  std::size_t allowed = std::min<std::size_t>(
+      nghttp2_session_get_remote_settings(
+          session_, NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS),
+      kMaxHttp2Streams);
+  return !goaway_ && streams_.size() < allowed;
+}
+
+bool Http2Session::IsAlive() const {
+  if (goaway_ && streams_.empty()) {
+    return false;
+  }
+  return nghttp2_session_want_read(session_) != 0 ||
+         nghttp2_session_want_write(session_) != 0;
+}
+
+void Http2Session::Fail() {
+  goaway_ = true;
+  for (auto& [stream_id, stream] : streams_) {
+    if (stream.callback) {
+      completed_.emplace_back(std::move(stream.callback), NoResponse());
+    }
+  }
+  streams_.clear();
+  Finish();
+}
+
+void Http2Session::Finish() {
+  // Taken first, as a callback may cancel another stream, which finishes it
+  std::vector<std::pair<std::function<void(Response&&)>, Response> >
+      completed = std::move(completed_);
+  completed_.clear();
+  for (auto& [callback, res] : completed) {
+    callback(std::move(res));
+  }
+}
+
+}  // namespace http
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "http_client.hpp"
+#include "http_response.hpp"
+#include "sink_body.hpp"
+
+struct nghttp2_session;
+
+namespace http {
+
+// Streams opened at once on one connection, whatever the host allows
+constexpr std::size_t kMaxHttp2Streams = 100;
+
+// The HTTP/2 framing for one connection, independent of whatever carries
+// the bytes.  The owner feeds everything it reads to Receive, and writes out
+// whatever Send returns after each call into the session.
+//
+// Each request is one stream.  Responses are handed to their callbacks as
+// their streams finish, in whatever order the host answers them.
+class Http2Session {
+ private:
+  struct Stream {
+    boost::beast::http::request<boost::beast::http::string_body> req;
+    // How much of the request body has gone out
+    std::size_t body_sent = 0;
+    std::function<void(Response&&)> callback;
+    BodySink sink;
+    Response::ResponseType res;
+  };
+
+  nghttp2_session* session_ = nullptr;
+  std::string authority_;
+  std::unordered_map<int32_t, Stream> streams_;
+  // Responses to hand back once nghttp2 is done with the bytes given to it,
+  // as their callbacks may call back into the session
+  std::vector<std::pair<std::function<void(Response&&)>, Response> >
+      completed_;
+  bool goaway_ = false;
+
+  // Gives up on a stream, failing it straight away rather than once the
+  // host has seen the reset
+  void Reset(int32_t stream_id, Stream& stream);
+
+  // Hands back the responses in completed_
+  void Finish();
+
+  // nghttp2's callbacks, which need nghttp2's types
+  friend struct Http2Callbacks;
+
+ public:
+  // authority is sent as :authority on every request
+  explicit Http2Session(std::string authority);
+
+  Http2Session(const Http2Session&) = delete;
+  Http2Session& operator=(const Http2Session&) = delete;
+  Http2Session(Http2Session&&) = delete;
+  Http2Session& operator=(Http2Session&&) = delete;
+  ~Http2Session();
+
+  // Opens a stream for pending, returning its id.  Returns nullopt, having
+  // called nothing, if no more streams can be opened (see CanSubmit).
+  std::optional<int32_t> Submit(PendingRequest&& pending);
+
+  // Resets a stream that's no longer wanted, failing it straight away
+  void Cancel(int32_t stream_id);
+
+  // Hands data read off the connection to the session.  Returns false if
+  // the host broke the protocol, after which the connection should be
+  // closed.
+  bool Receive(std::string_view data);
+
+  // The bytes to write to the connection next, if any
+  std::string Send();
+
+  // Whether another stream can be opened now, under both the host's limit
+  // and kMaxHttp2Streams
+  bool CanSubmit() const;
+
+  std::size_t OpenStreams() const { return streams_.size(); }
+
+  // False once the host has said goodbye and every stream has finished
+  bool IsAlive() const;
+
+  // Fails every open stream, after the connection's gone
+  void Fail();
+};
+
+}  // namespace http
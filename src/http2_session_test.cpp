@@ -0,0 +1,232 @@
+#include "http2_session.hpp"
+
+#include <nghttp2/nghttp2.h>
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+namespace http {
+namespace {
+
+using boost::beast::http::status;
+using boost::beast::http::verb;
+
+// The host's end of the connection, answering each request with its path
+class FakeHost {
+ private:
+  nghttp2_session* session_ = nullptr;
+  std::map<int32_t, std::string> paths_;
+  std::map<int32_t, std::string> bodies_;
+
+  static FakeHost& Self(void* user_data) {
+    return *static_cast<FakeHost*>(user_data);
+  }
+
+  static int OnHeader(nghttp2_session* /*session*/, const nghttp2_frame* frame,
+                      const uint8_t* name, size_t namelen,
+                      const uint8_t* value, size_t valuelen,
+                      uint8_t /*flags*/, void* user_data) {
+    std::string key(reinterpret_cast<const char*>(name), namelen);
+    std::string val(reinterpret_cast<const char*>(value), valuelen);
+    if (key == ":path") {
+      Self(user_data).paths_[frame->hd.stream_id] = val;
+    }
+    Self(user_data).headers.emplace_back(key);
+    return 0;
+  }
+
+  static int OnFrameRecv(nghttp2_session* session, const nghttp2_frame* frame,
+                         void* user_data) {
+    if ((frame->hd.type != NGHTTP2_HEADERS &&
+         frame->hd.type != NGHTTP2_DATA) ||
+        (frame->hd.flags & NGHTTP2_FLAG_END_STREAM) == 0) {
+      return 0;
+    }
+    FakeHost& self = Self(user_data);
+    int32_t stream_id = frame->hd.stream_id;
+    self.bodies_[stream_id] = self.paths_[stream_id];
+    std::string status = "200";
+    std::array<nghttp2_nv, 1> headers{{
+        {reinterpret_cast<uint8_t*>(const_cast<char*>(":status")),
+         reinterpret_cast<uint8_t*>(status.data()), 7, status.size(),
+         NGHTTP2_NV_FLAG_NONE},
+    }};
+    nghttp2_data_provider body{};
+    body.read_callback = &FakeHost::ReadBody;
+    nghttp2_submit_response(session, stream_id, headers.data(),
+                            headers.size(), &body);
+    return 0;
+  }
+
+  static ssize_t ReadBody(nghttp2_session* /*session*/, int32_t stream_id,
+                          uint8_t* buf, size_t length, uint32_t* data_flags,
+                          nghttp2_data_source* /*source*/, void* user_data) {
+    std::string& body = Self(user_data).bodies_[stream_id];
+    std::size_t size = std::min(length, body.size());
+    std::copy_n(body.data(), size, buf);
+    body.erase(0, size);
+    if (body.empty()) {
+      *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+    return static_cast<ssize_t>(size);
+  }
+
+ public:
+  // Every header field name the host has been sent
+  std::vector<std::string> headers;
+
+  FakeHost() {
+    nghttp2_session_callbacks* callbacks = nullptr;
+    nghttp2_session_callbacks_new(&callbacks);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks, &OnHeader);
+    nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks,
+                                                         &OnFrameRecv);
+    nghttp2_session_server_new(&session_, callbacks, this);
+    nghttp2_session_callbacks_del(callbacks);
+    nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, nullptr, 0);
+  }
+
+  FakeHost(const FakeHost&) = delete;
+  FakeHost& operator=(const FakeHost&) = delete;
+  FakeHost(FakeHost&&) = delete;
+  FakeHost& operator=(FakeHost&&) = delete;
+  ~FakeHost() { nghttp2_session_del(session_); }
+
+  void Receive(std::string_view data) {
+    ASSERT_GE(nghttp2_session_mem_recv(
+                  session_, reinterpret_cast<const uint8_t*>(data.data()),
+                  data.size()),
+              0);
+  }
+
+  std::string Send() {
+    std::string out;
+    const uint8_t* data = nullptr;
+    ssize_t size = 0;
+    while ((size = nghttp2_session_mem_send(session_, &data)) > 0) {
+      out.append(reinterpret_cast<const char*>(data),
+                 static_cast<std::size_t>(size));
+    }
+    return out;
+  }
+};
+
+// Passes bytes back and forth until neither end has anything to say
+void Exchange(Http2Session& session, FakeHost& host) {
+  while (true) {
+    std::string request = session.Send();
+    host.Receive(request);
+    std::string response = host.Send();
+    if (request.empty() && response.empty()) {
+      return;
+    }
+    EXPECT_TRUE(session.Receive(response));
+  }
+}
+
+PendingRequest Get(std::string_view path,
+                   std::vector<std::optional<Response> >& responses) {
+  std::size_t index = responses.size();
+  responses.emplace_back();
+  boost::beast::http::request<boost::beast::http::string_body> req(
+      verb::get, path, 11);
+  req.set(boost::beast::http::field::host, "bmc");
+  req.set("X-Test", "1");
+  return {std::move(req), [&responses, index](Response&& res) {
+            responses[index] = std::move(res);
+          }};
+}
+
+TEST(Http2Session, AnswersEachStream) {
+  Http2Session session("bmc");
+  FakeHost host;
+  std::vector<std::optional<Response> > responses;
+  for (std::string_view path : {"/redfish/v1/Chassis/1",
+                                "/redfish/v1/Chassis/2",
+                                "/redfish/v1/Chassis/3"}) {
+    EXPECT_TRUE(session.Submit(Get(path, responses)).has_value());
+  }
+  EXPECT_EQ(session.OpenStreams(), 3);
+
+  Exchange(session, host);
+  ASSERT_TRUE(responses[0] && responses[1] && responses[2]);
+  EXPECT_EQ(responses[0]->Result(), status::ok);
+  EXPECT_EQ(responses[0]->Body(), "/redfish/v1/Chassis/1");
+  EXPECT_EQ(responses[2]->Body(), "/redfish/v1/Chassis/3");
+  EXPECT_EQ(session.OpenStreams(), 0);
+  EXPECT_TRUE(session.IsAlive());
+}
+
+TEST(Http2Session, SendsHttp2Headers) {
+  Http2Session session("bmc");
+  FakeHost host;
+  std::vector<std::optional<Response> > responses;
+  session.Submit(Get("/redfish/v1", responses));
+  Exchange(session, host);
+
+  EXPECT_THAT(host.headers, testing::Contains(":authority"));
+  EXPECT_THAT(host.headers, testing::Contains("x-test"));
+  EXPECT_THAT(host.headers, testing::Not(testing::Contains("host")));
+}
+
+TEST(Http2Session, StreamsBodiesToSinks) {
+  Http2Session session("bmc");
+  FakeHost host;
+  std::vector<std::optional<Response> > responses;
+  PendingRequest pending = Get("/redfish/v1", responses);
+  std::string streamed;
+  pending.sink = [&streamed](const ResponseHeader& header,
+                             std::string_view chunk,
+                             boost::system::error_code& /*ec*/) {
+    EXPECT_EQ(header.result(), status::ok);
+    streamed += chunk;
+  };
+  session.Submit(std::move(pending));
+  Exchange(session, host);
+
+  EXPECT_EQ(streamed, "/redfish/v1");
+  ASSERT_TRUE(responses[0]);
+  EXPECT_EQ(responses[0]->Result(), status::ok);
+  EXPECT_EQ(responses[0]->Body(), "");
+}
+
+TEST(Http2Session, CancelFailsStraightAway) {
+  Http2Session session("bmc");
+  FakeHost host;
+  std::vector<std::optional<Response> > responses;
+  std::optional<int32_t> cancelled =
+      session.Submit(Get("/redfish/v1/Chassis", responses));
+  session.Submit(Get("/redfish/v1/Systems", responses));
+  ASSERT_TRUE(cancelled);
+
+  session.Cancel(*cancelled);
+  ASSERT_TRUE(responses[0]);
+  EXPECT_EQ(responses[0]->Result(), status::unknown);
+
+  Exchange(session, host);
+  ASSERT_TRUE(responses[1]);
+  EXPECT_EQ(responses[1]->Body(), "/redfish/v1/Systems");
+}
+
+TEST(Http2Session, FailEndsEveryStream) {
+  Http2Session session("bmc");
+  std::vector<std::optional<Response> > responses;
+  session.Submit(Get("/redfish/v1/Chassis", responses));
+  session.Submit(Get("/redfish/v1/Systems", responses));
+
+  session.Fail();
+  ASSERT_TRUE(responses[0] && responses[1]);
+  EXPECT_EQ(responses[0]->Result(), status::unknown);
+  EXPECT_EQ(responses[1]->Result(), status::unknown);
+  EXPECT_FALSE(session.CanSubmit());
+  EXPECT_FALSE(session.Submit(Get("/redfish/v1", responses)).has_value());
+}
+
+}  // namespace
+}  // namespace http
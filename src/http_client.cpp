@@ -2,15 +2,19 @@
 
 #include <openssl/err.h>
 
+#include <algorithm>
+#include <array>
 #include <boost/asio/connect.hpp>
 #include <boost/asio/experimental/channel.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/address.hpp>
 #include <boost/asio/ip/basic_endpoint.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/asio/ssl/context.hpp>
 #include <boost/asio/ssl/error.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/core/flat_static_buffer.hpp>
 #include <boost/beast/http/message.hpp>
@@ -21,16 +25,25 @@
 #include <boost/beast/ssl/ssl_stream.hpp>
 #include <boost/beast/version.hpp>
 #include <boost/container/devector.hpp>
+#include <boost/json.hpp>
 #include <boost/system/error_code.hpp>
+#include <charconv>
+#include <chrono>
 #include <cstdlib>
 #include <functional>
+#include <limits>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <queue>
+#include <random>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <format>
 
 #include "boost_formatter.hpp"
+#include "http2_session.hpp"
 #include "http_response.hpp"
 
 namespace http {
@@ -49,10 +62,166 @@ std::string printOsslError(const boost::system::error_code& ec) {
   }
   return err;
 }
+
+// Index of the ex_data slot on each SSL object that points back at the
+// TlsSessionCache for the host it's connected to
+int SessionCacheIndex() {
+  static const int kIndex =
+      SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return kIndex;
+}
+
+// Handed to callers when no response was received at all
+Response FailedResponse() {
+  Response::ResponseType res;
+  res.result(boost::beast::http::status::unknown);
+  return Response(std::move(res));
+}
+
+// How long a Retry-After header asks to wait.  Only the delay-seconds form
+// is understood; an HTTP-date is treated as no delay.
+std::chrono::seconds RetryAfter(std::string_view value) {
+  uint32_t seconds = 0;
+  std::from_chars(value.data(), value.data() + value.size(), seconds);
+  return std::chrono::seconds(seconds);
+}
+
+// Responses worth trying a GET again for: no response at all, or the
+// service saying it's too busy right now
+bool IsRetryable(boost::beast::http::status status) {
+  return status == boost::beast::http::status::unknown ||
+         status == boost::beast::http::status::service_unavailable ||
+         status == boost::beast::http::status::too_many_requests;
+}
+
+// Services may return the session's Location as an absolute URL
+std::string UriPath(std::string_view location) {
+  std::size_t scheme = location.find("://");
+  if (scheme != std::string_view::npos) {
+    std::size_t path = location.find('/', scheme + 3);
+    location = path == std::string_view::npos ? "" : location.substr(path);
+  }
+  return std::string(location);
+}
 }  // namespace
 
+void TlsSessionCache::Store(SSL_SESSION* session) { session_.reset(session); }
+
+void TlsSessionCache::Attach(SSL* ssl) {
+  SSL_set_ex_data(ssl, SessionCacheIndex(), this);
+  if (session_ == nullptr) {
+    return;
+  }
+  if (SSL_set_session(ssl, session_.get()) != 1) {
+    SPDLOG_DEBUG("Failed to set cached TLS session");
+  }
+}
+
+int TlsSessionCache::OnNewSession(SSL* ssl, SSL_SESSION* session) {
+  TlsSessionCache* cache =
+      static_cast<TlsSessionCache*>(SSL_get_ex_data(ssl, SessionCacheIndex()));
+  if (cache == nullptr) {
+    // Returning 0 tells openssl we didn't keep a reference
+    return 0;
+  }
+  SPDLOG_DEBUG("Caching TLS session for resumption");
+  cache->Store(session);
+  return 1;
+}
+
+std::shared_ptr<boost::asio::ssl::context> MakeSslContext(
+    const ConnectPolicy& policy) {
+  auto ssl_ctx = std::make_shared<boost::asio::ssl::context>(
+      boost::asio::ssl::context::tls_client);
+
+  boost::system::error_code ec;
+
+  // Support only TLS v1.2 & v1.3
+  ssl_ctx->set_options(boost::asio::ssl::context::default_workarounds |
+                           boost::asio::ssl::context::no_sslv2 |
+                           boost::asio::ssl::context::no_sslv3 |
+                           boost::asio::ssl::context::single_dh_use |
+                           boost::asio::ssl::context::no_tlsv1 |
+                           boost::asio::ssl::context::no_tlsv1_1,
+                       ec);
+  if (ec) {
+    SPDLOG_ERROR("Failed to set TLS options {}", ec);
+    return nullptr;
+  }
+
+  if (policy.verify_server_certificate) {
+    // Add a directory containing certificate authority files to be
+    // used for performing verification.
+    ssl_ctx->set_default_verify_paths(ec);
+    if (ec) {
+      SPDLOG_ERROR("Failed to load default verify paths {}", ec);
+      return nullptr;
+    }
+
+    // Verify the remote server's certificate
+    ssl_ctx->set_verify_mode(boost::asio::ssl::verify_peer, ec);
+    if (ec) {
+      SPDLOG_ERROR("Failed to set verify mode {}", ec);
+      return nullptr;
+    }
+  } else {
+    ssl_ctx->set_verify_mode(boost::asio::ssl::verify_none, ec);
+    if (ec) {
+      SPDLOG_ERROR("Failed to set verify mode {}", ec);
+      return nullptr;
+    }
+  }
+
+  // All cipher suites are set as per OWASP datasheet.
+  // https://cheatsheetseries.owasp.org/cheatsheets/TLS_Cipher_String_Cheat_Sheet.html
+  constexpr const char* kSslCiphers =
+      "ECDHE-ECDSA-AES128-GCM-SHA256:"
+      "ECDHE-RSA-AES128-GCM-SHA256:"
+      "ECDHE-ECDSA-AES256-GCM-SHA384:"
+      "ECDHE-RSA-AES256-GCM-SHA384:"
+      "ECDHE-ECDSA-CHACHA20-POLY1305:"
+      "ECDHE-RSA-CHACHA20-POLY1305:"
+      "DHE-RSA-AES128-GCM-SHA256:"
+      "DHE-RSA-AES256-GCM-SHA384"
+      "TLS_AES_128_GCM_SHA256:"
+      "TLS_AES_256_GCM_SHA384:"
+      "TLS_CHACHA20_POLY1305_SHA256";
+
+  if (SSL_CTX_set_cipher_list(ssl_ctx->native_handle(), kSslCiphers) != 1) {
+    SPDLOG_ERROR("Failed to set cipher list");
+    return nullptr;
+  }
+
+  // Client side session caching.  Openssl's internal store is keyed by
+  // session id, which is only useful on the server side, so sessions are
+  // handed to the per-host TlsSessionCache instead.
+  SSL_CTX_set_session_cache_mode(
+      ssl_ctx->native_handle(),
+      SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ssl_ctx->native_handle(),
+                          &TlsSessionCache::OnNewSession);
+
+#ifdef RTOOL_HTTP2
+  if (policy.http2) {
+    // Hosts that don't speak HTTP/2 pick HTTP/1.1, or ignore ALPN entirely
+    constexpr std::array<unsigned char, 12> kAlpnProtocols{
+        2, 'h', '2', 8, 'h', 't', 't', 'p', '/', '1', '.', '1'};
+    if (SSL_CTX_set_alpn_protos(ssl_ctx->native_handle(),
+                                kAlpnProtocols.data(),
+                                kAlpnProtocols.size()) != 0) {
+      SPDLOG_ERROR("Failed to set ALPN protocols");
+      return nullptr;
+    }
+  }
+#endif
+
+  return ssl_ctx;
+}
+
 void ConnectionInfo::DoResolve() {
   SPDLOG_DEBUG("starting resolve");
+  phaseStartedAt_ = RequestTimings::Clock::now();
+  setup_ = RequestTimings{.connected = true};
   resolver_.async_resolve(
       host_, std::to_string(port_),
       std::bind_front(&ConnectionInfo::AfterResolve, this, shared_from_this()));
@@ -63,10 +232,17 @@ void ConnectionInfo::AfterResolve(
     const boost::system::error_code ec,
     const boost::asio::ip::tcp::resolver::results_type& endpoint_list) {
   if (ec || (endpoint_list.empty())) {
+    SPDLOG_DEBUG("Resolve of {} failed: {}", host_, ec);
+    TraceEvent("resolve failed", ec.message());
+    FailRequests();
     return;
   }
+  RequestTimings::Clock::time_point now = RequestTimings::Clock::now();
+  setup_.resolve = now - phaseStartedAt_;
+  TraceSpan("resolve", phaseStartedAt_, now);
+  phaseStartedAt_ = now;
 
-  timer_.expires_after(std::chrono::seconds(30));
+  timer_.expires_after(policy_->connect_timeout);
   timer_.async_wait(std::bind_front(OnTimeout, weak_from_this()));
 
   SPDLOG_DEBUG("starting connect");
@@ -82,9 +258,21 @@ void ConnectionInfo::AfterConnect(
   timer_.cancel();
   if (ec) {
     SPDLOG_DEBUG("Connect failed: {}", ec);
+    TraceEvent("connect failed", ec.message());
+    FailRequests();
     return;
   }
   SPDLOG_DEBUG("Connected");
+  RequestTimings::Clock::time_point now = RequestTimings::Clock::now();
+  setup_.connect = now - phaseStartedAt_;
+  TraceSpan("connect", phaseStartedAt_, now);
+  phaseStartedAt_ = now;
+  connectedAt_ = now;
+  setupClaimed_ = false;
+  exchanges_ = 0;
+  if (hostStats_ != nullptr) {
+    hostStats_->opened_connections++;
+  }
   if (sslConn_) {
     DoSslHandshake();
     return;
@@ -99,6 +287,8 @@ void ConnectionInfo::DoSslHandshake() {
   timer_.expires_after(std::chrono::seconds(10));
   timer_.async_wait(std::bind_front(OnTimeout, weak_from_this()));
 
+  sslSessions_->Attach(sslConn_->native_handle());
+
   SPDLOG_DEBUG("starting handshake");
   sslConn_->async_handshake(boost::asio::ssl::stream_base::client,
                             std::bind_front(&ConnectionInfo::AfterSslHandshake,
@@ -111,13 +301,52 @@ void ConnectionInfo::AfterSslHandshake(
   timer_.cancel();
   if (ec) {
     SPDLOG_DEBUG("handshake failed {}", printOsslError(ec));
+    TraceEvent("tls handshake failed", ec.message());
+    FailRequests();
+    return;
+  }
+  connectedAt_ = RequestTimings::Clock::now();
+  setup_.tls_handshake = connectedAt_ - phaseStartedAt_;
+  TraceSpan("tls handshake", phaseStartedAt_, connectedAt_,
+            SSL_session_reused(sslConn_->native_handle()) != 0 ? "resumed"
+                                                               : "full");
+  if (SSL_session_reused(sslConn_->native_handle()) != 0) {
+    stats_->resumed_handshakes++;
+    SPDLOG_DEBUG("handshake succeeded (resumed)");
+  } else {
+    stats_->full_handshakes++;
+    SPDLOG_DEBUG("handshake succeeded (full)");
+  }
+#ifdef RTOOL_HTTP2
+  const unsigned char* protocol = nullptr;
+  unsigned int protocol_size = 0;
+  SSL_get0_alpn_selected(sslConn_->native_handle(), &protocol, &protocol_size);
+  if (std::string_view(reinterpret_cast<const char*>(protocol),
+                       protocol_size) == "h2") {
+    StartHttp2();
     return;
   }
-  SPDLOG_DEBUG("handshake succeeded {}", ec);
+#endif
   SendMessage();
 }
 
 void ConnectionInfo::SendMessage() {
+  while (true) {
+    if (req_ && cancel_ != nullptr && cancel_->cancelled) {
+      // Abandoned while reconnecting to send it
+      Complete(FailedResponse());
+    }
+    if (req_ || waiting_.empty()) {
+      break;
+    }
+    Take(std::move(waiting_.front()));
+    waiting_.pop_front();
+  }
+  if (req_) {
+    // Reconnected to send a request that was already taken off the channel
+    WriteRequest();
+    return;
+  }
   SPDLOG_DEBUG("getting message");
   channel_->async_receive(std::bind_front(&ConnectionInfo::OnMessageReadyToSend,
                                           this, shared_from_this()));
@@ -125,6 +354,11 @@ void ConnectionInfo::SendMessage() {
   conn_.async_wait(
       boost::asio::ip::tcp::socket::wait_error,
       std::bind_front(&ConnectionInfo::OnIdleEvent, this, weak_from_this()));
+
+  if (policy_->max_idle_time.count() > 0) {
+    timer_.expires_after(policy_->max_idle_time);
+    timer_.async_wait(std::bind_front(OnIdleTimeout, weak_from_this()));
+  }
 }
 
 void ConnectionInfo::OnMessageReadyToSend(
@@ -139,15 +373,322 @@ void ConnectionInfo::OnMessageReadyToSend(
     return;
   }
   SPDLOG_DEBUG("Got Message");
+  Dequeue(pending, RequestTimings::Clock::now());
+
+  if (pending.cancel != nullptr && pending.cancel->cancelled) {
+    // Abandoned while it was queued.  The idle wait is still running, so
+    // only the receive is restarted.
+    channel_->async_receive(std::bind_front(
+        &ConnectionInfo::OnMessageReadyToSend, this, shared_from_this()));
+    return;
+  }
 
   // Cancel our idle waiting event
   conn_.cancel(ec);
   // intentionally ignore errors here.  It's possible there was
   // nothing in progress to cancel
+  timer_.cancel();
+
+  Take(std::move(pending));
+
+  if (!conn_.is_open()) {
+    SPDLOG_DEBUG("Connection closed while idle, reconnecting");
+    DoReconnect();
+    return;
+  }
+  if (IsStale()) {
+    SPDLOG_DEBUG("Connection to {} closed by the host, reconnecting", host_);
+    TraceEvent("closed by host");
+    stats_->recycled_connections++;
+    DoReconnect();
+    return;
+  }
+  WriteRequest();
+}
+
+bool ConnectionInfo::IsStale() {
+  // Peeked at without blocking, so whatever's there is left for the next
+  // read
+  std::array<unsigned char, 1> next{};
+  boost::system::error_code ec;
+  conn_.non_blocking(true, ec);
+  if (ec) {
+    return false;
+  }
+  std::size_t size = conn_.receive(boost::asio::buffer(next),
+                                   boost::asio::socket_base::message_peek, ec);
+  boost::system::error_code ignored;
+  conn_.non_blocking(false, ignored);
+  if (ec == boost::asio::error::would_block) {
+    return false;
+  }
+  if (ec) {
+    // Closed or reset
+    return true;
+  }
+  // Nothing has been asked of the host, so anything it's sent is a goodbye:
+  // a 408 over plain HTTP, or a close_notify alert record over TLS 1.2.
+  // TLS 1.3 session tickets, and alerts, look like any other record, so are
+  // left to the idle timeout to guard against.
+  constexpr unsigned char kTlsAlertRecord = 21;
+  return size > 0 && (!sslConn_ || next[0] == kTlsAlertRecord);
+}
 
+void ConnectionInfo::Take(PendingRequest&& pending) {
   req_ = std::move(pending.req);
   callback_ = std::move(pending.callback);
+  sink_ = std::move(pending.sink);
+  cancel_ = std::move(pending.cancel);
+  queuedAt_ = pending.queued_at;
+  requestLane_ = pending.trace_lane;
+  Dequeue(pending, RequestTimings::Clock::now());
+  if (cancel_ != nullptr) {
+    cancel_->on_cancel = [weak_self = weak_from_this()]() {
+      std::shared_ptr<ConnectionInfo> self = weak_self.lock();
+      if (self != nullptr) {
+        self->Abandon();
+      }
+    };
+  }
+}
+
+void ConnectionInfo::Pipeline() {
+  // Only GETs are pipelined, and only behind one another; a server that
+  // drops the connection part way through may have acted on anything else.
+  // A connection that's about to close for being past the limit takes on
+  // nothing more.
+  while (!pipelineWriting_ && req_ && waiting_.empty() &&
+         protocol_ != nullptr && !protocol_->pipelining_broken &&
+         pipelined_.size() + 1 < policy_->pipeline_depth &&
+         req_->method() == boost::beast::http::verb::get &&
+         (limit_ == nullptr || index_ < limit_->Limit())) {
+    // Idle connections wait on the channel, so anything left in it is only
+    // there because every connection is busy
+    std::optional<PendingRequest> next;
+    channel_->try_receive(
+        [&next](boost::system::error_code ec, PendingRequest pending) {
+          if (!ec) {
+            next = std::move(pending);
+          }
+        });
+    if (!next) {
+      return;
+    }
+    ConcurrencyLimit::Clock::time_point now = ConcurrencyLimit::Clock::now();
+    Dequeue(*next, now);
+    if (next->cancel != nullptr && next->cancel->cancelled) {
+      // Abandoned while it was queued
+      continue;
+    }
+    if (next->req.method() != boost::beast::http::verb::get) {
+      waiting_.emplace_back(std::move(*next));
+      return;
+    }
+
+    auto req = std::make_shared<RequestType>(std::move(next->req));
+    pipelined_.push_back(Pipelined{req, std::move(next->callback),
+                                   std::move(next->sink),
+                                   std::move(next->cancel), now,
+                                   next->queued_at, next->trace_lane});
+    stats_->pipelined_requests++;
+    if (hostStats_ != nullptr) {
+      hostStats_->requests++;
+      hostStats_->reused_connections++;
+    }
+    exchanges_++;
+    pipelineWriting_ = true;
+    SPDLOG_DEBUG("Pipelining request {} to {}", pipelined_.size(), host_);
+    if (sslConn_) {
+      boost::beast::http::async_write(
+          *sslConn_, *req,
+          std::bind_front(&ConnectionInfo::AfterPipelinedWrite, this,
+                          shared_from_this(), req));
+    } else {
+      boost::beast::http::async_write(
+          conn_, *req,
+          std::bind_front(&ConnectionInfo::AfterPipelinedWrite, this,
+                          shared_from_this(), req));
+    }
+  }
+}
+
+void ConnectionInfo::AfterPipelinedWrite(
+    const std::shared_ptr<ConnectionInfo>& /*self*/,
+    const std::shared_ptr<RequestType>& /*req*/,
+    const boost::beast::error_code& ec, size_t bytesTransferred) {
+  pipelineWriting_ = false;
+  if (hostStats_ != nullptr) {
+    hostStats_->bytes_sent += bytesTransferred;
+  }
+  if (resumeAfterWrite_) {
+    bool keep_alive = *resumeAfterWrite_ && !ec;
+    resumeAfterWrite_.reset();
+    Resume(keep_alive);
+    return;
+  }
+  if (ec) {
+    // The read in progress fails too, and recovers the requests
+    SPDLOG_DEBUG("Pipelined write to {} failed {}", host_, ec);
+    return;
+  }
+  Pipeline();
+}
+
+void ConnectionInfo::PromotePipelined() {
+  Pipelined next = std::move(pipelined_.front());
+  pipelined_.pop_front();
+  req_ = *next.req;
+  callback_ = std::move(next.callback);
+  sink_ = std::move(next.sink);
+  // The request can't be abandoned without closing the connection under the
+  // ones behind it, so a cancelled one is left to be answered
+  cancel_ = std::move(next.cancel);
+  // Includes the time spent behind the requests ahead of it
+  sentAt_ = next.sent_at;
+  queuedAt_ = next.queued_at;
+  requestLane_ = next.trace_lane;
+  timings_ = StartTimings(queuedAt_, sentAt_);
+  requestSent_ = true;
+  pipelinedHead_ = true;
+  RecvMessage();
+  Pipeline();
+}
+
+void ConnectionInfo::Unpipeline(std::string_view reason) {
+  if ((pipelinedHead_ || !pipelined_.empty()) &&
+      !protocol_->pipelining_broken) {
+    SPDLOG_INFO("{} {}, no longer pipelining requests to it", host_, reason);
+    protocol_->pipelining_broken = true;
+    stats_->pipeline_fallbacks++;
+  }
+  // Sent again ahead of anything taken on after them
+  while (!pipelined_.empty()) {
+    Pipelined& last = pipelined_.back();
+    PendingRequest pending(RequestType(*last.req), last.callback, last.sink);
+    pending.cancel = std::move(last.cancel);
+    pending.queued_at = last.queued_at;
+    pending.trace_lane = last.trace_lane;
+    waiting_.emplace_front(std::move(pending));
+    pipelined_.pop_back();
+  }
+}
+
+void ConnectionInfo::Resume(bool keep_alive) {
+  if (pipelineWriting_) {
+    // The stream can't be written to or torn down until the write's done
+    resumeAfterWrite_ = keep_alive;
+    return;
+  }
+  if (!keep_alive) {
+    // Server is not keep-alive enabled so we need to close the
+    // connection and then start over from resolve
+    DoReconnect();
+    return;
+  }
+  if (waiting_.empty() && limit_ != nullptr && index_ >= limit_->Limit()) {
+    SPDLOG_DEBUG("Closing connection {} to {}, over the limit of {}", index_,
+                 host_, limit_->Limit());
+    if (sslConn_) {
+      SSL_set_shutdown(sslConn_->native_handle(),
+                       SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    }
+    CloseSocket();
+    return;
+  }
+  SendMessage();
+}
+
+RequestTimings ConnectionInfo::StartTimings(
+    RequestTimings::Clock::time_point queued_at,
+    RequestTimings::Clock::time_point now) {
+  RequestTimings timings;
+  RequestTimings::Clock::duration waited = now - queued_at;
+  if (!setupClaimed_ && connectedAt_ > queued_at) {
+    timings = setup_;
+    waited -= setup_.resolve + setup_.connect + setup_.tls_handshake;
+  }
+  setupClaimed_ = true;
+  timings.queued = std::max(waited, RequestTimings::Clock::duration::zero());
+  return timings;
+}
+
+void ConnectionInfo::Dequeue(PendingRequest& pending,
+                             RequestTimings::Clock::time_point now) {
+  if (pending.pushed_at == RequestTimings::Clock::time_point()) {
+    return;
+  }
+  if (hostStats_ != nullptr) {
+    hostStats_->queued_requests--;
+  }
+  if (tracer_ != nullptr && pending.trace_lane != 0) {
+    if (pending.pushed_at > pending.queued_at) {
+      tracer_->Span(pending.trace_lane, "queue", "request queue",
+                    pending.queued_at, pending.pushed_at, host_);
+    }
+    tracer_->Span(pending.trace_lane, "queue", "channel", pending.pushed_at,
+                  now, host_);
+  }
+  pending.pushed_at = RequestTimings::Clock::time_point();
+}
+
+void ConnectionInfo::TraceExchange(const Response& res) {
+  if (tracer_ == nullptr || traceLane_ == 0 || !req_ || !requestSent_) {
+    return;
+  }
+  RequestTimings::Clock::time_point now = RequestTimings::Clock::now();
+  RequestTimings::Clock::time_point start = std::max(sentAt_, tracedUntil_);
+  std::string detail = res.Result() == boost::beast::http::status::unknown
+                           ? std::string("failed")
+                           : std::to_string(static_cast<int>(res.Result()));
+  if (pipelinedHead_) {
+    detail += ", pipelined";
+  }
+  tracer_->Span(traceLane_, "exchange",
+                std::format("{} {}", std::string_view(req_->method_string()),
+                            std::string_view(req_->target())),
+                start, now, detail);
+  if (!pipelinedHead_ && timings_.wait != RequestTimings::Clock::duration{}) {
+    tracer_->Span(traceLane_, "exchange", "wait", sentAt_,
+                  sentAt_ + timings_.wait);
+    tracer_->Span(traceLane_, "exchange", "transfer", sentAt_ + timings_.wait,
+                  sentAt_ + timings_.wait + timings_.transfer);
+  }
+  tracedUntil_ = now;
+}
+
+void ConnectionInfo::TraceSpan(std::string_view name,
+                               RequestTimings::Clock::time_point start,
+                               RequestTimings::Clock::time_point end,
+                               std::string_view detail) {
+  if (tracer_ != nullptr && traceLane_ != 0) {
+    tracer_->Span(traceLane_, "connection", name, start, end, detail);
+  }
+}
+
+void ConnectionInfo::TraceEvent(std::string_view name,
+                                std::string_view detail) {
+  if (tracer_ != nullptr && traceLane_ != 0) {
+    tracer_->Instant(traceLane_, "connection", name,
+                     RequestTimings::Clock::now(), detail);
+  }
+}
 
+void ConnectionInfo::WriteRequest() {
+  sentAt_ = ConcurrencyLimit::Clock::now();
+  timings_ = StartTimings(queuedAt_, sentAt_);
+  requestSent_ = true;
+  if (hostStats_ != nullptr) {
+    hostStats_->requests++;
+    if (exchanges_ > 0) {
+      hostStats_->reused_connections++;
+    }
+  }
+  exchanges_++;
+  if (tracer_ != nullptr) {
+    // From the request's lane to the exchange on this one
+    tracedUntil_ = std::max(tracedUntil_, sentAt_);
+    tracer_->Flow(requestLane_, traceLane_, tracedUntil_);
+  }
   // Set a timeout on the operation
   timer_.expires_after(std::chrono::seconds(30));
   timer_.async_wait(std::bind_front(OnTimeout, weak_from_this()));
@@ -173,33 +714,94 @@ void ConnectionInfo::OnIdleEvent(const std::weak_ptr<ConnectionInfo>& /*self*/,
 
 void ConnectionInfo::AfterWrite(const std::shared_ptr<ConnectionInfo>& /*self*/,
                                 const boost::beast::error_code& ec,
-                                size_t /*bytesTransferred*/) {
+                                size_t bytesTransferred) {
   timer_.cancel();
+  if (hostStats_ != nullptr) {
+    hostStats_->bytes_sent += bytesTransferred;
+  }
   if (ec) {
-    callback_(Response(parser_->release()));
+    // Nothing has been read yet, so there's no response to hand back
+    FailInFlight(FailedResponse());
     return;
   }
 
   RecvMessage();
+  Pipeline();
 }
 
 void ConnectionInfo::RecvMessage() {
   parser_.emplace(std::piecewise_construct, std::make_tuple());
-  parser_->body_limit(kHttpReadBodyLimit);
+  if (sink_) {
+    parser_->get().body().sink = std::move(sink_);
+    parser_->body_limit(std::numeric_limits<std::uint64_t>::max());
+  } else {
+    parser_->body_limit(kHttpReadBodyLimit);
+  }
 
   timer_.expires_after(std::chrono::seconds(30));
   timer_.async_wait(std::bind_front(OnTimeout, weak_from_this()));
 
-  // Receive the HTTP response
+  // Receive the HTTP response, headers first so the host's answer can be
+  // timed apart from the body
+  if (sslConn_) {
+    boost::beast::http::async_read_header(
+        *sslConn_, buffer_, *parser_,
+        std::bind_front(&ConnectionInfo::AfterReadHeader, this,
+                        shared_from_this()));
+  } else {
+    boost::beast::http::async_read_header(
+        conn_, buffer_, *parser_,
+        std::bind_front(&ConnectionInfo::AfterReadHeader, this,
+                        shared_from_this()));
+  }
+}
+
+void ConnectionInfo::AfterReadHeader(
+    const std::shared_ptr<ConnectionInfo>& self,
+    const boost::beast::error_code& ec, const std::size_t bytesTransferred) {
+  if (ec) {
+    AfterRead(self, ec, bytesTransferred);
+    return;
+  }
+  headerReadAt_ = RequestTimings::Clock::now();
+  timings_.wait = headerReadAt_ - sentAt_;
+  if (hostStats_ != nullptr) {
+    hostStats_->bytes_received += bytesTransferred;
+  }
+  ReadBody(self);
+}
+
+void ConnectionInfo::ReadBody(const std::shared_ptr<ConnectionInfo>& self) {
+  if (parser_->is_done()) {
+    AfterRead(self, {}, 0);
+    return;
+  }
+  // Read a piece at a time, with the timeout restarted for each, so that a
+  // large body streamed from a slow host only times out if it stalls
+  timer_.expires_after(std::chrono::seconds(30));
+  timer_.async_wait(std::bind_front(OnTimeout, weak_from_this()));
   if (sslConn_) {
-    boost::beast::http::async_read(
+    boost::beast::http::async_read_some(
         *sslConn_, buffer_, *parser_,
-        std::bind_front(&ConnectionInfo::AfterRead, this, shared_from_this()));
+        std::bind_front(&ConnectionInfo::AfterReadBody, this, self));
   } else {
-    boost::beast::http::async_read(
+    boost::beast::http::async_read_some(
         conn_, buffer_, *parser_,
-        std::bind_front(&ConnectionInfo::AfterRead, this, shared_from_this()));
+        std::bind_front(&ConnectionInfo::AfterReadBody, this, self));
+  }
+}
+
+void ConnectionInfo::AfterReadBody(const std::shared_ptr<ConnectionInfo>& self,
+                                   const boost::beast::error_code& ec,
+                                   const std::size_t bytesTransferred) {
+  if (hostStats_ != nullptr) {
+    hostStats_->bytes_received += bytesTransferred;
   }
+  if (ec) {
+    AfterRead(self, ec, 0);
+    return;
+  }
+  ReadBody(self);
 }
 
 void ConnectionInfo::AfterRead(const std::shared_ptr<ConnectionInfo>& /*self*/,
@@ -207,8 +809,15 @@ void ConnectionInfo::AfterRead(const std::shared_ptr<ConnectionInfo>& /*self*/,
                                const std::size_t bytesTransferred) {
   SPDLOG_DEBUG("Read {} from server ec={}", bytesTransferred, ec);
   timer_.cancel();
+  if (hostStats_ != nullptr) {
+    hostStats_->bytes_received += bytesTransferred;
+  }
+  if (parser_->is_header_done()) {
+    timings_.transfer = RequestTimings::Clock::now() - headerReadAt_;
+  }
   if (ec && ec != boost::asio::ssl::error::stream_truncated) {
-    callback_(Response(parser_->release()));
+    FailInFlight(parser_->is_header_done() ? ReleaseResponse()
+                                           : FailedResponse());
     return;
   }
   // Keep the connection alive if server supports it
@@ -217,20 +826,28 @@ void ConnectionInfo::AfterRead(const std::shared_ptr<ConnectionInfo>& /*self*/,
   // Copy the response into a Response object so that it can be
   // processed by the callback function.
   bool keep_alive = parser_->get().keep_alive();
-  callback_(Response(parser_->release()));
-
-  // Callback has served its purpose, let it destruct
-  callback_ = nullptr;
+  if (!keep_alive && hostStats_ != nullptr) {
+    hostStats_->reconnects++;
+  }
+  Complete(ReleaseResponse());
 
-  // Is more data is now loaded for the next request?
-  if (keep_alive) {
-    SendMessage();
-  } else {
-    // Server is not keep-alive enabled so we need to close the
-    // connection and then start over from resolve
-    DoClose();
-    DoResolve();
+  if (!pipelined_.empty()) {
+    if (!keep_alive) {
+      Unpipeline("closed a connection with requests pipelined on it");
+      Resume(false);
+      return;
+    }
+    PromotePipelined();
+    return;
   }
+  Resume(keep_alive);
+}
+
+Response ConnectionInfo::ReleaseResponse() {
+  boost::beast::http::response<SinkBody> msg = parser_->release();
+  Response::ResponseType res(std::move(msg.base()));
+  res.body() = std::move(msg.body().buffered);
+  return Response(std::move(res));
 }
 
 void ConnectionInfo::OnTimeout(const std::weak_ptr<ConnectionInfo>& weak_self,
@@ -246,9 +863,37 @@ void ConnectionInfo::OnTimeout(const std::weak_ptr<ConnectionInfo>& weak_self,
   if (self == nullptr) {
     return;
   }
+  if (self->hostStats_ != nullptr) {
+    self->hostStats_->timeouts++;
+  }
   self->DoClose();
 }
 
+void ConnectionInfo::OnIdleTimeout(
+    const std::weak_ptr<ConnectionInfo>& weak_self,
+    const boost::system::error_code ec) {
+  if (ec) {
+    return;
+  }
+  std::shared_ptr<ConnectionInfo> self = weak_self.lock();
+  if (self == nullptr || self->req_ || !self->conn_.is_open()) {
+    return;
+  }
+  SPDLOG_DEBUG("Closing connection to {} after {}s idle", self->host_,
+               self->policy_->max_idle_time.count());
+  self->stats_->recycled_connections++;
+  self->TraceEvent("closed idle");
+  // Closed outright, so the next request can reconnect straight away rather
+  // than wait on a close_notify exchange.  Marked as cleanly shut down so
+  // the TLS session can still be resumed (see DoReconnect).  The receive on
+  // the channel carries on, and reconnects for whichever request it gets.
+  if (self->sslConn_) {
+    SSL_set_shutdown(self->sslConn_->native_handle(),
+                     SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+  }
+  self->CloseSocket();
+}
+
 void ConnectionInfo::OnTimerDone(
     const std::shared_ptr<ConnectionInfo>& /*self*/,
     const boost::system::error_code& ec) {
@@ -262,16 +907,158 @@ void ConnectionInfo::OnTimerDone(
   DoClose();
 }
 
+void ConnectionInfo::Complete(Response&& res) {
+  TraceExchange(res);
+  pipelinedHead_ = false;
+  requestLane_ = 0;
+  // An abandoned request says nothing about how the host is coping
+  bool abandoned = cancel_ != nullptr && cancel_->cancelled;
+  if (cancel_ != nullptr) {
+    cancel_->on_cancel = nullptr;
+    cancel_.reset();
+  }
+  requestSent_ = false;
+  if (req_ && limit_ != nullptr && !abandoned) {
+    ConcurrencyLimit::Clock::time_point now = ConcurrencyLimit::Clock::now();
+    boost::beast::http::status status = res.Result();
+    if (status == boost::beast::http::status::unknown) {
+      limit_->OnFailure(now);
+    } else if (status == boost::beast::http::status::service_unavailable ||
+               status == boost::beast::http::status::too_many_requests) {
+      limit_->OnOverload(now,
+                         now + RetryAfter(res.GetHeaderValue(
+                                   boost::beast::http::field::retry_after)));
+    } else {
+      limit_->OnResponse(now - sentAt_, now);
+    }
+  }
+  res.timings = std::exchange(timings_, RequestTimings{});
+  if (req_ && hostTimings_ != nullptr && !abandoned &&
+      res.Result() != boost::beast::http::status::unknown) {
+    hostTimings_->Add(res.timings);
+  }
+  req_.reset();
+  sink_ = nullptr;
+  std::function<void(Response&&)> callback = std::move(callback_);
+  callback_ = nullptr;
+  if (callback) {
+    callback(std::move(res));
+  }
+}
+
+void ConnectionInfo::Abandon() {
+  if (!requestSent_) {
+    // Still connecting; it's dropped before it's written (see SendMessage)
+    return;
+  }
+  if (!pipelined_.empty()) {
+    // Closing the connection would fail the requests pipelined behind it,
+    // so it's left to be answered
+    return;
+  }
+  SPDLOG_DEBUG("Abandoning request to {}", host_);
+  // HTTP/1.1 has no way to cancel one request, so the connection goes.  The
+  // pending read fails, which completes the request.
+  CloseSocket();
+}
+
+void ConnectionInfo::FailRequests() {
+  // Counted against the limit once, by Complete if a request was waiting on
+  // the connection
+  if (!req_ && limit_ != nullptr) {
+    limit_->OnFailure(ConcurrencyLimit::Clock::now());
+  }
+  Complete(FailedResponse());
+  // The requests this connection took on go with it.  They're collected
+  // first, as their callbacks may queue more requests.
+  std::vector<PendingRequest> failed(std::make_move_iterator(waiting_.begin()),
+                                     std::make_move_iterator(waiting_.end()));
+  waiting_.clear();
+  // Requests still queued are left to the host's other connections, if it
+  // has any; a host refusing connections past some number is still up.  If
+  // this was the last, nothing is going to get through, so rather than leave
+  // them waiting, they're failed too.
+  bool last = hostStats_ == nullptr || hostStats_->live_connections <= 1;
+  while (last && channel_->try_receive(
+      [&failed](boost::system::error_code ec, PendingRequest pending) {
+        if (!ec) {
+          failed.emplace_back(std::move(pending));
+        }
+      })) {
+  }
+  RequestTimings::Clock::time_point now = RequestTimings::Clock::now();
+  for (PendingRequest& pending : failed) {
+    Dequeue(pending, now);
+  }
+  for (PendingRequest& pending : failed) {
+    pending.callback(FailedResponse());
+  }
+}
+
+void ConnectionInfo::FailInFlight(Response&& res) {
+  Unpipeline("broke a connection with requests pipelined on it");
+  Complete(std::move(res));
+  if (!waiting_.empty()) {
+    Resume(false);
+  }
+}
+
 void ConnectionInfo::ShutdownConn() {
+  if (hostStats_ != nullptr) {
+    hostStats_->dropped_requests += waiting_.size();
+  }
+  // Failed along with the requests still in the channel.  Posted, as the
+  // connection's owner is part way through tearing it down.
+  RequestTimings::Clock::time_point now = RequestTimings::Clock::now();
+  for (PendingRequest& pending : waiting_) {
+    Dequeue(pending, now);
+    boost::asio::post(timer_.get_executor(),
+                      [callback = std::move(pending.callback)]() {
+                        callback(FailedResponse());
+                      });
+  }
+  for (Pipelined& pipelined : pipelined_) {
+    boost::asio::post(timer_.get_executor(),
+                      [callback = std::move(pipelined.callback)]() {
+                        callback(FailedResponse());
+                      });
+  }
   channel_->cancel();
+  pipelined_.clear();
+  waiting_.clear();
+  resumeAfterWrite_.reset();
+  CloseSocket();
+}
+
+void ConnectionInfo::CloseSocket() {
   boost::beast::error_code ec;
   conn_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
-  conn_.close();
+  conn_.close(ec);
 }
 
 void ConnectionInfo::DoClose() {
+#ifdef RTOOL_HTTP2
+  if (http2_) {
+    // Streams that timed out won't be answered, nor will any others
+    CloseHttp2();
+    return;
+  }
+#endif
+  TraceEvent("closing", "timed out or failed");
+  bool pipelining = pipelinedHead_ || !pipelined_.empty() || !waiting_.empty();
+  Unpipeline("stopped answering pipelined requests");
+  // A request that timed out won't be answered
+  Complete(FailedResponse());
   if (!sslConn_) {
-    ShutdownConn();
+    CloseSocket();
+    return;
+  }
+  if (pipelining) {
+    // The read in progress fails and reconnects for the requests taken on,
+    // which can't wait on a close_notify exchange
+    SSL_set_shutdown(sslConn_->native_handle(),
+                     SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    CloseSocket();
     return;
   }
 
@@ -279,220 +1066,1099 @@ void ConnectionInfo::DoClose() {
                                            this, shared_from_this()));
 }
 
+void ConnectionInfo::DoReconnect() {
+  TraceEvent("reconnecting");
+  if (sslConn_) {
+    // The server has already closed its side, so rather than waiting on a
+    // close_notify exchange, mark the session as cleanly shut down.  Openssl
+    // invalidates sessions from connections that are torn down without a
+    // shutdown, which would defeat resumption on the next connect.
+    SSL_set_shutdown(sslConn_->native_handle(),
+                     SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+  }
+  boost::beast::error_code ec;
+  conn_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+  conn_.close(ec);
+
+  // An SSL stream can't be handshaken twice, so start over with a new one
+  sslConn_.reset();
+  CreateSslStream();
+  DoResolve();
+}
+
 void ConnectionInfo::AfterSslShutdown(
     const std::shared_ptr<ConnectionInfo>& /*self*/,
     const boost::system::error_code& /*ec*/) {
-  ShutdownConn();
+  CloseSocket();
 }
 
-void ConnectionInfo::SetCipherSuiteTlSext() {
-  if (!sslConn_) {
-    return;
+#ifdef RTOOL_HTTP2
+void ConnectionInfo::StartHttp2() {
+  SPDLOG_DEBUG("Using HTTP/2 with {}", host_);
+  stats_->http2_connections++;
+  if (protocol_ != nullptr) {
+    protocol_->http2 = true;
   }
-  // NOTE: The SSL_set_tlsext_host_name is defined in tlsv1.h header
-  // file but its having old style casting (name is cast to void*).
-  // Since bmcweb compiler treats all old-style-cast as error, its
-  // causing the build failure. So replaced the same macro inline and
-  // did corrected the code by doing static_cast to viod*. This has to
-  // be fixed in openssl library in long run. Set SNI Hostname (many
-  // hosts need this to handshake successfully)
-  if (SSL_ctrl(sslConn_->native_handle(), SSL_CTRL_SET_TLSEXT_HOSTNAME,
-               TLSEXT_NAMETYPE_host_name,
-               static_cast<void*>(&host_.front())) == 0)
-
-  {
-    boost::beast::error_code ec{static_cast<int>(::ERR_get_error()),
-                                boost::asio::error::get_ssl_category()};
+  http2_ = std::make_shared<Http2Session>(host_);
+  ReadHttp2();
+
+  if (req_) {
+    // Reconnected to send a request that was already taken off the channel
+    PendingRequest pending(std::move(*req_), callback_, sink_);
+    pending.cancel = std::move(cancel_);
+    pending.queued_at = queuedAt_;
+    pending.trace_lane = requestLane_;
+    req_.reset();
+    callback_ = nullptr;
+    sink_ = nullptr;
+    waiting_.emplace_front(std::move(pending));
+  }
+  // Along with any taken on while pipelining
+  while (!waiting_.empty()) {
+    SubmitHttp2(std::move(waiting_.front()));
+    waiting_.pop_front();
+  }
+  FlushHttp2();
+  ReceiveHttp2();
+}
 
+void ConnectionInfo::ReceiveHttp2() {
+  if (http2Receiving_ || !http2_->CanSubmit()) {
     return;
   }
+  http2Receiving_ = true;
+  channel_->async_receive(std::bind_front(&ConnectionInfo::OnHttp2Request,
+                                          this, shared_from_this()));
 }
 
-ConnectionInfo::ConnectionInfo(boost::asio::io_context& ioc_in,
-                               const std::string& dest_ip_in,
-                               uint16_t dest_port_in,
-                               const std::shared_ptr<ConnectPolicy>& policy_in,
-                               const std::shared_ptr<Channel>& channel_in)
-    : host_(dest_ip_in),
-      port_(dest_port_in),
+void ConnectionInfo::OnHttp2Request(
+    const std::shared_ptr<ConnectionInfo>& /*self*/,
+    boost::system::error_code ec, PendingRequest pending) {
+  http2Receiving_ = false;
+  if (ec) {
+    if (ec == boost::asio::experimental::error::channel_cancelled) {
+      SPDLOG_DEBUG("Channel destroyed, closing connection {}", ec);
+      return;
+    }
+    SPDLOG_ERROR("Failed to get message {}", ec);
+    return;
+  }
+  if (!http2_->CanSubmit()) {
+    // The host went away while this was waiting on the channel.  The
+    // connection's started over for the request once the streams still open
+    // are done, and may not get HTTP/2 this time.
+    Take(std::move(pending));
+    RestartHttp2();
+    return;
+  }
+  SubmitHttp2(std::move(pending));
+  FlushHttp2();
+  ReceiveHttp2();
+}
+
+void ConnectionInfo::SubmitHttp2(PendingRequest&& pending) {
+  // Streams are read off one connection together, so there's no telling
+  // when one's headers arrived apart from its body.  Nor are they drawn on
+  // the connection's lane, where they'd overlap.
+  RequestTimings::Clock::time_point now = RequestTimings::Clock::now();
+  Dequeue(pending, now);
+  if (pending.cancel != nullptr && pending.cancel->cancelled) {
+    // Abandoned while it was queued
+    return;
+  }
+  pending.callback = [timings = StartTimings(pending.queued_at, now), now,
+                      host_timings = hostTimings_,
+                      callback = std::move(pending.callback)](
+                         Response&& res) mutable {
+    timings.wait = RequestTimings::Clock::now() - now;
+    if (host_timings != nullptr &&
+        res.Result() != boost::beast::http::status::unknown) {
+      host_timings->Add(timings);
+    }
+    res.timings = timings;
+    callback(std::move(res));
+  };
+  std::shared_ptr<RequestCancel> cancel = pending.cancel;
+  std::optional<int32_t> stream_id = http2_->Submit(std::move(pending));
+  if (!stream_id) {
+    // The host refused the stream, which a GET is retried after
+    pending.callback(FailedResponse());
+    return;
+  }
+  stats_->http2_requests++;
+  if (hostStats_ != nullptr) {
+    hostStats_->requests++;
+    if (exchanges_ > 0) {
+      hostStats_->reused_connections++;
+    }
+  }
+  exchanges_++;
+  if (cancel != nullptr) {
+    // Unlike HTTP/1.1, one stream can be dropped without the others
+    cancel->on_cancel = [weak_self = weak_from_this(),
+                         weak_session = std::weak_ptr<Http2Session>(http2_),
+                         stream_id = *stream_id]() {
+      std::shared_ptr<ConnectionInfo> self = weak_self.lock();
+      std::shared_ptr<Http2Session> session = weak_session.lock();
+      if (self == nullptr || session == nullptr || session != self->http2_) {
+        return;
+      }
+      session->Cancel(stream_id);
+      self->FlushHttp2();
+    };
+  }
+  if (http2_->OpenStreams() == 1) {
+    // The first stream since the connection was idle
+    timer_.expires_after(std::chrono::seconds(30));
+    timer_.async_wait(std::bind_front(OnTimeout, weak_from_this()));
+  }
+}
+
+void ConnectionInfo::ReadHttp2() {
+  http2Reading_ = true;
+  sslConn_->async_read_some(
+      boost::asio::buffer(http2Buffer_),
+      std::bind_front(&ConnectionInfo::AfterHttp2Read, this,
+                      shared_from_this()));
+}
+
+void ConnectionInfo::AfterHttp2Read(
+    const std::shared_ptr<ConnectionInfo>& /*self*/,
+    const boost::system::error_code& ec, std::size_t bytesTransferred) {
+  http2Reading_ = false;
+  if (hostStats_ != nullptr) {
+    hostStats_->bytes_received += bytesTransferred;
+  }
+  if (ec) {
+    SPDLOG_DEBUG("HTTP/2 connection to {} closed {}", host_, ec);
+    CloseHttp2();
+    RestartHttp2();
+    return;
+  }
+  if (!http2_->Receive(
+          std::string_view(http2Buffer_.data(), bytesTransferred))) {
+    CloseHttp2();
+    RestartHttp2();
+    return;
+  }
+  FlushHttp2();
+  if (!http2_->IsAlive()) {
+    // The host's said goodbye, and answered everything it's going to
+    CloseHttp2();
+    RestartHttp2();
+    return;
+  }
+  // Streams are given as long as the host keeps sending something
+  if (http2_->OpenStreams() > 0) {
+    timer_.expires_after(std::chrono::seconds(30));
+    timer_.async_wait(std::bind_front(OnTimeout, weak_from_this()));
+  } else {
+    timer_.cancel();
+  }
+  ReceiveHttp2();
+  ReadHttp2();
+}
+
+void ConnectionInfo::FlushHttp2() {
+  if (http2Writing_ || !conn_.is_open()) {
+    return;
+  }
+  auto data = std::make_shared<std::string>(http2_->Send());
+  if (data->empty()) {
+    return;
+  }
+  http2Writing_ = true;
+  boost::asio::async_write(*sslConn_, boost::asio::buffer(*data),
+                           std::bind_front(&ConnectionInfo::AfterHttp2Write,
+                                           this, shared_from_this(), data));
+}
+
+void ConnectionInfo::AfterHttp2Write(
+    const std::shared_ptr<ConnectionInfo>& /*self*/,
+    const std::shared_ptr<std::string>& /*data*/,
+    const boost::system::error_code& ec, std::size_t bytesTransferred) {
+  http2Writing_ = false;
+  if (hostStats_ != nullptr) {
+    hostStats_->bytes_sent += bytesTransferred;
+  }
+  if (ec) {
+    SPDLOG_DEBUG("HTTP/2 write to {} failed {}", host_, ec);
+    // The read fails too, and fails the streams
+    CloseSocket();
+    RestartHttp2();
+    return;
+  }
+  FlushHttp2();
+}
+
+void ConnectionInfo::CloseHttp2() {
+  timer_.cancel();
+  http2_->Fail();
+  SSL_set_shutdown(sslConn_->native_handle(),
+                   SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+  CloseSocket();
+}
+
+void ConnectionInfo::RestartHttp2() {
+  if (http2Reading_ || http2Writing_ || !req_) {
+    return;
+  }
+  http2_.reset();
+  DoReconnect();
+}
+#endif
+
+void ConnectionInfo::SetCipherSuiteTlSext() {
+  if (!sslConn_) {
+    return;
+  }
+  // NOTE: The SSL_set_tlsext_host_name is defined in tlsv1.h header
+  // file but its having old style casting (name is cast to void*).
+  // Since bmcweb compiler treats all old-style-cast as error, its
+  // causing the build failure. So replaced the same macro inline and
+  // did corrected the code by doing static_cast to viod*. This has to
+  // be fixed in openssl library in long run. Set SNI Hostname (many
+  // hosts need this to handshake successfully)
+  if (SSL_ctrl(sslConn_->native_handle(), SSL_CTRL_SET_TLSEXT_HOSTNAME,
+               TLSEXT_NAMETYPE_host_name,
+               static_cast<void*>(&host_.front())) == 0)
+
+  {
+    boost::beast::error_code ec{static_cast<int>(::ERR_get_error()),
+                                boost::asio::error::get_ssl_category()};
+
+    return;
+  }
+}
+
+void ConnectionInfo::CreateSslStream() {
+  if (sslCtx_ == nullptr) {
+    return;
+  }
+  sslConn_.emplace(conn_, *sslCtx_);
+  SetCipherSuiteTlSext();
+}
+
+ConnectionInfo::ConnectionInfo(
+    boost::asio::io_context& ioc_in, const std::string& dest_ip_in,
+    uint16_t dest_port_in, const std::shared_ptr<ConnectPolicy>& policy_in,
+    const std::shared_ptr<boost::asio::ssl::context>& ssl_ctx_in,
+    const std::shared_ptr<TlsSessionCache>& ssl_sessions_in,
+    const std::shared_ptr<ClientStats>& stats_in,
+    const std::shared_ptr<Channel>& channel_in)
+    : host_(dest_ip_in),
+      port_(dest_port_in),
       resolver_(ioc_in),
       conn_(ioc_in),
       policy_(policy_in),
+      sslCtx_(ssl_ctx_in),
+      sslSessions_(ssl_sessions_in),
+      stats_(stats_in),
       timer_(ioc_in),
       channel_(channel_in) {
   SPDLOG_DEBUG("Constructing ConnectionInfo");
-  if (policy_->use_tls) {
-    boost::asio::ssl::context ssl_ctx(boost::asio::ssl::context::tls_client);
-
-    boost::system::error_code ec;
-
-    // Support only TLS v1.2 & v1.3
-    ssl_ctx.set_options(boost::asio::ssl::context::default_workarounds |
-                            boost::asio::ssl::context::no_sslv2 |
-                            boost::asio::ssl::context::no_sslv3 |
-                            boost::asio::ssl::context::single_dh_use |
-                            boost::asio::ssl::context::no_tlsv1 |
-                            boost::asio::ssl::context::no_tlsv1_1,
-                        ec);
-    if (ec) {
-      std::cout << "Error";
-      return;
+  CreateSslStream();
+}
+
+ConnectionInfo::~ConnectionInfo() {
+  if (hostStats_ != nullptr) {
+    hostStats_->live_connections--;
+  }
+  if (tracer_ != nullptr && traceLane_ != 0) {
+    TraceEvent("closed");
+    tracer_->ReleaseLane(traceLane_);
+  }
+}
+
+void ConnectionInfo::Start() {
+  if (hostStats_ != nullptr) {
+    hostStats_->live_connections++;
+  }
+  if (tracer_ != nullptr) {
+    traceLane_ = tracer_->AcquireLane(std::format("{} connection", host_));
+  }
+  DoResolve();
+}
+
+// A GET racing a duplicate of itself.  Whichever attempt first starts
+// getting an answer that won't be retried wins, and the other is abandoned.
+struct HedgeRace : public std::enable_shared_from_this<HedgeRace> {
+  boost::asio::steady_timer timer;
+  std::shared_ptr<ClientStats> stats;
+  std::array<std::shared_ptr<RequestCancel>, 2> cancels{
+      std::make_shared<RequestCancel>(), std::make_shared<RequestCancel>()};
+  // Attempts sent that haven't finished
+  std::size_t running = 0;
+  std::optional<std::size_t> winner;
+
+  HedgeRace(boost::asio::io_context& ioc,
+            const std::shared_ptr<ClientStats>& stats_in)
+      : timer(ioc), stats(stats_in) {}
+
+  // Whether attempt gets to answer.  The first attempt to claim the race
+  // wins it.
+  bool Claim(std::size_t attempt) {
+    if (!winner) {
+      winner = attempt;
+      timer.cancel();
+      if (attempt == 1) {
+        stats->hedges_won++;
+      }
+      cancels[1 - attempt]->Cancel();
     }
+    return *winner == attempt;
+  }
 
-    if (policy_->verify_server_certificate) {
-      // Add a directory containing certificate authority files to be
-      // used for performing verification.
-      ssl_ctx.set_default_verify_paths(ec);
-      if (ec) {
-        std::cout << "Error";
+  // Has pending take part in the race as attempt
+  void Enter(std::size_t attempt, PendingRequest& pending) {
+    running++;
+    pending.cancel = cancels[attempt];
+    pending.callback = [race = shared_from_this(), attempt,
+                        callback = std::move(pending.callback)](
+                           Response&& res) {
+      race->running--;
+      // A failed, or overloaded, attempt leaves the other to answer, if it's
+      // still going
+      if (IsRetryable(res.Result()) && !race->winner && race->running > 0) {
         return;
       }
+      if (race->Claim(attempt)) {
+        callback(std::move(res));
+      }
+    };
+    if (pending.sink) {
+      pending.sink = [race = shared_from_this(), attempt,
+                      sink = std::move(pending.sink)](
+                         const ResponseHeader& header, std::string_view chunk,
+                         boost::system::error_code& ec) {
+        // Doesn't settle the race (see above), so the body of a 503 is
+        // dropped even if it ends up answering
+        if (IsRetryable(header.result()) && !race->winner) {
+          return;
+        }
+        if (race->Claim(attempt)) {
+          sink(header, chunk, ec);
+        }
+      };
+    }
+  }
+};
+
+void ConnectionPool::Send(PendingRequest&& pending) {
+  Attempt(std::make_shared<PendingRequest>(std::move(pending)), 0);
+}
 
-      // Verify the remote server's certificate
-      ssl_ctx.set_verify_mode(boost::asio::ssl::verify_peer, ec);
-      if (ec) {
-        std::cout << "Error";
+void ConnectionPool::Attempt(const std::shared_ptr<PendingRequest>& original,
+                             std::size_t attempt) {
+  if (!breaker_.Allow(CircuitBreaker::Clock::now())) {
+    SPDLOG_DEBUG("{} is down, failing request", destIP_);
+    stats_->short_circuited_requests++;
+    boost::asio::post(ioc_,
+                      [original]() { original->callback(FailedResponse()); });
+    return;
+  }
+  // Only a GET can be safely sent twice
+  boost::beast::http::verb verb = original->req.method();
+  bool may_retry = attempt < policy_->max_retries &&
+                   (verb == boost::beast::http::verb::get ||
+                    verb == boost::beast::http::verb::head);
+  // The request is only copied if it might be needed again
+  PendingRequest pending(
+      may_retry ? boost::beast::http::request<boost::beast::http::string_body>(
+                      original->req)
+                : std::move(original->req),
+      std::bind_front(&ConnectionPool::AfterAttempt, weak_from_this(),
+                      original, attempt, may_retry));
+  pending.trace_lane = original->trace_lane;
+  if (original->sink) {
+    // The body of a response that's going to be retried isn't the caller's
+    // to see
+    pending.sink = [original, may_retry](const ResponseHeader& header,
+                                         std::string_view chunk,
+                                         boost::system::error_code& ec) {
+      if (may_retry && IsRetryable(header.result())) {
         return;
       }
-    } else {
-      ssl_ctx.set_verify_mode(boost::asio::ssl::verify_none, ec);
-      if (ec) {
-        std::cout << "Error";
+      original->sink(header, chunk, ec);
+    };
+  }
+
+  std::optional<ConcurrencyLimit::Clock::duration> hedge_after =
+      HedgeDelay(verb);
+  if (!hedge_after) {
+    QueuePending(std::move(pending));
+    return;
+  }
+  auto race = std::make_shared<HedgeRace>(ioc_, stats_);
+  PendingRequest hedge = pending;
+  race->Enter(0, pending);
+  QueuePending(std::move(pending));
+  race->timer.expires_after(*hedge_after);
+  race->timer.async_wait(std::bind_front(&ConnectionPool::OnHedgeTimer,
+                                         weak_from_this(), race,
+                                         std::move(hedge)));
+}
+
+std::optional<ConcurrencyLimit::Clock::duration> ConnectionPool::HedgeDelay(
+    boost::beast::http::verb verb) const {
+  if (policy_->hedge_percentile <= 0 ||
+      verb != boost::beast::http::verb::get) {
+    return std::nullopt;
+  }
+  return limit_->Latencies().Percentile(policy_->hedge_percentile);
+}
+
+bool ConnectionPool::CanHedge() const {
+  if (pushInProgress_ || !requestQueue_.empty()) {
+    return false;
+  }
+  std::size_t busy = 0;
+  for (const std::weak_ptr<ConnectionInfo>& weak_conn : connections_) {
+    std::shared_ptr<ConnectionInfo> conn = weak_conn.lock();
+    if (conn != nullptr && conn->req_) {
+      busy++;
+    }
+  }
+  return busy < limit_->Limit();
+}
+
+void ConnectionPool::OnHedgeTimer(
+    const std::weak_ptr<ConnectionPool>& weak_self,
+    const std::shared_ptr<HedgeRace>& race, PendingRequest hedge,
+    const boost::system::error_code& ec) {
+  if (ec || race->winner) {
+    return;
+  }
+  std::shared_ptr<ConnectionPool> self = weak_self.lock();
+  if (self == nullptr) {
+    return;
+  }
+  if (!self->CanHedge()) {
+    SPDLOG_DEBUG("No free connection to {} to hedge on", self->destIP_);
+    return;
+  }
+  SPDLOG_DEBUG("Hedging slow request to {}{}", self->destIP_,
+               hedge.req.target());
+  self->stats_->hedged_requests++;
+  race->Enter(1, hedge);
+  self->QueuePending(std::move(hedge));
+}
+
+void ConnectionPool::AfterAttempt(
+    const std::weak_ptr<ConnectionPool>& weak_self,
+    const std::shared_ptr<PendingRequest>& original, std::size_t attempt,
+    bool may_retry, Response&& res) {
+  std::shared_ptr<ConnectionPool> self = weak_self.lock();
+  if (self == nullptr) {
+    original->callback(std::move(res));
+    return;
+  }
+  bool failed = res.Result() == boost::beast::http::status::unknown;
+  if (failed) {
+    self->breaker_.OnFailure(CircuitBreaker::Clock::now());
+  } else {
+    self->breaker_.OnSuccess();
+  }
+  // Once the host looks down, retrying only puts off the failure
+  if (!may_retry || !IsRetryable(res.Result()) ||
+      (failed && self->breaker_.IsOpen())) {
+    original->callback(std::move(res));
+    return;
+  }
+
+  std::chrono::milliseconds delay = self->RetryDelay(attempt, res);
+  SPDLOG_DEBUG("Retrying {}{} in {}ms", self->destIP_, original->req.target(),
+               delay.count());
+  self->stats_->retried_requests++;
+  auto timer = std::make_shared<boost::asio::steady_timer>(self->ioc_, delay);
+  timer->async_wait([timer, weak_self, original,
+                     attempt](const boost::system::error_code& ec) {
+    std::shared_ptr<ConnectionPool> self = weak_self.lock();
+    if (ec || self == nullptr) {
+      // The host was closed while the request waited to be retried
+      original->callback(FailedResponse());
+      return;
+    }
+    self->Attempt(original, attempt + 1);
+  });
+}
+
+std::chrono::milliseconds ConnectionPool::RetryDelay(
+    std::size_t attempt, const Response& res) const {
+  // Full jitter: anywhere up to the exponential delay, so that requests
+  // which failed together don't all come back together
+  std::chrono::milliseconds ceiling = std::min(
+      policy_->max_retry_delay,
+      policy_->retry_delay * (1U << std::min<std::size_t>(attempt + 1, 16)));
+  std::chrono::milliseconds shortest =
+      std::min<std::chrono::milliseconds>(policy_->retry_delay / 2, ceiling);
+  thread_local std::minstd_rand random(std::random_device{}());
+  std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter(
+      shortest.count(), ceiling.count());
+  std::chrono::milliseconds delay(jitter(random));
+  return std::max<std::chrono::milliseconds>(
+      delay, RetryAfter(res.GetHeaderValue(
+                 boost::beast::http::field::retry_after)));
+}
+
+void ConnectionPool::QueuePending(PendingRequest&& pending) {
+  if (!credentials_) {
+    Dispatch(std::move(pending));
+    return;
+  }
+  if (session_.token.empty()) {
+    authQueue_.emplace_back(std::move(pending));
+    Login();
+    return;
+  }
+  SendAuthorized(std::move(pending), true);
+}
+
+void ConnectionPool::SendAuthorized(PendingRequest&& pending, bool may_retry) {
+  pending.req.set("X-Auth-Token", session_.token);
+  // Kept so the request can be sent again if the token has expired
+  auto original = std::make_shared<PendingRequest>(pending);
+  pending.callback =
+      std::bind_front(&ConnectionPool::AfterAuthorizedResponse,
+                      weak_from_this(), original, session_.token, may_retry);
+  if (original->sink) {
+    // The body of a rejected request isn't the caller's to see if it's
+    // going to be retried
+    pending.sink = [original, may_retry](const ResponseHeader& header,
+                                         std::string_view chunk,
+                                         boost::system::error_code& ec) {
+      if (may_retry &&
+          header.result() == boost::beast::http::status::unauthorized) {
         return;
       }
+      original->sink(header, chunk, ec);
+    };
+  }
+  Dispatch(std::move(pending));
+}
+
+void ConnectionPool::AfterAuthorizedResponse(
+    const std::weak_ptr<ConnectionPool>& weak_self,
+    const std::shared_ptr<PendingRequest>& original, const std::string& token,
+    bool may_retry, Response&& res) {
+  std::shared_ptr<ConnectionPool> self = weak_self.lock();
+  if (self == nullptr || !may_retry ||
+      res.Result() != boost::beast::http::status::unauthorized) {
+    original->callback(std::move(res));
+    return;
+  }
+  SPDLOG_DEBUG("Session for {} was rejected, logging in again",
+               self->destIP_);
+  // Other requests sent with the same token may fail the same way, but
+  // only the first needs to throw the session away
+  if (self->session_.token == token) {
+    self->session_ = Session();
+    if (self->sessionCache_ != nullptr) {
+      self->sessionCache_->Erase(self->SessionKey());
     }
+  }
+  self->authQueue_.emplace_back(std::move(*original));
+  if (self->session_.token.empty()) {
+    self->Login();
+    return;
+  }
+  // A new session was already created while this request was in flight
+  std::vector<PendingRequest> queue = std::move(self->authQueue_);
+  self->authQueue_.clear();
+  for (PendingRequest& pending : queue) {
+    self->SendAuthorized(std::move(pending), false);
+  }
+}
 
-    // All cipher suites are set as per OWASP datasheet.
-    // https://cheatsheetseries.owasp.org/cheatsheets/TLS_Cipher_String_Cheat_Sheet.html
-    constexpr const char* kSslCiphers =
-        "ECDHE-ECDSA-AES128-GCM-SHA256:"
-        "ECDHE-RSA-AES128-GCM-SHA256:"
-        "ECDHE-ECDSA-AES256-GCM-SHA384:"
-        "ECDHE-RSA-AES256-GCM-SHA384:"
-        "ECDHE-ECDSA-CHACHA20-POLY1305:"
-        "ECDHE-RSA-CHACHA20-POLY1305:"
-        "DHE-RSA-AES128-GCM-SHA256:"
-        "DHE-RSA-AES256-GCM-SHA384"
-        "TLS_AES_128_GCM_SHA256:"
-        "TLS_AES_256_GCM_SHA384:"
-        "TLS_CHACHA20_POLY1305_SHA256";
-
-    if (SSL_CTX_set_cipher_list(ssl_ctx.native_handle(), kSslCiphers) != 1) {
-      std::cout << "Error";
-      return;
+void ConnectionPool::Login() {
+  if (loginInProgress_) {
+    return;
+  }
+  loginInProgress_ = true;
+  SPDLOG_DEBUG("Logging in to {} as {}", destIP_, credentials_->username);
+
+  boost::json::object body{{"UserName", credentials_->username},
+                           {"Password", credentials_->password}};
+  boost::beast::http::fields headers;
+  headers.set(boost::beast::http::field::content_type, "application/json");
+  Dispatch(PendingRequest(
+      MakeRequest(boost::beast::http::verb::post,
+                  "/redfish/v1/SessionService/Sessions", headers,
+                  boost::json::serialize(body)),
+      std::bind_front(&ConnectionPool::AfterLogin, weak_from_this())));
+}
+
+void ConnectionPool::AfterLogin(const std::weak_ptr<ConnectionPool>& weak_self,
+                                Response&& res) {
+  std::shared_ptr<ConnectionPool> self = weak_self.lock();
+  if (self == nullptr) {
+    return;
+  }
+  self->loginInProgress_ = false;
+  std::string_view token = res.GetHeaderValue("X-Auth-Token");
+  std::vector<PendingRequest> queue = std::move(self->authQueue_);
+  self->authQueue_.clear();
+  if (boost::beast::http::to_status_class(res.Result()) !=
+          boost::beast::http::status_class::successful ||
+      token.empty()) {
+    SPDLOG_ERROR("Failed to log in to {}: {}", self->destIP_,
+                 static_cast<int>(res.Result()));
+    self->hostStats_->dropped_requests += queue.size();
+    for (PendingRequest& pending : queue) {
+      Response failed;
+      failed.string_response->result(res.Result());
+      pending.callback(std::move(failed));
     }
+    return;
+  }
+  self->stats_->logins++;
+  self->session_.token = token;
+  self->session_.location =
+      UriPath(res.GetHeader(boost::beast::http::field::location));
+  if (self->sessionCache_ != nullptr) {
+    self->sessionCache_->Store(self->SessionKey(), self->session_);
+  }
+  for (PendingRequest& pending : queue) {
+    self->SendAuthorized(std::move(pending), false);
+  }
+}
+
+void ConnectionPool::SetCredentials(
+    const Credentials& credentials,
+    const std::shared_ptr<SessionCache>& cache) {
+  sessionCache_ = cache;
+  if (credentials_ == credentials) {
+    return;
+  }
+  credentials_ = credentials;
+  session_ = Session();
+  if (sessionCache_ == nullptr) {
+    return;
+  }
+  std::optional<Session> session = sessionCache_->Find(SessionKey());
+  if (session) {
+    SPDLOG_DEBUG("Reusing cached session for {}", destIP_);
+    stats_->cached_sessions++;
+    session_ = std::move(*session);
+  }
+}
 
-    sslConn_.emplace(conn_, ssl_ctx);
-    SetCipherSuiteTlSext();
+void ConnectionPool::Logout(std::function<void(bool)>&& callback) {
+  if (!credentials_ || session_.token.empty() || session_.location.empty()) {
+    callback(false);
+    return;
   }
+  boost::beast::http::fields headers;
+  headers.set("X-Auth-Token", session_.token);
+  Dispatch(PendingRequest(
+      MakeRequest(boost::beast::http::verb::delete_, session_.location,
+                  headers, std::string()),
+      std::bind_front(&ConnectionPool::AfterLogout, weak_from_this(),
+                      std::move(callback))));
 }
 
-void ConnectionInfo::Start() { DoResolve(); }
+void ConnectionPool::AfterLogout(
+    const std::weak_ptr<ConnectionPool>& weak_self,
+    const std::function<void(bool)>& callback, Response&& res) {
+  std::shared_ptr<ConnectionPool> self = weak_self.lock();
+  if (self == nullptr) {
+    return;
+  }
+  // The session is forgotten either way; if the service didn't delete it,
+  // it's already gone or will time out
+  bool deleted = boost::beast::http::to_status_class(res.Result()) ==
+                 boost::beast::http::status_class::successful;
+  if (!deleted) {
+    SPDLOG_ERROR("Failed to delete session {}: {}", self->session_.location,
+                 static_cast<int>(res.Result()));
+  }
+  self->session_ = Session();
+  if (self->sessionCache_ != nullptr) {
+    self->sessionCache_->Erase(self->SessionKey());
+  }
+  callback(deleted);
+}
+
+std::string ConnectionPool::SessionKey() const {
+  return std::format("{}@{}://{}:{}", credentials_->username,
+                     policy_->use_tls ? "https" : "http", destIP_, destPort_);
+}
+
+boost::beast::http::request<boost::beast::http::string_body>
+ConnectionPool::MakeRequest(boost::beast::http::verb verb,
+                            std::string_view uri,
+                            const boost::beast::http::fields& http_header,
+                            std::string&& data) const {
+  boost::beast::http::request<boost::beast::http::string_body> req(
+      verb, uri, 11, "", http_header);
+  req.set(boost::beast::http::field::host, destIP_);
+  req.keep_alive(true);
+  req.body() = std::move(data);
+  req.prepare_payload();
+  return req;
+}
+
+void ConnectionPool::Dispatch(PendingRequest&& pending) {
+  // Timed from its first dispatch, so time spent in requestQueue_ counts
+  if (pending.queued_at == RequestTimings::Clock::time_point()) {
+    pending.queued_at = RequestTimings::Clock::now();
+  }
 
-void ConnectionPool::QueuePending(PendingRequest&& pending) {
   // If we have to queue it, push it into the request queue in time
-  // order
+  // order.  The queue is bounded by the client's RequestBudget.
+  hostStats_->Queued();
   if (pushInProgress_) {
-    if (requestQueue_.size() >= kMaxRequestQueueSize) {
-      return;
-    }
     requestQueue_.emplace_back(std::move(pending));
     return;
   }
 
-  // Make sure we have some connections open ready to receive
-  for (std::weak_ptr<ConnectionInfo>& weak_conn : connections_) {
+  // Make sure we have some connections open ready to receive.  Only need to
+  // construct one extra connection max.
+  Open(1);
+  pushInProgress_ = true;
+
+  SPDLOG_DEBUG("sending");
+
+  pending.pushed_at = RequestTimings::Clock::now();
+  std::function<void(Response&&)> callback = pending.callback;
+  channel_->async_send(
+      boost::system::error_code(), std::move(pending),
+      std::bind_front(&ConnectionPool::ChannelPushComplete, weak_from_this(),
+                      std::move(callback)));
+}
+
+std::size_t ConnectionPool::Open(std::size_t count) {
+  std::size_t max_connections =
+      std::clamp<std::size_t>(limit_->Limit(), 1, connections_.size());
+  if (protocol_->http2) {
+    // A host speaking HTTP/2 only needs the one
+    if (std::ranges::any_of(connections_,
+                            [](const std::weak_ptr<ConnectionInfo>& conn) {
+                              return !conn.expired();
+                            })) {
+      return 0;
+    }
+    count = std::min<std::size_t>(count, 1);
+  }
+  std::size_t opened = 0;
+  for (std::size_t index = 0; index < max_connections && opened < count;
+       index++) {
+    std::weak_ptr<ConnectionInfo>& weak_conn = connections_[index];
     std::shared_ptr<ConnectionInfo> conn = weak_conn.lock();
     if (conn != nullptr) {
       continue;
     }
 
     conn = std::make_shared<ConnectionInfo>(ioc_, destIP_, destPort_, policy_,
+                                            sslCtx_, sslSessions_, stats_,
                                             channel_);
+    conn->limit_ = limit_;
+    conn->index_ = index;
+    conn->protocol_ = protocol_;
+    conn->hostTimings_ = timings_;
+    conn->hostStats_ = hostStats_;
+    conn->tracer_ = tracer_;
     conn->Start();
     weak_conn = conn->weak_from_this();
-
-    // Only need to construct one extra connection max
-    break;
+    opened++;
   }
-  pushInProgress_ = true;
-
-  SPDLOG_DEBUG("sending");
+  return opened;
+}
 
-  channel_->async_send(
-      boost::system::error_code(), std::move(pending),
-      std::bind_front(&ConnectionPool::ChannelPushComplete, weak_from_this()));
+void ConnectionPool::Warm(std::size_t count) {
+  if (breaker_.IsOpen()) {
+    // The host is down, and the first request after the breaker closes
+    // opens a connection to find out if it's back
+    return;
+  }
+  std::size_t opened = Open(count);
+  if (opened > 0) {
+    SPDLOG_DEBUG("Opened {} connections to {} ahead of requests", opened,
+                 destIP_);
+    stats_->prewarmed_connections += opened;
+  }
 }
 
 void ConnectionPool::ChannelPushComplete(
     const std::weak_ptr<ConnectionPool>& weak_self,
+    const std::function<void(Response&&)>& callback,
     boost::system::error_code ec) {
   SPDLOG_DEBUG("Channel Push complete");
   std::shared_ptr<ConnectionPool> self = weak_self.lock();
+  if (ec) {
+    SPDLOG_ERROR("Channel Push failed: {}", ec);
+    if (self != nullptr) {
+      self->pushInProgress_ = false;
+      self->hostStats_->queued_requests--;
+      self->hostStats_->dropped_requests++;
+    }
+    callback(FailedResponse());
+    return;
+  }
   if (self == nullptr) {
     return;
   }
 
   self->pushInProgress_ = false;
-  if (ec) {
-    SPDLOG_ERROR("Channel Push failed: {}", ec);
-    return;
-  }
 
   if (!self->requestQueue_.empty()) {
-    self->pushInProgress_ = true;
-
-    SPDLOG_DEBUG("sending");
-
-    self->channel_->async_send(
-        boost::system::error_code(), std::move(self->requestQueue_.front()),
-        std::bind_front(&ConnectionPool::ChannelPushComplete,
-                        self->weak_from_this()));
+    // Dispatched like a new request, so that a connection is opened for it
+    // if the ones there were have failed
+    PendingRequest pending = std::move(self->requestQueue_.front());
     self->requestQueue_.pop_front();
+    self->hostStats_->queued_requests--;
+    self->Dispatch(std::move(pending));
   }
 }
 
 ConnectionPool::ConnectionPool(boost::asio::io_context& ioc_in,
                                std::string_view dest_ip_in,
                                uint16_t dest_port_in,
-                               const std::shared_ptr<ConnectPolicy>& policy_in)
+                               const std::shared_ptr<ConnectPolicy>& policy_in,
+                               const std::shared_ptr<boost::asio::ssl::context>& ssl_ctx_in,
+                               const std::shared_ptr<ClientStats>& stats_in,
+                               const std::shared_ptr<ConcurrencyLimit>& limit_in,
+                               const std::shared_ptr<HostProtocol>& protocol_in,
+                               const std::shared_ptr<HostTimings>& timings_in,
+                               const std::shared_ptr<HostStats>& host_stats_in)
     : ioc_(ioc_in),
       destIP_(dest_ip_in),
       destPort_(dest_port_in),
       policy_(policy_in),
+      sslCtx_(ssl_ctx_in),
+      stats_(stats_in),
+      sslSessions_(std::make_shared<TlsSessionCache>()),
+      limit_(limit_in),
+      protocol_(protocol_in),
+      timings_(timings_in),
+      hostStats_(host_stats_in),
+      breaker_(policy_in->breaker_threshold, policy_in->breaker_open_time),
       channel_(std::make_shared<Channel>(ioc_, 128)) {}
 
+ConnectionPool::~ConnectionPool() {
+  SPDLOG_DEBUG("destroying connection {:#010x}",
+               reinterpret_cast<intptr_t>(this));
+  // Requests still waiting are failed along with the pool.  Posted, as the
+  // pool's owner is part way through changing it.
+  std::vector<PendingRequest> dropped(
+      std::make_move_iterator(requestQueue_.begin()),
+      std::make_move_iterator(requestQueue_.end()));
+  while (channel_->try_receive(
+      [&dropped](boost::system::error_code ec, PendingRequest pending) {
+        if (!ec) {
+          dropped.emplace_back(std::move(pending));
+        }
+      })) {
+  }
+  hostStats_->queued_requests -= dropped.size();
+  dropped.insert(dropped.end(), std::make_move_iterator(authQueue_.begin()),
+                 std::make_move_iterator(authQueue_.end()));
+  hostStats_->dropped_requests += dropped.size();
+  for (PendingRequest& pending : dropped) {
+    boost::asio::post(ioc_, [callback = std::move(pending.callback)]() {
+      callback(FailedResponse());
+    });
+  }
+  for (auto& connection : connections_) {
+    auto conn = connection.lock();
+    if (conn) {
+      conn->ShutdownConn();
+    }
+  }
+}
+
 Client::Client(boost::asio::io_context& ioc_in, ConnectPolicy policy_in)
-    : policy_(std::make_shared<ConnectPolicy>(policy_in)), ioc_(ioc_in) {}
+    : policy_(std::make_shared<ConnectPolicy>(policy_in)),
+      stats_(std::make_shared<ClientStats>()),
+      responseCache_(std::make_shared<ResponseCache>(ioc_in, stats_)),
+      budget_(std::make_shared<RequestBudget>(
+          ioc_in, policy_in.max_requests_in_flight,
+          policy_in.max_waiting_requests)),
+      ioc_(ioc_in) {
+  if (policy_->use_tls) {
+    sslCtx_ = MakeSslContext(*policy_);
+  }
+}
 
-// Send request to destIP:destPort and use the provided callback to
-// handle the response
-void Client::SendData(std::string&& data, std::string_view dest_ip,
-                      uint16_t dest_port, std::string_view dest_uri,
-                      const boost::beast::http::fields& http_header,
-                      const boost::beast::http::verb verb,
-                      const std::function<void(Response&&)>& res_handler) {
+std::string Client::PoolKey(std::string_view dest_ip,
+                            uint16_t dest_port) const {
   std::string client_key = policy_->use_tls ? "https" : "http";
   client_key += dest_ip;
   client_key += ":";
   client_key += std::to_string(dest_port);
-  SPDLOG_DEBUG("Requesting {}{}", client_key, dest_uri);
+  return client_key;
+}
+
+std::shared_ptr<ConnectionPool>& Client::GetPool(std::string_view dest_ip,
+                                                 uint16_t dest_port) {
+  std::string client_key = PoolKey(dest_ip, dest_port);
   // Use nullptr to avoid creating a ConnectionPool each time
   std::shared_ptr<ConnectionPool>& conn = connectionPools_[client_key];
   if (conn == nullptr) {
     // Now actually create the ConnectionPool shared_ptr since it
     // does not already exist
-    conn = std::make_shared<ConnectionPool>(ioc_, dest_ip, dest_port, policy_);
+    std::shared_ptr<ConcurrencyLimit>& limit = concurrencyLimits_[client_key];
+    if (limit == nullptr) {
+      limit = std::make_shared<ConcurrencyLimit>(
+          policy_->initial_connections_per_host,
+          std::min<std::size_t>(policy_->max_connections_per_host,
+                                kMaxPoolSize),
+          policy_->adaptive_connections);
+    }
+    std::shared_ptr<HostProtocol>& protocol = hostProtocols_[client_key];
+    if (protocol == nullptr) {
+      protocol = std::make_shared<HostProtocol>();
+    }
+    std::string host_key = std::format("{}:{}", dest_ip, dest_port);
+    std::shared_ptr<HostTimings>& timings = hostTimings_[host_key];
+    if (timings == nullptr) {
+      timings = std::make_shared<HostTimings>();
+    }
+    std::shared_ptr<HostStats>& host_stats = hostStats_[host_key];
+    if (host_stats == nullptr) {
+      host_stats = std::make_shared<HostStats>();
+    }
+    conn = std::make_shared<ConnectionPool>(ioc_, dest_ip, dest_port, policy_,
+                                            sslCtx_, stats_, limit, protocol,
+                                            timings, host_stats);
+    conn->tracer_ = tracer_;
+    auto saved = savedLogins_.find(client_key);
+    if (saved != savedLogins_.end()) {
+      conn->credentials_ = std::move(saved->second.credentials);
+      conn->session_ = std::move(saved->second.session);
+      conn->sessionCache_ = sessionCache_;
+      savedLogins_.erase(saved);
+    }
+    if (policy_->prewarm_connections) {
+      // Connected while the first request is made, ready for the ones after
+      conn->Warm(limit->Limit());
+    }
+  }
+  return conn;
+}
+
+void Client::Warm(std::string_view dest_ip, uint16_t dest_port,
+                  std::size_t connections) {
+  GetPool(dest_ip, dest_port)->Warm(connections);
+}
+
+std::size_t Client::ConnectionLimit(std::string_view dest_ip,
+                                    uint16_t dest_port) const {
+  auto it = concurrencyLimits_.find(PoolKey(dest_ip, dest_port));
+  if (it == concurrencyLimits_.end()) {
+    return policy_->adaptive_connections
+               ? policy_->initial_connections_per_host
+               : policy_->max_connections_per_host;
+  }
+  return it->second->Limit();
+}
+
+std::map<std::string, HostTimings> Client::Timings() const {
+  std::map<std::string, HostTimings> timings;
+  for (const auto& [host, host_timings] : hostTimings_) {
+    timings.emplace(host, *host_timings);
+  }
+  return timings;
+}
+
+std::map<std::string, HostStats> Client::StatsByHost() const {
+  std::map<std::string, HostStats> stats;
+  for (const auto& [host, host_stats] : hostStats_) {
+    stats.emplace(host, *host_stats);
+  }
+  return stats;
+}
+
+void Client::Authenticate(std::string_view dest_ip, uint16_t dest_port,
+                          const Credentials& credentials) {
+  GetPool(dest_ip, dest_port)->SetCredentials(credentials, sessionCache_);
+}
+
+void Client::Close(std::string_view dest_ip, uint16_t dest_port) {
+  auto pool = connectionPools_.find(PoolKey(dest_ip, dest_port));
+  if (pool == connectionPools_.end()) {
+    return;
+  }
+  if (pool->second->credentials_) {
+    savedLogins_.insert_or_assign(
+        pool->first, SavedLogin{.credentials = *pool->second->credentials_,
+                                .session = pool->second->session_});
+  }
+  connectionPools_.erase(pool);
+}
+
+void Client::Logout(std::string_view dest_ip, uint16_t dest_port,
+                    std::function<void(bool)>&& callback) {
+  GetPool(dest_ip, dest_port)->Logout(std::move(callback));
+}
+
+// Send request to destIP:destPort and use the provided callback to
+// handle the response
+void Client::SendData(std::string&& data, std::string_view dest_ip,
+                      uint16_t dest_port, std::string_view dest_uri,
+                      const boost::beast::http::fields& http_header,
+                      const boost::beast::http::verb verb,
+                      const std::function<void(Response&&)>& res_handler,
+                      const BodySink& body_sink) {
+  SPDLOG_DEBUG("Requesting {}:{}{}", dest_ip, dest_port, dest_uri);
+  std::shared_ptr<ConnectionPool>& conn = GetPool(dest_ip, dest_port);
+
+  std::function<void(Response&&)> callback = res_handler;
+  BodySink sink = body_sink;
+  if (verb == boost::beast::http::verb::get && data.empty()) {
+    // Responses depend on who asked, so only requests made as the same
+    // user share one
+    std::string_view user =
+        conn->credentials_ ? conn->credentials_->username : "";
+    std::string cache_key = std::format(
+        "{}://{}@{}:{}{}", policy_->use_tls ? "https" : "http", user, dest_ip,
+        dest_port, dest_uri);
+    if (responseCache_->Join(
+            cache_key,
+            CacheWaiter{.callback = res_handler, .sink = body_sink})) {
+      return;
+    }
+    std::tie(callback, sink) = responseCache_->Begin(
+        cache_key, CacheWaiter{.callback = res_handler, .sink = body_sink});
   }
 
   // Send the data using either the existing connection pool or the
   // newly created connection pool Construct the request to be sent
-  boost::beast::http::request<boost::beast::http::string_body> this_req(
-      verb, dest_uri, 11, "", http_header);
-  this_req.set(boost::beast::http::field::host, dest_ip);
-  this_req.keep_alive(true);
-  this_req.body() = std::move(data);
-  this_req.prepare_payload();
-  conn->QueuePending(PendingRequest(std::move(this_req), res_handler));
+  PendingRequest pending(
+      conn->MakeRequest(verb, dest_uri, http_header, std::move(data)),
+      callback, sink);
+  if (tracer_ != nullptr) {
+    pending.trace_lane = tracer_->CurrentLane();
+  }
+  bool deferred = !budget_->HasRoom();
+  bool admitted = budget_->Acquire(
+      [&ioc = ioc_, weak_pool = std::weak_ptr<ConnectionPool>(conn),
+       pending = std::move(pending)](
+          const std::shared_ptr<RequestBudget::Slot>& slot) mutable {
+        pending.callback = [slot, callback = std::move(pending.callback)](
+                               Response&& res) { callback(std::move(res)); };
+        std::shared_ptr<ConnectionPool> pool = weak_pool.lock();
+        if (pool == nullptr) {
+          // The host was closed while the request waited for room
+          boost::asio::post(ioc, [callback = std::move(pending.callback)]() {
+            callback(FailedResponse());
+          });
+          return;
+        }
+        pool->Send(std::move(pending));
+      });
+  if (!admitted) {
+    SPDLOG_ERROR("Too many requests waiting, failing {}:{}{}", dest_ip,
+                 dest_port, dest_uri);
+    stats_->rejected_requests++;
+    // Failed from the io_context rather than from inside the caller
+    boost::asio::post(ioc_, [callback = std::move(callback)]() {
+      callback(FailedResponse());
+    });
+    return;
+  }
+  if (deferred) {
+    stats_->deferred_requests++;
+  }
 }
 }  // namespace http
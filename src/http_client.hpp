@@ -1,7 +1,10 @@
 #pragma once
 
+#include <openssl/ssl.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <boost/asio/async_result.hpp>
 #include <boost/asio/connect.hpp>
 #include <boost/asio/experimental/channel.hpp>
 #include <boost/asio/experimental/concurrent_channel.hpp>
@@ -23,59 +26,300 @@
 #include <boost/beast/version.hpp>
 #include <boost/container/devector.hpp>
 #include <boost/system/error_code.hpp>
+#include <chrono>
 #include <cstdlib>
+#include <deque>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <optional>
 #include <queue>
 #include <string>
+#include <vector>
 
+#include "async_handler.hpp"
+#include "circuit_breaker.hpp"
+#include "concurrency_limit.hpp"
 #include "http_response.hpp"
+#include "request_budget.hpp"
+#include "request_timings.hpp"
+#include "response_cache.hpp"
+#include "session_cache.hpp"
+#include "sink_body.hpp"
+#include "trace.hpp"
 
 namespace http {
 
-// It is assumed that the BMC should be able to handle 4 parallel
-// connections
-constexpr uint8_t kMaxPoolSize = 4;
-constexpr uint8_t kMaxRequestQueueSize = 50;
+// The most connections ever opened to one host.  How many are actually
+// used is learned per host (see ConcurrencyLimit).
+constexpr uint8_t kMaxPoolSize = 16;
+// Only applies to buffered responses; streamed bodies are never held in full
 constexpr unsigned int kHttpReadBodyLimit = 131072;
 constexpr unsigned int kHttpReadBufferSize = 4096;
 
+struct ConnectPolicy {
+  bool verify_server_certificate = true;
+  bool use_tls = true;
+  // Most connections opened to each host, at most kMaxPoolSize
+  std::size_t max_connections_per_host = kMaxPoolSize;
+  // Connections to a host start here, and grow or shrink with how the host
+  // copes.  If adaptive_connections is false, max_connections_per_host are
+  // always used.
+  std::size_t initial_connections_per_host = 2;
+  bool adaptive_connections = true;
+  // Open a host's connections up to its limit when it's first used, rather
+  // than one per request as they arrive
+  bool prewarm_connections = true;
+  // Connections left idle for longer than this are closed, so that the host
+  // can't close them first and leave a request to find out.  Set below the
+  // host's keep-alive timeout.  0 leaves them open.
+  std::chrono::seconds max_idle_time{15};
+  // Time allowed to resolve and connect to a host
+  std::chrono::seconds connect_timeout{10};
+  // GETs that fail without a response, or are answered 503 or 429, are
+  // retried up to max_retries times, after a jittered delay that starts
+  // around retry_delay and doubles each time, or the Retry-After if that's
+  // longer
+  std::size_t max_retries = 2;
+  std::chrono::milliseconds retry_delay{250};
+  std::chrono::milliseconds max_retry_delay{10000};
+  // After this many requests to a host in a row fail without a response,
+  // its requests fail straight away for breaker_open_time.  0 never gives
+  // up on a host.
+  std::size_t breaker_threshold = 5;
+  std::chrono::milliseconds breaker_open_time{30000};
+  // A GET that's gone unanswered for longer than this percentile of its
+  // host's recent latencies is sent again on another connection, if one is
+  // free under the host's limit, and whichever answers first is used.  0
+  // never hedges.
+  double hedge_percentile = 0;
+  // GETs sent down one connection at once without waiting for each other's
+  // responses, once every connection to the host is busy.  Hosts found to
+  // mishandle this go back to one at a time.  1 never pipelines.
+  std::size_t pipeline_depth = 1;
+  // Offer HTTP/2 over TLS, and carry every request to hosts that take it
+  // over one connection.  Ignored if rtool was built without nghttp2.
+  bool http2 = true;
+  // Requests outstanding at once across every host.  Requests past this
+  // wait for one to finish.
+  std::size_t max_requests_in_flight = 512;
+  // Requests allowed to wait for room before new ones are failed straight
+  // away.  0 never fails them.
+  std::size_t max_waiting_requests = 0;
+};
+
+// Counters describing what the client did over its lifetime
+struct ClientStats {
+  uint64_t full_handshakes = 0;
+  uint64_t resumed_handshakes = 0;
+  uint64_t logins = 0;
+  uint64_t cached_sessions = 0;
+  // GETs that shared a response with an identical request in flight
+  uint64_t coalesced_requests = 0;
+  // GETs answered from the response cache
+  uint64_t cached_responses = 0;
+  // Requests that waited for room under max_requests_in_flight
+  uint64_t deferred_requests = 0;
+  // Requests failed because max_waiting_requests were already waiting
+  uint64_t rejected_requests = 0;
+  // Attempts made again after a failure, a 503 or a 429
+  uint64_t retried_requests = 0;
+  // Requests failed straight away because their host's breaker was open
+  uint64_t short_circuited_requests = 0;
+  // Duplicate GETs sent for slow requests, and how many answered first
+  uint64_t hedged_requests = 0;
+  uint64_t hedges_won = 0;
+  // GETs written behind another request still waiting on its response
+  uint64_t pipelined_requests = 0;
+  // Hosts pipelining was turned off for, after they mishandled it
+  uint64_t pipeline_fallbacks = 0;
+  // Connections that negotiated HTTP/2, and the requests sent over them
+  uint64_t http2_connections = 0;
+  uint64_t http2_requests = 0;
+  // Connections opened ahead of the requests to use them
+  uint64_t prewarmed_connections = 0;
+  // Idle connections closed before the host could, or found closed by the
+  // host before a request was sent down them
+  uint64_t recycled_connections = 0;
+
+  ClientStats& operator+=(const ClientStats& other) {
+    full_handshakes += other.full_handshakes;
+    resumed_handshakes += other.resumed_handshakes;
+    logins += other.logins;
+    cached_sessions += other.cached_sessions;
+    coalesced_requests += other.coalesced_requests;
+    cached_responses += other.cached_responses;
+    deferred_requests += other.deferred_requests;
+    rejected_requests += other.rejected_requests;
+    retried_requests += other.retried_requests;
+    short_circuited_requests += other.short_circuited_requests;
+    hedged_requests += other.hedged_requests;
+    hedges_won += other.hedges_won;
+    pipelined_requests += other.pipelined_requests;
+    pipeline_fallbacks += other.pipeline_fallbacks;
+    http2_connections += other.http2_connections;
+    http2_requests += other.http2_requests;
+    prewarmed_connections += other.prewarmed_connections;
+    recycled_connections += other.recycled_connections;
+    return *this;
+  }
+};
+
+// Counters for the requests to one host
+struct HostStats {
+  // Requests written to the host, including retries, hedges and logins
+  uint64_t requests = 0;
+  // HTTP bytes written and read, before TLS
+  uint64_t bytes_sent = 0;
+  uint64_t bytes_received = 0;
+  // Connections opened, and requests sent down a connection that had
+  // already carried one
+  uint64_t opened_connections = 0;
+  uint64_t reused_connections = 0;
+  // Connections open, or being opened, now
+  uint64_t live_connections = 0;
+  // Connections the host wouldn't keep alive, reopened for the next request
+  uint64_t reconnects = 0;
+  // Connects, handshakes, writes and reads that took too long
+  uint64_t timeouts = 0;
+  // Requests dropped before they were sent, as the host couldn't be logged
+  // in to or was closed with them still queued
+  uint64_t dropped_requests = 0;
+  // Requests waiting for a connection now, and the most that ever have been
+  uint64_t queued_requests = 0;
+  uint64_t peak_queued_requests = 0;
+
+  HostStats& operator+=(const HostStats& other) {
+    requests += other.requests;
+    bytes_sent += other.bytes_sent;
+    bytes_received += other.bytes_received;
+    opened_connections += other.opened_connections;
+    reused_connections += other.reused_connections;
+    live_connections += other.live_connections;
+    reconnects += other.reconnects;
+    timeouts += other.timeouts;
+    dropped_requests += other.dropped_requests;
+    queued_requests += other.queued_requests;
+    // Peaks on different threads needn't have happened at the same time
+    peak_queued_requests =
+        std::max(peak_queued_requests, other.peak_queued_requests);
+    return *this;
+  }
+
+  // Counts one more request waiting for a connection
+  void Queued() {
+    queued_requests++;
+    peak_queued_requests = std::max(peak_queued_requests, queued_requests);
+  }
+};
+
+struct Credentials {
+  std::string username;
+  std::string password;
+
+  bool operator==(const Credentials&) const = default;
+};
+
+// Holds the most recent TLS session (TLS 1.2 session ticket or TLS 1.3 PSK)
+// handed out by a host, so that reconnects and additional connections to the
+// same host can resume instead of doing a full handshake.
+class TlsSessionCache {
+ private:
+  std::unique_ptr<SSL_SESSION, decltype(&SSL_SESSION_free)> session_{
+      nullptr, &SSL_SESSION_free};
+
+ public:
+  // Takes ownership of the reference held by session
+  void Store(SSL_SESSION* session);
+
+  // Offers the cached session (if any) for resumption on ssl, and registers
+  // this cache to receive any new sessions the server hands out on it.
+  void Attach(SSL* ssl);
+
+  // Called by openssl when the server issues a new session
+  static int OnNewSession(SSL* ssl, SSL_SESSION* session);
+};
+
+// Builds the TLS client context shared by every connection a Client makes.
+// Returns nullptr if the context couldn't be configured.
+std::shared_ptr<boost::asio::ssl::context> MakeSslContext(
+    const ConnectPolicy& policy);
+
+// Lets a request be abandoned once it's been handed to the connections.  A
+// request that hasn't been sent yet is skipped, and one that's in flight has
+// its connection closed.
+struct RequestCancel {
+  bool cancelled = false;
+  // Set by the connection while it's carrying the request
+  std::function<void()> on_cancel;
+
+  void Cancel() {
+    cancelled = true;
+    std::function<void()> callback = std::move(on_cancel);
+    on_cancel = nullptr;
+    if (callback) {
+      callback();
+    }
+  }
+};
+
 struct PendingRequest {
   boost::beast::http::request<boost::beast::http::string_body> req;
   std::function<void(Response&&)> callback;
+  // If set, the body is streamed here rather than buffered into the Response
+  BodySink sink;
+  std::shared_ptr<RequestCancel> cancel;
+  // When it was handed to the host's connections (see Dispatch), and sent
+  // down the channel to them
+  RequestTimings::Clock::time_point queued_at;
+  RequestTimings::Clock::time_point pushed_at;
+  // The lane of the traced work that made the request, or 0
+  uint64_t trace_lane = 0;
   PendingRequest(
       boost::beast::http::request<boost::beast::http::string_body>&& req_in,
-      const std::function<void(Response&&)>& callback_in)
-      : req(std::move(req_in)), callback(callback_in) {}
+      const std::function<void(Response&&)>& callback_in,
+      const BodySink& sink_in = nullptr)
+      : req(std::move(req_in)), callback(callback_in), sink(sink_in) {}
   PendingRequest() = default;
 };
 
+// What's been learned about which protocols a host speaks
+struct HostProtocol {
+  // Set the first time a pipelined exchange with the host fails.  Its
+  // connections go back to one request at a time from then on.
+  bool pipelining_broken = false;
+  // Set once the host has agreed to HTTP/2, after which one connection
+  // carries all of its requests
+  bool http2 = false;
+};
+
+class Http2Session;
+
 using Channel = boost::asio::experimental::concurrent_channel<void(
     boost::system::error_code, PendingRequest)>;
 
-struct ConnectPolicy {
-  bool verify_server_certificate = true;
-  bool use_tls = true;
-};
-
 class ConnectionInfo : public std::enable_shared_from_this<ConnectionInfo> {
  private:
   std::string host_;
   uint16_t port_;
 
   // Data buffers
-  using BodyType = boost::beast::http::string_body;
-  using RequestType = boost::beast::http::request<BodyType>;
+  using RequestType =
+      boost::beast::http::request<boost::beast::http::string_body>;
   std::optional<RequestType> req_;
-  std::optional<boost::beast::http::response_parser<BodyType> > parser_;
+  std::optional<boost::beast::http::response_parser<SinkBody> > parser_;
   boost::beast::flat_static_buffer<kHttpReadBufferSize> buffer_;
 
   // Async callables
   std::function<void(Response&&)> callback_;
+  BodySink sink_;
   boost::asio::ip::tcp::resolver resolver_;
   boost::asio::ip::tcp::socket conn_;
   std::shared_ptr<ConnectPolicy> policy_;
+  std::shared_ptr<boost::asio::ssl::context> sslCtx_;
+  std::shared_ptr<TlsSessionCache> sslSessions_;
+  std::shared_ptr<ClientStats> stats_;
   std::optional<boost::beast::ssl_stream<boost::asio::ip::tcp::socket&> >
       sslConn_;
 
@@ -83,6 +327,72 @@ class ConnectionInfo : public std::enable_shared_from_this<ConnectionInfo> {
 
   std::shared_ptr<Channel> channel_;
 
+  // Shared with the pool, and told how each request went
+  std::shared_ptr<ConcurrencyLimit> limit_;
+  // This connection's place in the pool.  Connections past the limit close
+  // once they're done with their request.
+  std::size_t index_ = 0;
+  ConcurrencyLimit::Clock::time_point sentAt_;
+  // Whether the request in flight has started going out on the socket
+  bool requestSent_ = false;
+  std::shared_ptr<RequestCancel> cancel_;
+
+  // Shared with the pool, and given the timings of every request answered
+  std::shared_ptr<HostTimings> hostTimings_;
+  std::shared_ptr<HostStats> hostStats_;
+  // Requests written since the connection was last opened
+  std::size_t exchanges_ = 0;
+  // The request in flight's timings so far
+  RequestTimings timings_;
+  RequestTimings::Clock::time_point queuedAt_;
+  // How long the last connect took, which the first request written after
+  // it is charged with if it was waiting at the time
+  RequestTimings setup_;
+  RequestTimings::Clock::time_point phaseStartedAt_;
+  RequestTimings::Clock::time_point connectedAt_;
+  bool setupClaimed_ = true;
+  RequestTimings::Clock::time_point headerReadAt_;
+
+  std::shared_ptr<Tracer> tracer_;
+  // This connection's lane, and the lane of the request in flight
+  uint64_t traceLane_ = 0;
+  uint64_t requestLane_ = 0;
+  // When the last exchange drawn on the connection's lane ended.  Pipelined
+  // exchanges are drawn from here, so they don't overlap.
+  RequestTimings::Clock::time_point tracedUntil_;
+
+  // Requests written behind req_ before its response came back, answered in
+  // the order they were sent.  Each is held by its write until that's done,
+  // so it's copied rather than moved out of here.
+  struct Pipelined {
+    std::shared_ptr<RequestType> req;
+    std::function<void(Response&&)> callback;
+    BodySink sink;
+    std::shared_ptr<RequestCancel> cancel;
+    ConcurrencyLimit::Clock::time_point sent_at;
+    RequestTimings::Clock::time_point queued_at;
+    uint64_t trace_lane;
+  };
+  std::deque<Pipelined> pipelined_;
+  // Requests this connection has taken on that are sent one at a time, once
+  // nothing is pipelined
+  std::deque<PendingRequest> waiting_;
+  std::shared_ptr<HostProtocol> protocol_;
+  bool pipelineWriting_ = false;
+  // Whether req_ was pipelined
+  bool pipelinedHead_ = false;
+  // Set when the connection's ready to carry on but a pipelined write is
+  // still going out, to whether it's kept alive
+  std::optional<bool> resumeAfterWrite_;
+
+  // Set once the host agrees to HTTP/2, after which this connection takes
+  // requests off the channel as fast as it can open streams for them
+  std::shared_ptr<Http2Session> http2_;
+  std::array<char, kHttpReadBufferSize> http2Buffer_;
+  bool http2Reading_ = false;
+  bool http2Writing_ = false;
+  bool http2Receiving_ = false;
+
   friend class ConnectionPool;
 
   void DoResolve();
@@ -110,12 +420,93 @@ class ConnectionInfo : public std::enable_shared_from_this<ConnectionInfo> {
   void OnIdleEvent(const std::weak_ptr<ConnectionInfo>& /*self*/,
                    const boost::system::error_code& ec);
 
+  // Closes the connection once it's been idle for max_idle_time
+  static void OnIdleTimeout(const std::weak_ptr<ConnectionInfo>& weak_self,
+                            boost::system::error_code ec);
+
+  // Whether the host has closed the idle connection, or is about to
+  bool IsStale();
+
   void AfterWrite(const std::shared_ptr<ConnectionInfo>& /*self*/,
                   const boost::beast::error_code& ec,
                   size_t /*bytesTransferred*/);
 
+  void WriteRequest();
+
+  // Makes pending the request in flight
+  void Take(PendingRequest&& pending);
+
+  // Writes more requests behind the one in flight, if the host is taking
+  // them
+  void Pipeline();
+
+  void AfterPipelinedWrite(const std::shared_ptr<ConnectionInfo>& /*self*/,
+                           const std::shared_ptr<RequestType>& /*req*/,
+                           const boost::beast::error_code& ec,
+                           size_t /*bytesTransferred*/);
+
+  // Makes the first pipelined request the one in flight, once the response
+  // ahead of it has been read
+  void PromotePipelined();
+
+  // Stops pipelining to the host after a pipelined exchange failed, and
+  // queues whatever was pipelined to be sent again one at a time
+  void Unpipeline(std::string_view reason);
+
+  // Carries on once a response has been read: with the next request if the
+  // connection's kept alive, or on a new connection if not
+  void Resume(bool keep_alive);
+
   void RecvMessage();
 
+  // Times the wait for the response's headers, then reads the body
+  void AfterReadHeader(const std::shared_ptr<ConnectionInfo>& /*self*/,
+                       const boost::beast::error_code& ec,
+                       std::size_t bytesTransferred);
+
+  // Starts the timings of a request handed to the connections at queued_at,
+  // and being written now.  The first request written after a connect that
+  // it waited on is charged with the connect.
+  RequestTimings StartTimings(RequestTimings::Clock::time_point queued_at,
+                              RequestTimings::Clock::time_point now);
+
+  // Counts pending as taken off the channel, and draws the time it spent
+  // waiting for a connection on the lane of the work that made it, if
+  // that's being traced.  Only done once.
+  void Dequeue(PendingRequest& pending, RequestTimings::Clock::time_point now);
+
+  // Draws the exchange in flight, which got res, on this connection's lane
+  void TraceExchange(const Response& res);
+
+  // Records on this connection's lane, if it's being traced
+  void TraceSpan(std::string_view name, RequestTimings::Clock::time_point start,
+                 RequestTimings::Clock::time_point end,
+                 std::string_view detail = {});
+  void TraceEvent(std::string_view name, std::string_view detail = {});
+
+  Response ReleaseResponse();
+
+  // Hands res to the callback for the request in flight, if there is one
+  void Complete(Response&& res);
+
+  // Gives up on the request in flight, which was cancelled
+  void Abandon();
+
+  // Fails the request in flight and those this connection took on, after it
+  // couldn't be set up.  Requests still on the channel are only failed too if
+  // this was the host's last connection.
+  void FailRequests();
+
+  // Completes the request in flight after the connection broke, and sends
+  // anything pipelined behind it again on a new connection
+  void FailInFlight(Response&& res);
+
+  // Reads the rest of the body, once the headers are in
+  void ReadBody(const std::shared_ptr<ConnectionInfo>& self);
+  void AfterReadBody(const std::shared_ptr<ConnectionInfo>& self,
+                     const boost::beast::error_code& ec,
+                     std::size_t bytesTransferred);
+
   void AfterRead(const std::shared_ptr<ConnectionInfo>& /*self*/,
                  const boost::beast::error_code& ec,
                  std::size_t /*bytesTransferred*/);
@@ -128,26 +519,88 @@ class ConnectionInfo : public std::enable_shared_from_this<ConnectionInfo> {
 
   void ShutdownConn();
 
+  void CloseSocket();
+
   void DoClose();
 
+  void DoReconnect();
+
   void AfterSslShutdown(const std::shared_ptr<ConnectionInfo>& /*self*/,
                         const boost::system::error_code& ec);
+
+  // Carries this connection's requests as HTTP/2 streams from now on
+  void StartHttp2();
+
+  // Takes another request off the channel, if a stream can be opened for it
+  void ReceiveHttp2();
+
+  void OnHttp2Request(const std::shared_ptr<ConnectionInfo>& /*self*/,
+                      boost::system::error_code ec, PendingRequest pending);
+
+  void SubmitHttp2(PendingRequest&& pending);
+
+  void ReadHttp2();
+
+  void AfterHttp2Read(const std::shared_ptr<ConnectionInfo>& /*self*/,
+                      const boost::system::error_code& ec,
+                      std::size_t bytesTransferred);
+
+  // Writes whatever the session has to send
+  void FlushHttp2();
+
+  void AfterHttp2Write(const std::shared_ptr<ConnectionInfo>& /*self*/,
+                       const std::shared_ptr<std::string>& /*data*/,
+                       const boost::system::error_code& ec,
+                       std::size_t /*bytesTransferred*/);
+
+  // Fails every open stream, and closes the connection
+  void CloseHttp2();
+
+  // Once a closed connection's stream is no longer in use, reconnects for
+  // a request taken off the channel in the meantime
+  void RestartHttp2();
   void SetCipherSuiteTlSext();
 
+  void CreateSslStream();
+
  public:
-  explicit ConnectionInfo(boost::asio::io_context& ioc_in,
-                          const std::string& dest_ip_in, uint16_t dest_port_in,
-                          const std::shared_ptr<ConnectPolicy>& policy,
-                          const std::shared_ptr<Channel>& channel_in);
+  explicit ConnectionInfo(
+      boost::asio::io_context& ioc_in, const std::string& dest_ip_in,
+      uint16_t dest_port_in, const std::shared_ptr<ConnectPolicy>& policy,
+      const std::shared_ptr<boost::asio::ssl::context>& ssl_ctx,
+      const std::shared_ptr<TlsSessionCache>& ssl_sessions,
+      const std::shared_ptr<ClientStats>& stats,
+      const std::shared_ptr<Channel>& channel_in);
+  ~ConnectionInfo();
+
+  ConnectionInfo(const ConnectionInfo&) = delete;
+  ConnectionInfo(ConnectionInfo&&) = delete;
+  ConnectionInfo& operator=(const ConnectionInfo&) = delete;
+  ConnectionInfo& operator=(ConnectionInfo&&) = delete;
+
   void Start();
 };
 
+struct HedgeRace;
+
 class ConnectionPool : public std::enable_shared_from_this<ConnectionPool> {
  private:
   boost::asio::io_context& ioc_;
   std::string destIP_;
   uint16_t destPort_;
   std::shared_ptr<ConnectPolicy> policy_;
+  std::shared_ptr<boost::asio::ssl::context> sslCtx_;
+  std::shared_ptr<ClientStats> stats_;
+  // TLS sessions are only valid for the host that issued them, so they're
+  // cached per pool
+  std::shared_ptr<TlsSessionCache> sslSessions_;
+  // Connections to open, learned from how the host responds
+  std::shared_ptr<ConcurrencyLimit> limit_;
+  std::shared_ptr<HostProtocol> protocol_;
+  std::shared_ptr<HostTimings> timings_;
+  std::shared_ptr<HostStats> hostStats_;
+  std::shared_ptr<Tracer> tracer_;
+  CircuitBreaker breaker_;
   std::array<std::weak_ptr<ConnectionInfo>, kMaxPoolSize> connections_;
 
   // Note, this is sorted by value.attemptAfter, to ensure that we queue
@@ -158,28 +611,106 @@ class ConnectionPool : public std::enable_shared_from_this<ConnectionPool> {
   bool pushInProgress_ = false;
   std::shared_ptr<Channel> channel_;
 
+  // Session authentication.  When credentials are set, every request carries
+  // the session token, and requests made while there's no session are held
+  // until a login completes.
+  std::optional<Credentials> credentials_;
+  std::shared_ptr<SessionCache> sessionCache_;
+  Session session_;
+  bool loginInProgress_ = false;
+  std::vector<PendingRequest> authQueue_;
+
   friend class Client;
 
+  // Sends a request, retrying it if it's a GET that failed, and failing it
+  // straight away if the host is down
+  void Send(PendingRequest&& pending);
+
+  void Attempt(const std::shared_ptr<PendingRequest>& original,
+               std::size_t attempt);
+
+  static void AfterAttempt(const std::weak_ptr<ConnectionPool>& weak_self,
+                           const std::shared_ptr<PendingRequest>& original,
+                           std::size_t attempt, bool may_retry,
+                           Response&& res);
+
+  // How long to wait before retrying after attempt failed with res
+  std::chrono::milliseconds RetryDelay(std::size_t attempt,
+                                       const Response& res) const;
+
+  // How long a GET may go unanswered before it's hedged, if it may be
+  std::optional<ConcurrencyLimit::Clock::duration> HedgeDelay(
+      boost::beast::http::verb verb) const;
+
+  // Whether a hedge sent now would go straight out on a connection, rather
+  // than wait behind other requests
+  bool CanHedge() const;
+
+  static void OnHedgeTimer(const std::weak_ptr<ConnectionPool>& weak_self,
+                           const std::shared_ptr<HedgeRace>& race,
+                           PendingRequest hedge,
+                           const boost::system::error_code& ec);
+
   void QueuePending(PendingRequest&& pending);
 
+  // Hands a request to the connections without any authentication
+  void Dispatch(PendingRequest&& pending);
+
+  // Opens up to count more connections, as far as the host's limit allows.
+  // Returns how many were opened.
+  std::size_t Open(std::size_t count);
+
+  // Opens connections ahead of the requests that will use them
+  void Warm(std::size_t count);
+
+  void SendAuthorized(PendingRequest&& pending, bool may_retry);
+
+  static void AfterAuthorizedResponse(
+      const std::weak_ptr<ConnectionPool>& weak_self,
+      const std::shared_ptr<PendingRequest>& original,
+      const std::string& token, bool may_retry, Response&& res);
+
+  void Login();
+
+  static void AfterLogin(const std::weak_ptr<ConnectionPool>& weak_self,
+                         Response&& res);
+
+  // Does nothing if credentials are the ones already set.  Otherwise the
+  // session made with the old ones is dropped.
+  void SetCredentials(const Credentials& credentials,
+                      const std::shared_ptr<SessionCache>& cache);
+
+  void Logout(std::function<void(bool)>&& callback);
+
+  static void AfterLogout(const std::weak_ptr<ConnectionPool>& weak_self,
+                          const std::function<void(bool)>& callback,
+                          Response&& res);
+
+  // Identifies this pool's session in the session cache
+  std::string SessionKey() const;
+
+  boost::beast::http::request<boost::beast::http::string_body> MakeRequest(
+      boost::beast::http::verb verb, std::string_view uri,
+      const boost::beast::http::fields& http_header, std::string&& data) const;
+
+  // callback is the pushed request's, failed if the push is
   static void ChannelPushComplete(
       const std::weak_ptr<ConnectionPool>& weak_self,
+      const std::function<void(Response&&)>& callback,
       boost::system::error_code ec);
 
  public:
   ConnectionPool(boost::asio::io_context& ioc_in, std::string_view dest_ip_in,
                  uint16_t dest_port_in,
-                 const std::shared_ptr<ConnectPolicy>& policy);
-
-  ~ConnectionPool() {
-    SPDLOG_DEBUG("destroying connection {:#010x}", reinterpret_cast<intptr_t>(this));
-    for (auto& connection : connections_) {
-      auto conn = connection.lock();
-      if (conn) {
-        conn->ShutdownConn();
-      }
-    }
-  }
+                 const std::shared_ptr<ConnectPolicy>& policy,
+                 const std::shared_ptr<boost::asio::ssl::context>& ssl_ctx,
+                 const std::shared_ptr<ClientStats>& stats,
+                 const std::shared_ptr<ConcurrencyLimit>& limit,
+                 const std::shared_ptr<HostProtocol>& protocol,
+                 const std::shared_ptr<HostTimings>& timings,
+                 const std::shared_ptr<HostStats>& host_stats);
+
+  ~ConnectionPool();
 
   ConnectionPool(const ConnectionPool&) = delete;
   ConnectionPool(ConnectionPool&&) = delete;
@@ -191,10 +722,39 @@ class Client {
  private:
   std::unordered_map<std::string, std::shared_ptr<ConnectionPool> >
       connectionPools_;
+  // Kept after a host's pool is closed, so a host queried again starts from
+  // what was learned about it
+  std::unordered_map<std::string, std::shared_ptr<ConcurrencyLimit> >
+      concurrencyLimits_;
+  std::unordered_map<std::string, std::shared_ptr<HostProtocol> >
+      hostProtocols_;
+  // By host:port, as the scheme is the same for every host
+  std::unordered_map<std::string, std::shared_ptr<HostTimings> >
+      hostTimings_;
+  std::unordered_map<std::string, std::shared_ptr<HostStats> > hostStats_;
+  // The credentials and session of hosts whose pool was closed, so that a
+  // host used again carries on with the same session
+  struct SavedLogin {
+    Credentials credentials;
+    Session session;
+  };
+  std::unordered_map<std::string, SavedLogin> savedLogins_;
 
   std::shared_ptr<ConnectPolicy> policy_;
+  // Built once, and shared by every connection this client makes
+  std::shared_ptr<boost::asio::ssl::context> sslCtx_;
+  std::shared_ptr<ClientStats> stats_;
+  std::shared_ptr<SessionCache> sessionCache_;
+  std::shared_ptr<ResponseCache> responseCache_;
+  std::shared_ptr<RequestBudget> budget_;
+  std::shared_ptr<Tracer> tracer_;
   boost::asio::io_context& ioc_;
 
+  std::string PoolKey(std::string_view dest_ip, uint16_t dest_port) const;
+
+  std::shared_ptr<ConnectionPool>& GetPool(std::string_view dest_ip,
+                                           uint16_t dest_port);
+
  public:
   Client(const Client&) = delete;
   Client& operator=(const Client&) = delete;
@@ -205,11 +765,139 @@ class Client {
   Client(boost::asio::io_context& ioc_in, ConnectPolicy policy);
 
   // Send request to destIP:destPort and use the provided callback to
-  // handle the response
+  // handle the response.  If body_sink is provided, the response body is
+  // streamed to it as it arrives, and the Response given to res_handler has
+  // an empty body.
+  //
+  // GETs without a body share a response with any identical GET that's in
+  // flight or cached (see SetResponseCacheSize).
+  //
+  // Past max_requests_in_flight the request waits for room, and past
+  // max_waiting_requests it fails with status unknown.  res_handler is
+  // always called, whatever happens to the request.
   void SendData(std::string&& data, std::string_view dest_ip,
                 uint16_t dest_port, std::string_view dest_uri,
                 const boost::beast::http::fields& http_header,
                 boost::beast::http::verb verb,
-                const std::function<void(Response&&)>& res_handler);
+                const std::function<void(Response&&)>& res_handler,
+                const BodySink& body_sink = nullptr);
+
+  // SendData for any asio completion token, completing with the Response.
+  // For example, from a coroutine:
+  //   Response res = co_await client.AsyncSendData(
+  //       "", host, port, "/redfish/v1", {}, verb::get, use_awaitable);
+  template <typename CompletionToken>
+  auto AsyncSendData(std::string data, std::string_view dest_ip,
+                     uint16_t dest_port, std::string_view dest_uri,
+                     const boost::beast::http::fields& http_header,
+                     boost::beast::http::verb verb, CompletionToken&& token) {
+    // Initiation may be deferred (it is for use_awaitable), so nothing the
+    // caller passed by reference can be held on to
+    return boost::asio::async_initiate<CompletionToken, void(Response)>(
+        [this](auto handler, std::string data, const std::string& dest_ip,
+               uint16_t dest_port, const std::string& dest_uri,
+               const boost::beast::http::fields& http_header,
+               boost::beast::http::verb verb) {
+          SendData(std::move(data), dest_ip, dest_port, dest_uri, http_header,
+                   verb,
+                   BindHandler<Response>(std::move(handler), GetExecutor()));
+        },
+        token, std::move(data), std::string(dest_ip), dest_port,
+        std::string(dest_uri), http_header, verb);
+  }
+
+  // Whether a request made now would go out without waiting for room under
+  // max_requests_in_flight
+  bool HasRoom() const { return budget_->HasRoom(); }
+
+  // Calls callback once HasRoom, straight away if it already does.  Callers
+  // making requests in bulk wait on this before making more, so the requests
+  // waiting for room stay bounded.
+  void WhenRoom(std::function<void()>&& callback) {
+    budget_->WhenRoom(std::move(callback));
+  }
+
+  // WhenRoom for any asio completion token.  For example, from a coroutine:
+  //   co_await client.AsyncWaitForRoom(use_awaitable);
+  template <typename CompletionToken>
+  auto AsyncWaitForRoom(CompletionToken&& token) {
+    return boost::asio::async_initiate<CompletionToken, void()>(
+        [this](auto handler) {
+          auto shared =
+              std::make_shared<std::decay_t<decltype(handler)> >(
+                  std::move(handler));
+          WhenRoom([shared, executor = GetExecutor()]() {
+            boost::asio::dispatch(
+                boost::asio::get_associated_executor(*shared, executor),
+                [shared]() { std::move(*shared)(); });
+          });
+        },
+        token);
+  }
+
+  boost::asio::io_context::executor_type GetExecutor() const {
+    return ioc_.get_executor();
+  }
+
+  // Keep up to max_entries completed GET responses for the lifetime of the
+  // client.  The default of 0 only shares responses between identical
+  // requests that are in flight at the same time.
+  void SetResponseCacheSize(std::size_t max_entries) {
+    responseCache_->SetMaxEntries(max_entries);
+  }
+
+  // Record what every connection does, and the time each request spends
+  // waiting for one, in tracer.  Requests are drawn on the lane that's
+  // current when they're made (see Tracer::LaneScope).  Must be called
+  // before the first request.
+  void SetTracer(const std::shared_ptr<Tracer>& tracer) { tracer_ = tracer; }
+
+  const std::shared_ptr<Tracer>& GetTracer() const { return tracer_; }
+
+  // Persist session tokens here, so later clients can reuse them.  Must be
+  // called before Authenticate.
+  void SetSessionCache(const std::shared_ptr<SessionCache>& cache) {
+    sessionCache_ = cache;
+  }
+
+  // Authenticate every request to destIP:destPort with a Redfish session,
+  // logged into with credentials on first use, and again whenever the
+  // service rejects the token.  Calling it again with the same credentials
+  // does nothing; with different ones, the next request logs in with them.
+  void Authenticate(std::string_view dest_ip, uint16_t dest_port,
+                    const Credentials& credentials);
+
+  // Opens up to connections to destIP:destPort ahead of the requests that
+  // will use them, as far as the host's connection limit allows.  Pools are
+  // warmed up to their limit when first used if prewarm_connections is set;
+  // this is for callers that know a burst of requests is coming.
+  void Warm(std::string_view dest_ip, uint16_t dest_port,
+            std::size_t connections);
+
+  // Closes every connection to destIP:destPort, and fails any requests still
+  // queued for it.  Its credentials and session are kept, and used by the
+  // next request to it.  Must not be called from within a callback for a
+  // request to that host.
+  void Close(std::string_view dest_ip, uint16_t dest_port);
+
+  // Deletes the session with destIP:destPort, if there is one.  callback is
+  // called with whether a session was deleted.
+  void Logout(std::string_view dest_ip, uint16_t dest_port,
+              std::function<void(bool)>&& callback);
+
+  // Connections currently allowed to destIP:destPort
+  std::size_t ConnectionLimit(std::string_view dest_ip,
+                              uint16_t dest_port) const;
+
+  const ClientStats& Stats() const { return *stats_; }
+
+  // What was sent to each host, and how, by host:port.  Like everything
+  // else here, read on the client's io_context; clients on other threads
+  // are read there and summed.
+  std::map<std::string, HostStats> StatsByHost() const;
+
+  // How long each phase of the requests answered by each host took, by
+  // host:port
+  std::map<std::string, HostTimings> Timings() const;
 };
 }  // namespace http
@@ -6,6 +6,7 @@
 #include <string_view>
 
 #include "hex_utils.hpp"
+#include "request_timings.hpp"
 
 namespace http {
 
@@ -20,6 +21,10 @@ struct Response {
 
   std::optional<ResponseType> string_response;
 
+  // How long each phase of the exchange took.  Left zero for responses that
+  // didn't come from the network, such as ones replayed from the cache.
+  RequestTimings timings;
+
   std::string_view GetHeader(boost::beast::http::field key) {
     return (*string_response)[key];
   }
@@ -27,16 +32,18 @@ struct Response {
   Response() : string_response(ResponseType{}) {}
 
   explicit Response(ResponseType&& string_response_in)
-      : string_response(string_response_in) {}
+      : string_response(std::move(string_response_in)) {}
 
   ~Response() = default;
 
-  Response(Response&& res) = delete;
+  // Movable so that a Response can be the result of an asynchronous
+  // operation (see Client::AsyncSendData)
+  Response(Response&& res) = default;
   Response(const Response&) = delete;
 
   Response& operator=(const Response& r) = delete;
 
-  Response& operator=(Response&& r) = delete;
+  Response& operator=(Response&& r) = default;
 
   boost::beast::http::status Result() const {
     return string_response->result();
@@ -1,7 +1,9 @@
-#include <boost/json.h>
+#include "json.hpp"
+
+#include <ostream>
 
 void PrettyPrint(std::ostream& os, boost::json::value const& jv,
-                 std::string* indent = nullptr) {
+                 std::string* indent) {
   std::string local_indent;
   if (indent == nullptr) {
     indent = &local_indent;
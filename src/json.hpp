@@ -1,6 +1,7 @@
 #pragma once
 
 #include <boost/json.hpp>
+#include <iosfwd>
 #include <string>
 
 void PrettyPrint(std::ostream& os, boost::json::value const& jv,
@@ -0,0 +1,641 @@
+#include "mock_bmc.hpp"
+
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/beast/ssl/ssl_stream.hpp>
+#include <charconv>
+#include <format>
+#include <functional>
+#include <string>
+#include <unordered_set>
+
+namespace {
+
+using boost::beast::http::field;
+using boost::beast::http::status;
+using boost::beast::http::verb;
+
+constexpr std::string_view kServiceRoot = "/redfish/v1";
+constexpr std::string_view kSessions = "/redfish/v1/SessionService/Sessions";
+constexpr int64_t kMaxExpandLevels = 6;
+
+boost::json::object Link(std::string_view uri) { return {{"@odata.id", uri}}; }
+
+boost::json::object Collection(std::string_view uri, std::string_view type,
+                               std::string_view name, std::size_t count) {
+  boost::json::array members;
+  for (std::size_t index = 1; index <= count; index++) {
+    members.emplace_back(Link(std::format("{}/{}", uri, index)));
+  }
+  return {
+      {"@odata.id", uri},
+      {"@odata.type", type},
+      {"Name", name},
+      {"Members", std::move(members)},
+      {"Members@odata.count", count},
+  };
+}
+
+boost::json::object Error(std::string_view code, std::string_view message) {
+  return {{"error", {{"code", code}, {"message", message}}}};
+}
+
+boost::json::object Status() {
+  return {{"State", "Enabled"}, {"Health", "OK"}};
+}
+
+std::vector<std::string_view> Split(std::string_view str, char delimiter) {
+  std::vector<std::string_view> parts;
+  while (!str.empty()) {
+    std::size_t end = str.find(delimiter);
+    parts.push_back(str.substr(0, end));
+    if (end == std::string_view::npos) {
+      break;
+    }
+    str.remove_prefix(end + 1);
+  }
+  return parts;
+}
+
+// Members are numbered from 1, so 0 is never a member
+std::size_t ParseIndex(std::string_view segment, std::size_t count) {
+  std::size_t index = 0;
+  auto [end, ec] =
+      std::from_chars(segment.data(), segment.data() + segment.size(), index);
+  if (ec != std::errc() || end != segment.data() + segment.size() ||
+      index > count) {
+    return 0;
+  }
+  return index;
+}
+
+// The path of a request target, without its query or any trailing slash
+std::string_view TargetPath(std::string_view target) {
+  std::string_view path = target.substr(0, target.find('?'));
+  while (path.size() > 1 && path.ends_with('/')) {
+    path.remove_suffix(1);
+  }
+  return path;
+}
+
+// A throwaway self-signed certificate, which clients have to be told not to
+// verify
+std::shared_ptr<boost::asio::ssl::context> MakeServerSslContext() {
+  auto ssl_ctx = std::make_shared<boost::asio::ssl::context>(
+      boost::asio::ssl::context::tls_server);
+  std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(EVP_EC_gen("P-256"),
+                                                          &EVP_PKEY_free);
+  std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), &X509_free);
+  if (key == nullptr || cert == nullptr) {
+    return nullptr;
+  }
+  X509_set_version(cert.get(), 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert.get()), 60L * 60 * 24 * 365);
+  X509_NAME* name = X509_get_subject_name(cert.get());
+  X509_NAME_add_entry_by_txt(
+      name, "CN", MBSTRING_ASC,
+      reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+  X509_set_issuer_name(cert.get(), name);
+  X509_set_pubkey(cert.get(), key.get());
+  if (X509_sign(cert.get(), key.get(), EVP_sha256()) == 0 ||
+      SSL_CTX_use_certificate(ssl_ctx->native_handle(), cert.get()) != 1 ||
+      SSL_CTX_use_PrivateKey(ssl_ctx->native_handle(), key.get()) != 1) {
+    return nullptr;
+  }
+  return ssl_ctx;
+}
+
+}  // namespace
+
+std::optional<boost::json::object> MockRedfishTree::Resource(
+    std::string_view path) const {
+  path = TargetPath(path);
+  if (path == kServiceRoot) {
+    bool expand = options_.expand;
+    return boost::json::object{
+        {"@odata.id", kServiceRoot},
+        {"@odata.type", "#ServiceRoot.v1_15_0.ServiceRoot"},
+        {"Id", "RootService"},
+        {"Name", "Root Service"},
+        {"RedfishVersion", "1.17.0"},
+        {"Chassis", Link("/redfish/v1/Chassis")},
+        {"SessionService", Link("/redfish/v1/SessionService")},
+        {"Links", {{"Sessions", Link(kSessions)}}},
+        {"ProtocolFeaturesSupported",
+         {{"ExpandQuery",
+           {{"ExpandAll", expand},
+            {"Levels", expand},
+            {"Links", false},
+            {"NoLinks", expand},
+            {"MaxLevels", kMaxExpandLevels}}},
+          {"SelectQuery", options_.select}}},
+    };
+  }
+  if (!path.starts_with(kServiceRoot) ||
+      !path.substr(kServiceRoot.size()).starts_with('/')) {
+    return std::nullopt;
+  }
+  std::vector<std::string_view> segments =
+      Split(path.substr(kServiceRoot.size() + 1), '/');
+
+  if (segments[0] == "SessionService") {
+    if (segments.size() == 1) {
+      return boost::json::object{
+          {"@odata.id", "/redfish/v1/SessionService"},
+          {"@odata.type", "#SessionService.v1_1_8.SessionService"},
+          {"Id", "SessionService"},
+          {"Name", "Session Service"},
+          {"Sessions", Link(kSessions)},
+      };
+    }
+    if (segments.size() == 2 && segments[1] == "Sessions") {
+      // Sessions aren't kept, so there are never any to list
+      return Collection(kSessions,
+                        "#SessionCollection.SessionCollection",
+                        "Session Collection", 0);
+    }
+    return std::nullopt;
+  }
+
+  if (segments[0] != "Chassis") {
+    return std::nullopt;
+  }
+  if (segments.size() == 1) {
+    return Collection("/redfish/v1/Chassis",
+                      "#ChassisCollection.ChassisCollection",
+                      "Chassis Collection", options_.chassis);
+  }
+  std::size_t chassis = ParseIndex(segments[1], options_.chassis);
+  if (chassis == 0) {
+    return std::nullopt;
+  }
+  std::string chassis_uri = std::format("/redfish/v1/Chassis/{}", chassis);
+  if (segments.size() == 2) {
+    boost::json::object resource{
+        {"@odata.id", chassis_uri},
+        {"@odata.type", "#Chassis.v1_21_0.Chassis"},
+        {"Id", std::to_string(chassis)},
+        {"Name", std::format("Chassis {}", chassis)},
+        {"ChassisType", chassis == 1 ? "RackMount" : "Module"},
+        {"Status", Status()},
+        {"Sensors", Link(chassis_uri + "/Sensors")},
+    };
+    // Every other chassis sits in the first, which gives $expand=* links
+    // to follow the way a real tree does
+    if (chassis != 1) {
+      resource["Links"] = {{"ContainedBy", Link("/redfish/v1/Chassis/1")}};
+    }
+    return resource;
+  }
+  if (segments[2] != "Sensors") {
+    return std::nullopt;
+  }
+  std::string sensors_uri = chassis_uri + "/Sensors";
+  if (segments.size() == 3) {
+    return Collection(sensors_uri, "#SensorCollection.SensorCollection",
+                      "Sensor Collection", options_.sensors_per_chassis);
+  }
+  std::size_t sensor = ParseIndex(segments[3], options_.sensors_per_chassis);
+  if (segments.size() != 4 || sensor == 0) {
+    return std::nullopt;
+  }
+  // Readings are made up, but the same on every request, so that results
+  // can be checked
+  double reading =
+      20.0 + static_cast<double>((chassis * 31 + sensor * 7) % 600) / 10.0;
+  return boost::json::object{
+      {"@odata.id", std::format("{}/{}", sensors_uri, sensor)},
+      {"@odata.type", "#Sensor.v1_7_0.Sensor"},
+      {"Id", std::to_string(sensor)},
+      {"Name", std::format("Chassis {} Temp {}", chassis, sensor)},
+      {"ReadingType", "Temperature"},
+      {"ReadingUnits", "Cel"},
+      {"Reading", reading},
+      {"Status", Status()},
+  };
+}
+
+void MockRedfishTree::Expand(boost::json::value& value, bool links,
+                             int64_t levels) const {
+  if (levels <= 0) {
+    return;
+  }
+  if (boost::json::array* array = value.if_array()) {
+    for (boost::json::value& element : *array) {
+      Expand(element, links, levels);
+    }
+    return;
+  }
+  boost::json::object* obj = value.if_object();
+  if (obj == nullptr) {
+    return;
+  }
+  const boost::json::value* uri = obj->if_contains("@odata.id");
+  if (obj->size() == 1 && uri != nullptr && uri->is_string()) {
+    const boost::json::string& link = uri->get_string();
+    std::optional<boost::json::object> resource =
+        Resource(std::string_view(link.data(), link.size()));
+    if (resource) {
+      value = std::move(*resource);
+      Expand(value, links, levels - 1);
+    }
+    return;
+  }
+  for (auto& [key, child] : *obj) {
+    if (key == "Links" && !links) {
+      continue;
+    }
+    Expand(child, links, levels);
+  }
+}
+
+std::optional<boost::json::object> MockRedfishTree::Get(
+    std::string_view target) const {
+  std::optional<boost::json::object> resource = Resource(target);
+  if (!resource) {
+    return std::nullopt;
+  }
+  std::size_t query_start = target.find('?');
+  std::string_view query = query_start == std::string_view::npos
+                               ? std::string_view()
+                               : target.substr(query_start + 1);
+  std::vector<std::string_view> params = Split(query, '&');
+
+  // Expanded first, so that $select applies to the expanded resource
+  for (std::string_view param : params) {
+    if (!options_.expand || !param.starts_with("$expand=")) {
+      continue;
+    }
+    std::string_view expand = param.substr(std::string_view("$expand=").size());
+    if (expand.empty() || (expand[0] != '.' && expand[0] != '*')) {
+      continue;
+    }
+    int64_t levels = 1;
+    constexpr std::string_view kLevels = "($levels=";
+    if (expand.substr(1).starts_with(kLevels)) {
+      std::string_view count = expand.substr(1 + kLevels.size());
+      std::from_chars(count.data(), count.data() + count.size(), levels);
+    }
+    boost::json::value expanded = std::move(*resource);
+    Expand(expanded, expand[0] == '*',
+           std::clamp<int64_t>(levels, 1, kMaxExpandLevels));
+    resource = std::move(expanded.get_object());
+  }
+
+  for (std::string_view param : params) {
+    if (!options_.select || !param.starts_with("$select=")) {
+      continue;
+    }
+    std::unordered_set<std::string_view> selected;
+    for (std::string_view property :
+         Split(param.substr(std::string_view("$select=").size()), ',')) {
+      selected.insert(property.substr(0, property.find('/')));
+    }
+    boost::json::object kept;
+    for (auto& [key, child] : *resource) {
+      if (key.starts_with("@odata.") || selected.contains(key)) {
+        kept.emplace(key, std::move(child));
+      }
+    }
+    resource = std::move(kept);
+  }
+  return resource;
+}
+
+// One connection to the server, which answers requests in the order they
+// arrive for as long as it's kept alive
+class MockBmcConnection
+    : public std::enable_shared_from_this<MockBmcConnection> {
+ private:
+  MockBmc& bmc_;
+  boost::asio::ip::tcp::socket socket_;
+  std::optional<boost::beast::ssl_stream<boost::asio::ip::tcp::socket&> >
+      sslConn_;
+  boost::asio::steady_timer timer_;
+  boost::beast::flat_buffer buffer_;
+  boost::beast::http::request<boost::beast::http::string_body> req_;
+  boost::beast::http::response<boost::beast::http::string_body> res_;
+  // Requests answered on this connection
+  std::size_t answered_ = 0;
+  // Set once closed, after which bmc_ may be gone, so handlers stop
+  bool closed_ = false;
+
+  void OnHandshake(const std::shared_ptr<MockBmcConnection>& /*self*/,
+                   const boost::system::error_code& ec) {
+    if (closed_) {
+      return;
+    }
+    if (ec) {
+      SPDLOG_DEBUG("Handshake failed: {}", ec.message());
+      Close();
+      return;
+    }
+    Read();
+  }
+
+  void Read() {
+    req_ = {};
+    if (bmc_.options_.idle_timeout.count() > 0) {
+      // Cancelled by the response delay once a request arrives
+      timer_.expires_after(bmc_.options_.idle_timeout);
+      timer_.async_wait(std::bind_front(&MockBmcConnection::OnIdle, this,
+                                        shared_from_this()));
+    }
+    if (sslConn_) {
+      boost::beast::http::async_read(
+          *sslConn_, buffer_, req_,
+          std::bind_front(&MockBmcConnection::OnRead, this,
+                          shared_from_this()));
+    } else {
+      boost::beast::http::async_read(
+          socket_, buffer_, req_,
+          std::bind_front(&MockBmcConnection::OnRead, this,
+                          shared_from_this()));
+    }
+  }
+
+  void OnIdle(const std::shared_ptr<MockBmcConnection>& /*self*/,
+              const boost::system::error_code& ec) {
+    if (closed_ || ec) {
+      return;
+    }
+    SPDLOG_DEBUG("Closing connection after {}ms idle",
+                 bmc_.options_.idle_timeout.count());
+    Close();
+  }
+
+  void OnRead(const std::shared_ptr<MockBmcConnection>& /*self*/,
+              const boost::system::error_code& ec, std::size_t /*size*/) {
+    if (closed_) {
+      return;
+    }
+    if (ec) {
+      // Including the client closing the connection between requests
+      Close();
+      return;
+    }
+    if (bmc_.options_.drop_after_requests != 0 &&
+        answered_ == bmc_.options_.drop_after_requests) {
+      SPDLOG_DEBUG("Dropping connection after {} requests", answered_);
+      Close();
+      return;
+    }
+    answered_++;
+    res_ = bmc_.Handle(req_);
+    res_.keep_alive(req_.keep_alive() && bmc_.options_.keep_alive);
+    res_.prepare_payload();
+
+    timer_.expires_after(bmc_.Delay());
+    timer_.async_wait(std::bind_front(&MockBmcConnection::OnDelay, this,
+                                      shared_from_this()));
+  }
+
+  void OnDelay(const std::shared_ptr<MockBmcConnection>& /*self*/,
+               const boost::system::error_code& ec) {
+    if (closed_ || ec) {
+      return;
+    }
+    if (sslConn_) {
+      boost::beast::http::async_write(
+          *sslConn_, res_,
+          std::bind_front(&MockBmcConnection::OnWrite, this,
+                          shared_from_this()));
+    } else {
+      boost::beast::http::async_write(
+          socket_, res_,
+          std::bind_front(&MockBmcConnection::OnWrite, this,
+                          shared_from_this()));
+    }
+  }
+
+  void OnWrite(const std::shared_ptr<MockBmcConnection>& /*self*/,
+               const boost::system::error_code& ec, std::size_t /*size*/) {
+    if (closed_) {
+      return;
+    }
+    if (ec || !res_.keep_alive()) {
+      Close();
+      return;
+    }
+    Read();
+  }
+
+ public:
+  MockBmcConnection(MockBmc& bmc, boost::asio::ip::tcp::socket&& socket)
+      : bmc_(bmc),
+        socket_(std::move(socket)),
+        timer_(socket_.get_executor()) {
+    if (bmc_.sslCtx_ != nullptr) {
+      sslConn_.emplace(socket_, *bmc_.sslCtx_);
+    }
+  }
+
+  void Start() {
+    if (!sslConn_) {
+      Read();
+      return;
+    }
+    sslConn_->async_handshake(
+        boost::asio::ssl::stream_base::server,
+        std::bind_front(&MockBmcConnection::OnHandshake, this,
+                        shared_from_this()));
+  }
+
+  bool IsOpen() const { return !closed_; }
+
+  void Close() {
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+    timer_.cancel();
+    // Closed outright, the way a BMC dropping a connection would
+    boost::system::error_code ec;
+    socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+    socket_.close(ec);
+  }
+};
+
+MockBmc::MockBmc(boost::asio::io_context& ioc_in,
+                 const MockBmcOptions& options)
+    : options_(options),
+      tree_(options),
+      acceptor_(ioc_in),
+      random_(std::random_device()()) {}
+
+bool MockBmc::Listen(std::string_view address, uint16_t port) {
+  if (options_.use_tls) {
+    sslCtx_ = MakeServerSslContext();
+    if (sslCtx_ == nullptr) {
+      SPDLOG_ERROR("Failed to make a certificate");
+      return false;
+    }
+  }
+  boost::system::error_code ec;
+  boost::asio::ip::address ip =
+      boost::asio::ip::make_address(std::string(address), ec);
+  if (ec) {
+    SPDLOG_ERROR("Invalid address {}: {}", address, ec.message());
+    return false;
+  }
+  boost::asio::ip::tcp::endpoint endpoint(ip, port);
+  acceptor_.open(endpoint.protocol(), ec);
+  if (!ec) {
+    acceptor_.set_option(boost::asio::socket_base::reuse_address(true), ec);
+  }
+  if (!ec) {
+    acceptor_.bind(endpoint, ec);
+  }
+  if (!ec) {
+    acceptor_.listen(boost::asio::socket_base::max_listen_connections, ec);
+  }
+  if (ec) {
+    SPDLOG_ERROR("Failed to listen on {}:{}: {}", address, port,
+                 ec.message());
+    return false;
+  }
+  SPDLOG_INFO("Serving {} chassis of {} sensors on {}:{}", options_.chassis,
+              options_.sensors_per_chassis, address, Port());
+  Accept();
+  return true;
+}
+
+uint16_t MockBmc::Port() const {
+  boost::system::error_code ec;
+  return acceptor_.local_endpoint(ec).port();
+}
+
+void MockBmc::Close() {
+  boost::system::error_code ec;
+  acceptor_.close(ec);
+  for (const std::weak_ptr<MockBmcConnection>& weak_conn : connections_) {
+    std::shared_ptr<MockBmcConnection> conn = weak_conn.lock();
+    if (conn != nullptr) {
+      conn->Close();
+    }
+  }
+  connections_.clear();
+}
+
+void MockBmc::Accept() {
+  acceptor_.async_accept(std::bind_front(&MockBmc::OnAccept, this));
+}
+
+void MockBmc::OnAccept(const boost::system::error_code& ec,
+                       boost::asio::ip::tcp::socket socket) {
+  if (ec) {
+    if (ec == boost::asio::error::operation_aborted) {
+      return;
+    }
+    SPDLOG_ERROR("Failed to accept connection: {}", ec.message());
+  } else if (options_.max_connections != 0 &&
+             OpenConnections() >= options_.max_connections) {
+    SPDLOG_DEBUG("Refusing connection past the limit of {}",
+                 options_.max_connections);
+    stats_.refused_connections++;
+    boost::system::error_code close_ec;
+    socket.close(close_ec);
+  } else {
+    stats_.connections++;
+    auto conn = std::make_shared<MockBmcConnection>(*this, std::move(socket));
+    connections_.push_back(conn);
+    conn->Start();
+  }
+  Accept();
+}
+
+std::size_t MockBmc::OpenConnections() {
+  std::erase_if(connections_,
+                [](const std::weak_ptr<MockBmcConnection>& weak_conn) {
+                  std::shared_ptr<MockBmcConnection> conn = weak_conn.lock();
+                  return conn == nullptr || !conn->IsOpen();
+                });
+  return connections_.size();
+}
+
+boost::beast::http::response<boost::beast::http::string_body> MockBmc::Handle(
+    const boost::beast::http::request<boost::beast::http::string_body>& req) {
+  stats_.requests++;
+  std::string_view target = req.target();
+  SPDLOG_DEBUG("{} {}", std::string_view(req.method_string()), target);
+
+  boost::beast::http::response<boost::beast::http::string_body> res(
+      status::ok, req.version());
+  res.set(field::server, "rtool_mock_bmc");
+  res.set(field::content_type, "application/json");
+  boost::json::object body;
+  std::string_view path = TargetPath(target);
+  if (stats_.requests <= options_.busy_requests) {
+    res.result(options_.busy_status);
+    if (options_.retry_after.count() > 0) {
+      res.set(field::retry_after,
+              std::to_string(options_.retry_after.count()));
+    }
+    body = Error("Base.1.18.ServiceTemporarilyUnavailable",
+                 "The service is temporarily unavailable");
+  } else if (options_.require_session && path != "/redfish/v1" &&
+             !(req.method() == verb::post && path == kSessions) &&
+             !tokens_.contains(std::string(req["X-Auth-Token"]))) {
+    res.result(status::unauthorized);
+    body = Error("Base.1.18.NoValidSession",
+                 "There is no valid session established");
+  } else if (req.method() == verb::get) {
+    std::optional<boost::json::object> resource = tree_.Get(target);
+    if (resource) {
+      body = std::move(*resource);
+    } else {
+      res.result(status::not_found);
+      body = Error("Base.1.18.ResourceNotFound",
+                   std::format("{} was not found", path));
+    }
+  } else if (req.method() == verb::post && path == kSessions) {
+    // Any credentials will do
+    sessions_++;
+    stats_.logins++;
+    std::string id = std::to_string(sessions_);
+    std::string location = std::format("{}/{}", kSessions, id);
+    std::string token = std::format("mock-token-{}", id);
+    res.result(status::created);
+    res.set("X-Auth-Token", token);
+    tokens_.insert(std::move(token));
+    res.set(field::location, location);
+    body = {{"@odata.id", location}, {"Id", id}};
+  } else if (req.method() == verb::delete_ &&
+             path.starts_with(std::string(kSessions) + "/")) {
+    tokens_.erase(std::format("mock-token-{}",
+                              path.substr(kSessions.size() + 1)));
+    res.result(status::no_content);
+    res.erase(field::content_type);
+    return res;
+  } else {
+    res.result(status::method_not_allowed);
+    body = Error("Base.1.18.OperationNotAllowed",
+                 std::format("{} can't be used on {}",
+                             std::string_view(req.method_string()), path));
+  }
+  res.body() = boost::json::serialize(body);
+  return res;
+}
+
+std::chrono::milliseconds MockBmc::Delay() {
+  // Called straight after Handle, so requests counts the one being answered
+  if (options_.slow_every != 0 && stats_.requests % options_.slow_every == 0) {
+    return options_.slow_latency;
+  }
+  std::chrono::milliseconds delay = options_.latency;
+  if (options_.jitter.count() > 0) {
+    std::uniform_int_distribution<int64_t> jitter(0, options_.jitter.count());
+    delay += std::chrono::milliseconds(jitter(random_));
+  }
+  return delay;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/json.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// rtool_mock_bmc stands in for a BMC on localhost, so that the client can be
+// tested and benchmarked end to end without hardware or a network.
+//
+// It serves a synthetic tree of chassis, each with a collection of sensors:
+//   /redfish/v1
+//   /redfish/v1/Chassis
+//   /redfish/v1/Chassis/<n>
+//   /redfish/v1/Chassis/<n>/Sensors
+//   /redfish/v1/Chassis/<n>/Sensors/<m>
+// along with a SessionService that hands a token to any login.  $expand and
+// $select are advertised and honoured unless turned off, and the server can
+// be made slow, stingy with connections, or unwilling to keep them alive,
+// the way real BMCs are.
+
+struct MockBmcOptions {
+  std::size_t chassis = 4;
+  std::size_t sensors_per_chassis = 16;
+  bool expand = true;
+  bool select = true;
+  // Every response is held back for latency, plus up to jitter more
+  std::chrono::milliseconds latency{0};
+  std::chrono::milliseconds jitter{0};
+  // Connections past this many at once are closed as soon as they're
+  // accepted.  0 takes any number.
+  std::size_t max_connections = 0;
+  // Whether connections are kept open between requests, or closed after
+  // every response
+  bool keep_alive = true;
+  // Serve HTTPS, with a self-signed certificate made at startup
+  bool use_tls = false;
+  // Answer 401 to requests for anything past the service root that don't
+  // carry the token of a live session
+  bool require_session = false;
+  // Once this many requests have been answered on a connection, it's
+  // dropped on the next without an answer.  0 answers any number.
+  std::size_t drop_after_requests = 0;
+  // Connections left waiting for a request this long are closed, the way a
+  // BMC's keep-alive timeout closes them.  0 leaves them open.
+  std::chrono::milliseconds idle_timeout{0};
+  // The first this many requests are answered busy_status, the way a BMC
+  // that's overloaded or still starting up answers them, with a Retry-After
+  // of retry_after unless that's 0
+  std::size_t busy_requests = 0;
+  boost::beast::http::status busy_status =
+      boost::beast::http::status::service_unavailable;
+  std::chrono::seconds retry_after{0};
+  // Every slow_every'th request is held back for slow_latency instead, the
+  // way a BMC stalls now and then on one request while others carry on.
+  // 0 never stalls.
+  std::size_t slow_every = 0;
+  std::chrono::milliseconds slow_latency{0};
+};
+
+// Counters describing what the server did over its lifetime
+struct MockBmcStats {
+  uint64_t connections = 0;
+  // Connections closed straight away for being past max_connections
+  uint64_t refused_connections = 0;
+  uint64_t requests = 0;
+  // Sessions created
+  uint64_t logins = 0;
+};
+
+// The synthetic tree, apart from how it's served
+class MockRedfishTree {
+ private:
+  MockBmcOptions options_;
+
+  // The resource at path, with every link left as a link
+  std::optional<boost::json::object> Resource(std::string_view path) const;
+
+  // Replaces links under value with the resources they point to, levels
+  // deep.  Links under a Links property are only followed if links is set.
+  void Expand(boost::json::value& value, bool links, int64_t levels) const;
+
+ public:
+  explicit MockRedfishTree(const MockBmcOptions& options)
+      : options_(options) {}
+
+  // The resource target names, with any $expand and $select it asks for
+  // applied, or nullopt if there's no such resource
+  std::optional<boost::json::object> Get(std::string_view target) const;
+};
+
+class MockBmcConnection;
+
+class MockBmc {
+ private:
+  MockBmcOptions options_;
+  MockRedfishTree tree_;
+  std::shared_ptr<boost::asio::ssl::context> sslCtx_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+  std::vector<std::weak_ptr<MockBmcConnection> > connections_;
+  std::mt19937 random_;
+  MockBmcStats stats_;
+  // Sessions handed out, which numbers the next one
+  uint64_t sessions_ = 0;
+  // Tokens of the sessions that haven't been deleted
+  std::unordered_set<std::string> tokens_;
+
+  friend class MockBmcConnection;
+
+  void Accept();
+
+  void OnAccept(const boost::system::error_code& ec,
+                boost::asio::ip::tcp::socket socket);
+
+  // Connections that are still open
+  std::size_t OpenConnections();
+
+  boost::beast::http::response<boost::beast::http::string_body> Handle(
+      const boost::beast::http::request<boost::beast::http::string_body>& req);
+
+  // How long to hold back the next response
+  std::chrono::milliseconds Delay();
+
+ public:
+  MockBmc(boost::asio::io_context& ioc_in, const MockBmcOptions& options);
+
+  MockBmc(const MockBmc&) = delete;
+  MockBmc& operator=(const MockBmc&) = delete;
+  MockBmc(MockBmc&&) = delete;
+  MockBmc& operator=(MockBmc&&) = delete;
+  ~MockBmc() { Close(); }
+
+  // Starts accepting connections on address:port.  Port 0 picks a free one,
+  // which Port returns.  Returns false if the address can't be bound, or
+  // TLS was asked for and a certificate couldn't be made.
+  bool Listen(std::string_view address, uint16_t port);
+
+  uint16_t Port() const;
+
+  // Stops accepting connections, and closes those that are open
+  void Close();
+
+  const MockBmcStats& Stats() const { return stats_; }
+};
@@ -0,0 +1,529 @@
+#include "mock_bmc.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "http_client.hpp"
+#include "redfish_client.hpp"
+#include "sink_body.hpp"
+
+namespace {
+
+TEST(MockRedfishTree, ServesChassisAndSensors) {
+  MockRedfishTree tree({.chassis = 3, .sensors_per_chassis = 5});
+  std::optional<boost::json::object> chassis =
+      tree.Get("/redfish/v1/Chassis");
+  ASSERT_TRUE(chassis);
+  EXPECT_EQ(chassis->at("Members").as_array().size(), 3U);
+
+  std::optional<boost::json::object> sensor =
+      tree.Get("/redfish/v1/Chassis/2/Sensors/5/");
+  ASSERT_TRUE(sensor);
+  EXPECT_TRUE(sensor->contains("Reading"));
+  EXPECT_EQ(sensor->at("@odata.id").as_string(),
+            "/redfish/v1/Chassis/2/Sensors/5");
+
+  EXPECT_FALSE(tree.Get("/redfish/v1/Chassis/0"));
+  EXPECT_FALSE(tree.Get("/redfish/v1/Chassis/4"));
+  EXPECT_FALSE(tree.Get("/redfish/v1/Chassis/2/Sensors/6"));
+  EXPECT_FALSE(tree.Get("/redfish/v1/Managers"));
+}
+
+TEST(MockRedfishTree, ExpandsLinksToLevels) {
+  MockRedfishTree tree({.chassis = 2, .sensors_per_chassis = 2});
+  std::optional<boost::json::object> one =
+      tree.Get("/redfish/v1/Chassis?$expand=.($levels=1)");
+  ASSERT_TRUE(one);
+  const boost::json::object& member =
+      one->at("Members").as_array()[1].as_object();
+  EXPECT_EQ(member.at("Name").as_string(), "Chassis 2");
+  // Links past the first level, and under Links, are left alone
+  EXPECT_EQ(member.at("Sensors").as_object().size(), 1U);
+  EXPECT_EQ(
+      member.at("Links").as_object().at("ContainedBy").as_object().size(), 1U);
+
+  std::optional<boost::json::object> two =
+      tree.Get("/redfish/v1/Chassis?$expand=*($levels=2)");
+  ASSERT_TRUE(two);
+  const boost::json::object& expanded =
+      two->at("Members").as_array()[1].as_object();
+  EXPECT_TRUE(expanded.at("Sensors").as_object().contains("Members"));
+  EXPECT_TRUE(expanded.at("Links")
+                  .as_object()
+                  .at("ContainedBy")
+                  .as_object()
+                  .contains("Name"));
+}
+
+TEST(MockRedfishTree, IgnoresQueriesItDoesntSupport) {
+  MockRedfishTree tree(
+      {.chassis = 1, .sensors_per_chassis = 1, .expand = false,
+       .select = false});
+  std::optional<boost::json::object> chassis =
+      tree.Get("/redfish/v1/Chassis?$expand=.");
+  ASSERT_TRUE(chassis);
+  EXPECT_EQ(chassis->at("Members").as_array()[0].as_object().size(), 1U);
+  std::optional<boost::json::object> sensor =
+      tree.Get("/redfish/v1/Chassis/1/Sensors/1?$select=Reading");
+  ASSERT_TRUE(sensor);
+  EXPECT_TRUE(sensor->contains("Name"));
+}
+
+TEST(MockRedfishTree, SelectsProperties) {
+  MockRedfishTree tree({.chassis = 1, .sensors_per_chassis = 1});
+  std::optional<boost::json::object> sensor = tree.Get(
+      "/redfish/v1/Chassis/1/Sensors/1?$select=Reading,Status/Health");
+  ASSERT_TRUE(sensor);
+  std::vector<std::string> keys;
+  for (const auto& [key, value] : *sensor) {
+    keys.emplace_back(key);
+  }
+  EXPECT_THAT(keys, testing::UnorderedElementsAre("@odata.id", "@odata.type",
+                                                  "Reading", "Status"));
+}
+
+struct EndToEnd {
+  std::vector<redfish::QueryValue> values;
+  QueryStatus status;
+  MockBmcStats served;
+  // What the client counted for the BMC
+  http::HostStats sent;
+};
+
+// Reads every sensor from a mock BMC made with options, through the client
+// made with client_options
+EndToEnd ReadSensors(const MockBmcOptions& options,
+                     const redfish::ClientOptions& client_options,
+                     const std::vector<std::string>& redpaths = {
+                         "Chassis[*]/Sensors[*]/Reading"}) {
+  boost::asio::io_context ioc;
+  MockBmc bmc(ioc, options);
+  EndToEnd out;
+  if (!bmc.Listen("127.0.0.1", 0)) {
+    ADD_FAILURE() << "Failed to listen";
+    return out;
+  }
+  bool done = false;
+  {
+    redfish::Client client(ioc, client_options);
+    HostConnectData host{.host = "127.0.0.1", .port = bmc.Port()};
+    client.Query(
+        host, redpaths,
+        [&out](std::string_view redpath, std::string_view value) {
+          out.values.push_back(
+              {.redpath = std::string(redpath), .value = std::string(value)});
+        },
+        [&](const QueryStatus& status) {
+          out.status = status;
+          done = true;
+          ioc.stop();
+        });
+    ioc.run_for(std::chrono::seconds(30));
+    std::map<std::string, http::HostStats> hosts = client.StatsByHost();
+    EXPECT_EQ(hosts.size(), 1U);
+    if (!hosts.empty()) {
+      out.sent = hosts.begin()->second;
+    }
+  }
+  EXPECT_TRUE(done);
+  out.served = bmc.Stats();
+  return out;
+}
+
+// The uris of the first count sensors in the first chassis
+std::vector<std::string> SensorUris(std::size_t count) {
+  std::vector<std::string> uris;
+  for (std::size_t sensor = 1; sensor <= count; sensor++) {
+    uris.push_back(std::format("/redfish/v1/Chassis/1/Sensors/{}", sensor));
+  }
+  return uris;
+}
+
+// The @odata.id of the resource res carries, or its status if it failed
+std::string Answer(http::Response& res) {
+  if (res.Result() != boost::beast::http::status::ok) {
+    return std::format("status {}", static_cast<unsigned>(res.Result()));
+  }
+  boost::system::error_code ec;
+  boost::json::value body = boost::json::parse(res.Body(), ec);
+  if (ec || !body.is_object()) {
+    return "unparseable";
+  }
+  const boost::json::value* id = body.as_object().if_contains("@odata.id");
+  if (id == nullptr || !id->is_string()) {
+    return "no @odata.id";
+  }
+  return std::string(id->as_string());
+}
+
+// GETs every uri from bmc at once, and returns what each was answered with,
+// in the same order
+std::vector<std::string> GetAll(boost::asio::io_context& ioc,
+                                http::Client& client, const MockBmc& bmc,
+                                const std::vector<std::string>& uris) {
+  std::vector<std::string> answers(uris.size());
+  std::size_t answered = 0;
+  for (std::size_t index = 0; index < uris.size(); index++) {
+    client.SendData("", "127.0.0.1", bmc.Port(), uris[index], {},
+                    boost::beast::http::verb::get,
+                    [&, index](http::Response&& res) {
+                      EXPECT_TRUE(answers[index].empty())
+                          << uris[index] << " answered twice";
+                      answers[index] = Answer(res);
+                      if (++answered == uris.size()) {
+                        ioc.stop();
+                      }
+                    });
+  }
+  ioc.run_for(std::chrono::seconds(30));
+  ioc.restart();
+  return answers;
+}
+
+TEST(MockBmc, AnswersEveryRequest) {
+  EndToEnd run = ReadSensors(
+      {.chassis = 3, .sensors_per_chassis = 5},
+      {.connect = {.use_tls = false}, .query = {.expand_levels = 0}});
+  EXPECT_EQ(run.values.size(), 15U);
+  EXPECT_EQ(run.status.failed_requests, 0U);
+  // The root, the chassis collection, each chassis, each sensor collection
+  // and each sensor
+  EXPECT_EQ(run.status.requests, 1U + 1U + 3U + 3U + 15U);
+  EXPECT_EQ(run.served.requests, run.status.requests);
+
+  EXPECT_EQ(run.sent.requests, run.served.requests);
+  EXPECT_GT(run.sent.reused_connections, 0U);
+  EXPECT_GT(run.sent.bytes_received, run.sent.bytes_sent);
+  EXPECT_EQ(run.sent.dropped_requests, 0U);
+  // Everything queued was taken by a connection
+  EXPECT_EQ(run.sent.queued_requests, 0U);
+  EXPECT_GT(run.sent.peak_queued_requests, 0U);
+}
+
+TEST(MockBmc, SelectsSiblingPropertiesTogether) {
+  EndToEnd run = ReadSensors(
+      {.chassis = 3, .sensors_per_chassis = 5},
+      {.connect = {.use_tls = false}, .query = {.expand_levels = 0}},
+      {"Chassis[*]/Sensors[*]/Reading",
+       "Chassis[*]/Sensors[*]/ReadingUnits"});
+  EXPECT_EQ(run.values.size(), 30U);
+  EXPECT_EQ(run.status.failed_requests, 0U);
+  // One request for each resource, however many redpaths need it
+  EXPECT_EQ(run.status.requests, 1U + 1U + 3U + 3U + 15U);
+  EXPECT_EQ(run.served.requests, run.status.requests);
+}
+
+TEST(MockBmc, ExpandsCollections) {
+  EndToEnd run = ReadSensors({.chassis = 3, .sensors_per_chassis = 5},
+                             {.connect = {.use_tls = false}});
+  EXPECT_EQ(run.values.size(), 15U);
+  EXPECT_EQ(run.status.failed_requests, 0U);
+  // The root, the expanded chassis collection, and each expanded sensor
+  // collection
+  EXPECT_EQ(run.status.requests, 1U + 1U + 3U);
+}
+
+TEST(MockBmc, ClosesConnectionsAfterEveryResponse) {
+  EndToEnd run = ReadSensors(
+      {.chassis = 2, .sensors_per_chassis = 2, .keep_alive = false},
+      {.connect = {.use_tls = false}});
+  EXPECT_EQ(run.values.size(), 4U);
+  EXPECT_EQ(run.status.failed_requests, 0U);
+  EXPECT_GE(run.served.connections, run.served.requests);
+  EXPECT_GT(run.sent.reconnects, 0U);
+  EXPECT_GE(run.sent.opened_connections, run.served.requests);
+}
+
+TEST(MockBmc, ServesTls) {
+  EndToEnd run = ReadSensors(
+      {.chassis = 2, .sensors_per_chassis = 2, .use_tls = true},
+      {.connect = {.verify_server_certificate = false, .use_tls = true}});
+  EXPECT_EQ(run.values.size(), 4U);
+  EXPECT_EQ(run.status.failed_requests, 0U);
+}
+
+TEST(MockBmc, CarriesOnWhenConnectionsAreRefused) {
+  // The connections past the host's two fail their handshakes, and leave
+  // the queued requests to the two that don't
+  EndToEnd run = ReadSensors(
+      {.chassis = 3,
+       .sensors_per_chassis = 5,
+       .max_connections = 2,
+       .use_tls = true},
+      {.connect = {.verify_server_certificate = false,
+                   .use_tls = true,
+                   .max_connections_per_host = 4,
+                   .adaptive_connections = false},
+       .query = {.expand_levels = 0}});
+  EXPECT_EQ(run.values.size(), 15U);
+  EXPECT_EQ(run.status.failed_requests, 0U);
+  EXPECT_GT(run.served.refused_connections, 0U);
+  EXPECT_EQ(run.sent.dropped_requests, 0U);
+}
+
+TEST(MockBmc, TimesEachPhaseOfARequest) {
+  boost::asio::io_context ioc;
+  MockBmc bmc(ioc, {.latency = std::chrono::milliseconds(20)});
+  ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+  http::Client client(ioc, {.use_tls = false});
+  std::optional<http::RequestTimings> timings;
+  client.SendData("", "127.0.0.1", bmc.Port(), "/redfish/v1", {},
+                  boost::beast::http::verb::get,
+                  [&](http::Response&& res) {
+                    EXPECT_EQ(res.Result(), boost::beast::http::status::ok);
+                    timings = res.timings;
+                    ioc.stop();
+                  });
+  ioc.run_for(std::chrono::seconds(30));
+  ASSERT_TRUE(timings);
+  // The first request waits on its connection being opened
+  EXPECT_TRUE(timings->connected);
+  EXPECT_GE(timings->wait, std::chrono::milliseconds(20));
+  EXPECT_GE(timings->Total(), timings->wait);
+
+  std::map<std::string, http::HostTimings> hosts = client.Timings();
+  ASSERT_EQ(hosts.size(), 1U);
+  const http::HostTimings& host = hosts.begin()->second;
+  EXPECT_EQ(hosts.begin()->first, std::format("127.0.0.1:{}", bmc.Port()));
+  EXPECT_EQ(host.wait.Count(), 1U);
+  EXPECT_EQ(host.connect.Count(), 1U);
+  EXPECT_EQ(host.tls_handshake.Count(), 0U);
+}
+
+TEST(MockBmc, PipelinesRequestsOnABusyConnection) {
+  boost::asio::io_context ioc;
+  MockBmc bmc(ioc, {.chassis = 1,
+                    .sensors_per_chassis = 16,
+                    .latency = std::chrono::milliseconds(5)});
+  ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+  // One connection, so every request but the first finds it busy
+  http::Client client(ioc, {.use_tls = false,
+                            .max_connections_per_host = 1,
+                            .adaptive_connections = false,
+                            .pipeline_depth = 4});
+  std::vector<std::string> uris = SensorUris(16);
+  EXPECT_EQ(GetAll(ioc, client, bmc, uris), uris);
+  EXPECT_GT(client.Stats().pipelined_requests, 0U);
+  EXPECT_EQ(client.Stats().pipeline_fallbacks, 0U);
+  EXPECT_EQ(bmc.Stats().connections, 1U);
+  EXPECT_EQ(bmc.Stats().requests, uris.size());
+}
+
+TEST(MockBmc, StopsPipeliningWhenAConnectionDropsMidPipeline) {
+  boost::asio::io_context ioc;
+  // Each connection is dropped with the requests behind its third still
+  // unanswered
+  MockBmc bmc(ioc, {.chassis = 1,
+                    .sensors_per_chassis = 16,
+                    .latency = std::chrono::milliseconds(5),
+                    .drop_after_requests = 3});
+  ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+  http::Client client(ioc, {.use_tls = false,
+                            .max_connections_per_host = 1,
+                            .adaptive_connections = false,
+                            .max_retries = 16,
+                            .retry_delay = std::chrono::milliseconds(1),
+                            .breaker_threshold = 0,
+                            .pipeline_depth = 4});
+  std::vector<std::string> uris = SensorUris(16);
+  // The pipelined requests are sent again, and each still gets its own
+  // answer
+  EXPECT_EQ(GetAll(ioc, client, bmc, uris), uris);
+  uint64_t pipelined = client.Stats().pipelined_requests;
+  EXPECT_GT(pipelined, 0U);
+  EXPECT_EQ(client.Stats().pipeline_fallbacks, 1U);
+
+  // The host stays marked, so nothing more is pipelined to it
+  EXPECT_EQ(GetAll(ioc, client, bmc, uris), uris);
+  EXPECT_EQ(client.Stats().pipelined_requests, pipelined);
+  EXPECT_EQ(client.Stats().pipeline_fallbacks, 1U);
+}
+
+TEST(MockBmc, PrewarmsConnectionsUpToTheLimit) {
+  boost::asio::io_context ioc;
+  // Slow enough that every connection is in before the answer
+  MockBmc bmc(ioc, {.latency = std::chrono::milliseconds(50)});
+  ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+  http::Client client(ioc, {.use_tls = false,
+                            .max_connections_per_host = 4,
+                            .adaptive_connections = false});
+  std::vector<std::string> uris = SensorUris(1);
+  EXPECT_EQ(GetAll(ioc, client, bmc, uris), uris);
+  EXPECT_EQ(client.Stats().prewarmed_connections, 4U);
+  EXPECT_EQ(bmc.Stats().connections, 4U);
+  EXPECT_EQ(bmc.Stats().requests, 1U);
+}
+
+TEST(MockBmc, ClosesConnectionsLeftIdle) {
+  boost::asio::io_context ioc;
+  MockBmc bmc(ioc, {});
+  ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+  http::Client client(ioc, {.use_tls = false,
+                            .max_connections_per_host = 1,
+                            .adaptive_connections = false,
+                            .max_idle_time = std::chrono::seconds(1)});
+  std::vector<std::string> uris = SensorUris(1);
+  EXPECT_EQ(GetAll(ioc, client, bmc, uris), uris);
+  EXPECT_EQ(client.Stats().recycled_connections, 0U);
+
+  ioc.run_for(std::chrono::milliseconds(1500));
+  ioc.restart();
+  EXPECT_EQ(client.Stats().recycled_connections, 1U);
+
+  // The next request opens a new connection rather than failing on the old
+  EXPECT_EQ(GetAll(ioc, client, bmc, uris), uris);
+  EXPECT_EQ(client.Stats().retried_requests, 0U);
+  EXPECT_EQ(bmc.Stats().connections, 2U);
+}
+
+TEST(MockBmc, NoticesConnectionsTheHostClosed) {
+  boost::asio::io_context ioc;
+  MockBmc bmc(ioc, {.idle_timeout = std::chrono::milliseconds(100)});
+  ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+  http::Client client(ioc, {.use_tls = false,
+                            .max_connections_per_host = 1,
+                            .adaptive_connections = false});
+  std::vector<std::string> uris = SensorUris(1);
+  EXPECT_EQ(GetAll(ioc, client, bmc, uris), uris);
+
+  ioc.run_for(std::chrono::milliseconds(300));
+  ioc.restart();
+
+  // Found closed before the request was written to it, so the request
+  // neither fails nor needs retrying
+  EXPECT_EQ(GetAll(ioc, client, bmc, uris), uris);
+  EXPECT_EQ(client.Stats().recycled_connections, 1U);
+  EXPECT_EQ(client.Stats().retried_requests, 0U);
+  EXPECT_EQ(bmc.Stats().connections, 2U);
+  EXPECT_EQ(bmc.Stats().requests, 2U);
+}
+
+TEST(MockBmc, RetriesRequestsTheHostIsTooBusyFor) {
+  for (boost::beast::http::status busy :
+       {boost::beast::http::status::service_unavailable,
+        boost::beast::http::status::too_many_requests}) {
+    SCOPED_TRACE(static_cast<unsigned>(busy));
+    boost::asio::io_context ioc;
+    MockBmc bmc(ioc, {.busy_requests = 2, .busy_status = busy});
+    ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+    http::Client client(ioc, {.use_tls = false,
+                              .retry_delay = std::chrono::milliseconds(1)});
+    std::vector<std::string> uris = SensorUris(1);
+    EXPECT_EQ(GetAll(ioc, client, bmc, uris), uris);
+    EXPECT_EQ(client.Stats().retried_requests, 2U);
+    EXPECT_EQ(bmc.Stats().requests, 3U);
+  }
+}
+
+TEST(MockBmc, RetriesRequestsLeftUnanswered) {
+  boost::asio::io_context ioc;
+  // The second request on the connection is dropped, and answered on the
+  // next
+  MockBmc bmc(ioc, {.drop_after_requests = 1});
+  ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+  http::Client client(ioc, {.use_tls = false,
+                            .max_connections_per_host = 1,
+                            .adaptive_connections = false,
+                            .retry_delay = std::chrono::milliseconds(1)});
+  std::vector<std::string> first = SensorUris(1);
+  EXPECT_EQ(GetAll(ioc, client, bmc, first), first);
+  std::vector<std::string> second = {"/redfish/v1/Chassis/1/Sensors/2"};
+  EXPECT_EQ(GetAll(ioc, client, bmc, second), second);
+  EXPECT_EQ(client.Stats().retried_requests, 1U);
+  EXPECT_EQ(bmc.Stats().connections, 2U);
+  EXPECT_EQ(bmc.Stats().requests, 2U);
+}
+
+TEST(MockBmc, KeepsRetriedResponsesFromTheSink) {
+  boost::asio::io_context ioc;
+  MockBmc bmc(ioc, {.busy_requests = 1});
+  ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+  http::Client client(ioc, {.use_tls = false,
+                            .retry_delay = std::chrono::milliseconds(1)});
+  std::string uri = "/redfish/v1/Chassis/1/Sensors/1";
+  std::vector<unsigned> streamed_statuses;
+  std::string streamed;
+  std::optional<boost::beast::http::status> result;
+  client.SendData(
+      "", "127.0.0.1", bmc.Port(), uri, {}, boost::beast::http::verb::get,
+      [&](http::Response&& res) {
+        result = res.Result();
+        ioc.stop();
+      },
+      [&](const http::ResponseHeader& header, std::string_view chunk,
+          boost::system::error_code& /*ec*/) {
+        streamed_statuses.push_back(static_cast<unsigned>(header.result()));
+        streamed += chunk;
+      });
+  ioc.run_for(std::chrono::seconds(30));
+  EXPECT_EQ(result, boost::beast::http::status::ok);
+  EXPECT_EQ(client.Stats().retried_requests, 1U);
+  // Only the answer that was kept reached the sink
+  EXPECT_THAT(streamed_statuses, testing::Each(200U));
+  boost::json::value body = boost::json::parse(streamed);
+  EXPECT_EQ(body.at("@odata.id").as_string(), uri);
+}
+
+TEST(MockBmc, WaitsAsLongAsRetryAfterAsks) {
+  boost::asio::io_context ioc;
+  MockBmc bmc(ioc, {.busy_requests = 1,
+                    .retry_after = std::chrono::seconds(1)});
+  ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+  // Left to itself, the client would retry straight away
+  http::Client client(ioc, {.use_tls = false,
+                            .retry_delay = std::chrono::milliseconds(1)});
+  std::vector<std::string> uris = SensorUris(1);
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  EXPECT_EQ(GetAll(ioc, client, bmc, uris), uris);
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::seconds(1));
+  EXPECT_EQ(client.Stats().retried_requests, 1U);
+}
+
+TEST(MockBmc, HedgesRequestsThatStall) {
+  boost::asio::io_context ioc;
+  // Only the request after the ones that fill the latency history stalls
+  constexpr std::size_t kHistory = http::LatencyWindow::kMinSamples;
+  MockBmc bmc(ioc, {.chassis = 1,
+                    .sensors_per_chassis = kHistory + 1,
+                    .slow_every = kHistory + 1,
+                    .slow_latency = std::chrono::seconds(5)});
+  ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+  http::Client client(ioc, {.use_tls = false,
+                            .max_connections_per_host = 2,
+                            .adaptive_connections = false,
+                            .hedge_percentile = 90});
+  std::vector<std::string> uris = SensorUris(kHistory + 1);
+  std::vector<std::string> history(uris.begin(), uris.end() - 1);
+  EXPECT_EQ(GetAll(ioc, client, bmc, history), history);
+  EXPECT_EQ(client.Stats().hedged_requests, 0U);
+
+  // Answered by the hedge, on the other connection, long before the stalled
+  // attempt would have been
+  std::vector<std::string> stalled = {uris.back()};
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  EXPECT_EQ(GetAll(ioc, client, bmc, stalled), stalled);
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::seconds(5));
+  EXPECT_EQ(client.Stats().hedged_requests, 1U);
+  EXPECT_EQ(client.Stats().hedges_won, 1U);
+  EXPECT_EQ(bmc.Stats().requests, kHistory + 2);
+
+  // The stalled attempt's connection was closed to cancel it
+  ioc.run_for(std::chrono::milliseconds(100));
+  std::map<std::string, http::HostStats> hosts = client.StatsByHost();
+  ASSERT_EQ(hosts.size(), 1U);
+  EXPECT_EQ(hosts.begin()->second.live_connections, 1U);
+}
+
+}  // namespace
@@ -16,7 +16,7 @@ void path::append_path(std::string& path_str, const path_component& path) {
   std::visit(VisitPath(path_str), path);
 }
 
-std::string path::to_path_string() {
+std::string path::to_path_string() const {
   std::string ret;
   append_path(ret, first);
   for (const path_component& p : filters) {
@@ -45,4 +45,15 @@ std::optional<path> path::strip_parent() const {
       .filters = {filters.begin() + 1, filters.end()},
   };
 }
+
+std::optional<path> path::suffix_after(std::size_t index) const {
+  if (index + 1 >= component_count()) {
+    return std::nullopt;
+  }
+  return path{
+      .first = component(index + 1),
+      .filters = {filters.begin() + static_cast<std::ptrdiff_t>(index + 1),
+                  filters.end()},
+  };
+}
 }  // namespace redfish::filter_ast
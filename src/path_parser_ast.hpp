@@ -35,11 +35,20 @@ struct path {
   std::vector<path_component> filters;
   auto operator<=>(const path&) const = default;
 
-  void append_path(std::string& path_str, const path_component& path);
+  static void append_path(std::string& path_str, const path_component& path);
 
-  std::string to_path_string();
+  std::string to_path_string() const;
 
   std::optional<path> strip_parent() const;
+
+  // Components in order, counting first as component 0
+  std::size_t component_count() const { return filters.size() + 1; }
+  const path_component& component(std::size_t index) const {
+    return index == 0 ? first : filters[index - 1];
+  }
+
+  // The path made of every component after index, if there are any
+  std::optional<path> suffix_after(std::size_t index) const;
 };
 
 }  // namespace filter_ast
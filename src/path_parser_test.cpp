@@ -48,3 +48,13 @@ TEST(FilterParser, ParentPath) {
               Optional(FieldsAre(VariantWith<key_name>(key_name("Sensors")),
                                  IsEmpty())));
 }
+
+TEST(FilterParser, SuffixAfter) {
+  std::optional<redfish::filter_ast::path> p =
+      parseRedfishPath("Chassis[*]/Sensors[*]/Reading");
+  ASSERT_TRUE(p);
+  EXPECT_EQ(p->component_count(), 3);
+  EXPECT_EQ(p->suffix_after(0)->to_path_string(), "Sensors[*]/Reading");
+  EXPECT_EQ(p->suffix_after(1)->to_path_string(), "Reading");
+  EXPECT_EQ(p->suffix_after(2), std::nullopt);
+}
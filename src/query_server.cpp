@@ -0,0 +1,487 @@
+#include "query_server.hpp"
+
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/json.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <format>
+#include <functional>
+#include <memory>
+#include <system_error>
+
+namespace {
+
+// A query is a handful of redpaths; anything bigger isn't one
+constexpr std::size_t kMaxQuerySize = 64 * 1024;
+
+using boost::asio::local::stream_protocol;
+
+std::string_view GetString(const boost::json::object& obj,
+                           std::string_view key) {
+  const boost::json::value* value = obj.if_contains(key);
+  if (value == nullptr || !value->is_string()) {
+    return "";
+  }
+  return value->get_string();
+}
+
+bool GetBool(const boost::json::object& obj, std::string_view key,
+             bool default_value) {
+  const boost::json::value* value = obj.if_contains(key);
+  if (value == nullptr || !value->is_bool()) {
+    return default_value;
+  }
+  return value->get_bool();
+}
+
+int64_t GetInt(const boost::json::object& obj, std::string_view key,
+               int64_t default_value) {
+  const boost::json::value* value = obj.if_contains(key);
+  if (value == nullptr || !value->is_int64()) {
+    return default_value;
+  }
+  return value->get_int64();
+}
+
+boost::json::object HostStatsToJson(const http::HostStats& stats) {
+  return {
+      {"requests", stats.requests},
+      {"bytes_sent", stats.bytes_sent},
+      {"bytes_received", stats.bytes_received},
+      {"opened_connections", stats.opened_connections},
+      {"live_connections", stats.live_connections},
+      {"reused_connections", stats.reused_connections},
+      {"reconnects", stats.reconnects},
+      {"timeouts", stats.timeouts},
+      {"dropped_requests", stats.dropped_requests},
+      {"queued_requests", stats.queued_requests},
+      {"peak_queued_requests", stats.peak_queued_requests},
+  };
+}
+
+// A line asking for the server's counters rather than running a query
+bool IsStatsRequest(std::string_view line) {
+  boost::system::error_code ec;
+  boost::json::value root = boost::json::parse(line, ec);
+  return !ec && root.is_object() &&
+         GetBool(root.get_object(), "stats", false);
+}
+
+// Connects conn to the server listening on socket, if there is one and it's
+// run by owner.  Anyone can bind the socket's path first when it's in a
+// shared directory like /tmp, and queries carry credentials, so a server run
+// by anyone else is never written to.
+bool ConnectToServer(stream_protocol::socket& conn,
+                     const std::filesystem::path& socket, uid_t owner) {
+  boost::system::error_code ec;
+  conn.connect(stream_protocol::endpoint(socket.string()), ec);
+  if (ec) {
+    SPDLOG_DEBUG("No server listening on {}: {}", socket.string(),
+                 ec.message());
+    return false;
+  }
+  ucred peer{};
+  socklen_t size = sizeof(peer);
+  if (::getsockopt(conn.native_handle(), SOL_SOCKET, SO_PEERCRED, &peer,
+                   &size) != 0) {
+    SPDLOG_ERROR("Failed to check who's serving {}", socket.string());
+    return false;
+  }
+  if (peer.uid != owner) {
+    SPDLOG_ERROR("Not using server on {}, it's run by uid {} rather than {}",
+                 socket.string(), peer.uid, owner);
+    return false;
+  }
+  return true;
+}
+
+std::string Frame(const boost::json::object& obj) {
+  std::string line = boost::json::serialize(obj);
+  line += '\n';
+  return line;
+}
+
+// One client's connection to the server, which carries a single query
+class QuerySession : public std::enable_shared_from_this<QuerySession> {
+ private:
+  redfish::Client& client_;
+  // Owned by the server, and shared by every session
+  std::unordered_map<std::string, http::Credentials>& logins_;
+  stream_protocol::socket socket_;
+  std::string request_;
+  std::deque<std::string> outgoing_;
+  bool writing_ = false;
+  // The last line has been queued, and the socket is closed once it's sent
+  bool done_ = false;
+
+  void OnRead(const boost::system::error_code& ec, std::size_t size) {
+    if (ec) {
+      SPDLOG_DEBUG("Failed to read query: {}", ec.message());
+      return;
+    }
+    std::string_view line = std::string_view(request_).substr(0, size - 1);
+    std::optional<ForwardedQuery> query = ParseQuery(line);
+    if (!query) {
+      if (IsStatsRequest(line)) {
+        done_ = true;
+        Send(Frame(StatsToJson(client_.Stats(), client_.StatsByHost())));
+        return;
+      }
+      Finish("Malformed query");
+      return;
+    }
+    // The connections are shared by every query, so they're made the way
+    // the server was told to make them
+    const http::ConnectPolicy& policy = client_.Policy();
+    if (query->policy.use_tls != policy.use_tls ||
+        query->policy.verify_server_certificate !=
+            policy.verify_server_certificate) {
+      Finish("Server was started with different TLS options");
+      return;
+    }
+    // Every query to a host shares its session, and its cached responses,
+    // so one made as another user would see what the first user can
+    http::Credentials credentials{.username = query->host.username,
+                                  .password = query->host.password};
+    auto [login, inserted] = logins_.try_emplace(
+        std::format("{}:{}", query->host.host, query->host.port),
+        credentials);
+    if (!inserted && login->second != credentials) {
+      Finish("Server is serving host with other credentials");
+      return;
+    }
+    bool started = client_.Query(
+        query->host, query->redpaths, query->options,
+        [self = shared_from_this()](std::string_view redpath,
+                                    std::string_view value) {
+          self->Send(Frame({{"redpath", redpath}, {"value", value}}));
+        },
+        [self = shared_from_this()](const QueryStatus& status) {
+          self->done_ = true;
+          self->Send(Frame({{"requests", status.requests},
+                            {"failed_requests", status.failed_requests}}));
+        });
+    if (!started) {
+      Finish("Invalid redpath");
+    }
+  }
+
+  void Finish(std::string_view error) {
+    done_ = true;
+    Send(Frame({{"error", error}}));
+  }
+
+  void Send(std::string&& line) {
+    outgoing_.emplace_back(std::move(line));
+    if (!writing_) {
+      WriteNext();
+    }
+  }
+
+  void WriteNext() {
+    if (outgoing_.empty()) {
+      writing_ = false;
+      if (done_) {
+        boost::system::error_code ec;
+        socket_.shutdown(stream_protocol::socket::shutdown_both, ec);
+        socket_.close(ec);
+      }
+      return;
+    }
+    writing_ = true;
+    boost::asio::async_write(
+        socket_, boost::asio::buffer(outgoing_.front()),
+        std::bind_front(&QuerySession::OnWrite, shared_from_this()));
+  }
+
+  void OnWrite(const boost::system::error_code& ec, std::size_t /*size*/) {
+    if (ec) {
+      // The client went away.  The query still runs to completion, which
+      // keeps the connections it opened warm for the next one.
+      SPDLOG_DEBUG("Failed to send result: {}", ec.message());
+      outgoing_.clear();
+      writing_ = true;
+      return;
+    }
+    outgoing_.pop_front();
+    WriteNext();
+  }
+
+ public:
+  QuerySession(redfish::Client& client,
+               std::unordered_map<std::string, http::Credentials>& logins,
+               stream_protocol::socket&& socket)
+      : client_(client), logins_(logins), socket_(std::move(socket)) {}
+
+  void Start() {
+    boost::asio::async_read_until(
+        socket_, boost::asio::dynamic_buffer(request_, kMaxQuerySize), '\n',
+        std::bind_front(&QuerySession::OnRead, shared_from_this()));
+  }
+};
+
+}  // namespace
+
+std::string SerializeQuery(const ForwardedQuery& query) {
+  boost::json::object obj{
+      {"host", query.host.host},
+      {"port", query.host.port},
+      {"username", query.host.username},
+      {"password", query.host.password},
+      {"use_tls", query.policy.use_tls},
+      {"verify_server", query.policy.verify_server_certificate},
+      {"expand_levels", query.options.expand_levels},
+      {"select", query.options.select},
+      {"redpaths",
+       boost::json::array(query.redpaths.begin(), query.redpaths.end())},
+  };
+  return boost::json::serialize(obj);
+}
+
+std::optional<ForwardedQuery> ParseQuery(std::string_view line) {
+  boost::system::error_code ec;
+  boost::json::value root = boost::json::parse(line, ec);
+  if (ec || !root.is_object()) {
+    return std::nullopt;
+  }
+  const boost::json::object& obj = root.get_object();
+  ForwardedQuery query;
+  query.host.host = GetString(obj, "host");
+  int64_t port = GetInt(obj, "port", 0);
+  if (query.host.host.empty() || port <= 0 || port > UINT16_MAX) {
+    return std::nullopt;
+  }
+  query.host.port = static_cast<uint16_t>(port);
+  query.host.username = GetString(obj, "username");
+  query.host.password = GetString(obj, "password");
+  query.policy.use_tls = GetBool(obj, "use_tls", query.policy.use_tls);
+  query.policy.verify_server_certificate = GetBool(
+      obj, "verify_server", query.policy.verify_server_certificate);
+  query.options.expand_levels =
+      GetInt(obj, "expand_levels", query.options.expand_levels);
+  query.options.select = GetBool(obj, "select", query.options.select);
+
+  const boost::json::value* redpaths = obj.if_contains("redpaths");
+  if (redpaths == nullptr || !redpaths->is_array()) {
+    return std::nullopt;
+  }
+  for (const boost::json::value& redpath : redpaths->get_array()) {
+    if (!redpath.is_string()) {
+      return std::nullopt;
+    }
+    query.redpaths.emplace_back(redpath.get_string());
+  }
+  return query;
+}
+
+std::filesystem::path DefaultServerSocket() {
+  const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+  if (runtime_dir != nullptr && *runtime_dir != '\0') {
+    return std::filesystem::path(runtime_dir) / "rtool.sock";
+  }
+  return std::filesystem::temp_directory_path() /
+         ("rtool-" + std::to_string(::getuid()) + ".sock");
+}
+
+std::optional<QueryStatus> ForwardQuery(const std::filesystem::path& socket,
+                                        const ForwardedQuery& query,
+                                        const ResultCallback& on_result,
+                                        uid_t owner) {
+  boost::asio::io_context ioc;
+  stream_protocol::socket conn(ioc);
+  if (!ConnectToServer(conn, socket, owner)) {
+    return std::nullopt;
+  }
+  boost::system::error_code ec;
+  std::string request = SerializeQuery(query);
+  request += '\n';
+  boost::asio::write(conn, boost::asio::buffer(request), ec);
+  if (ec) {
+    SPDLOG_DEBUG("Failed to send query to {}: {}", socket.string(),
+                 ec.message());
+    return std::nullopt;
+  }
+
+  std::string buffer;
+  bool any_results = false;
+  while (true) {
+    std::size_t size =
+        boost::asio::read_until(conn, boost::asio::dynamic_buffer(buffer),
+                                '\n', ec);
+    boost::json::value line;
+    if (!ec) {
+      line = boost::json::parse(std::string_view(buffer).substr(0, size - 1),
+                                ec);
+    }
+    if (ec || !line.is_object()) {
+      if (!any_results) {
+        SPDLOG_DEBUG("Server on {} dropped the query", socket.string());
+        return std::nullopt;
+      }
+      // Some results were already reported, so running the query again
+      // would repeat them
+      SPDLOG_ERROR("Lost connection to server on {}", socket.string());
+      return QueryStatus{.requests = 1, .failed_requests = 1};
+    }
+    const boost::json::object& obj = line.get_object();
+    if (obj.contains("error")) {
+      SPDLOG_INFO("Server on {} can't run the query: {}", socket.string(),
+                  GetString(obj, "error"));
+      return std::nullopt;
+    }
+    if (obj.contains("redpath")) {
+      any_results = true;
+      on_result(GetString(obj, "redpath"), GetString(obj, "value"));
+    } else {
+      return QueryStatus{
+          .requests = static_cast<uint64_t>(GetInt(obj, "requests", 0)),
+          .failed_requests =
+              static_cast<uint64_t>(GetInt(obj, "failed_requests", 0))};
+    }
+    buffer.erase(0, size);
+  }
+}
+
+boost::json::object StatsToJson(
+    const http::ClientStats& stats,
+    const std::map<std::string, http::HostStats>& hosts) {
+  http::HostStats total;
+  boost::json::object by_host;
+  for (const auto& [host, host_stats] : hosts) {
+    total += host_stats;
+    by_host[host] = HostStatsToJson(host_stats);
+  }
+  boost::json::object out = HostStatsToJson(total);
+  out["full_handshakes"] = stats.full_handshakes;
+  out["resumed_handshakes"] = stats.resumed_handshakes;
+  out["logins"] = stats.logins;
+  out["cached_sessions"] = stats.cached_sessions;
+  out["coalesced_requests"] = stats.coalesced_requests;
+  out["cached_responses"] = stats.cached_responses;
+  out["deferred_requests"] = stats.deferred_requests;
+  out["rejected_requests"] = stats.rejected_requests;
+  out["retried_requests"] = stats.retried_requests;
+  out["short_circuited_requests"] = stats.short_circuited_requests;
+  out["hedged_requests"] = stats.hedged_requests;
+  out["hedges_won"] = stats.hedges_won;
+  out["pipelined_requests"] = stats.pipelined_requests;
+  out["pipeline_fallbacks"] = stats.pipeline_fallbacks;
+  out["http2_connections"] = stats.http2_connections;
+  out["http2_requests"] = stats.http2_requests;
+  out["prewarmed_connections"] = stats.prewarmed_connections;
+  out["recycled_connections"] = stats.recycled_connections;
+  out["hosts"] = std::move(by_host);
+  return out;
+}
+
+std::optional<boost::json::object> FetchStats(
+    const std::filesystem::path& socket, uid_t owner) {
+  boost::asio::io_context ioc;
+  stream_protocol::socket conn(ioc);
+  if (!ConnectToServer(conn, socket, owner)) {
+    return std::nullopt;
+  }
+  boost::system::error_code ec;
+  std::string request = Frame({{"stats", true}});
+  boost::asio::write(conn, boost::asio::buffer(request), ec);
+  if (ec) {
+    SPDLOG_DEBUG("Failed to send stats request to {}: {}", socket.string(),
+                 ec.message());
+    return std::nullopt;
+  }
+  std::string buffer;
+  std::size_t size = boost::asio::read_until(
+      conn, boost::asio::dynamic_buffer(buffer), '\n', ec);
+  boost::json::value line;
+  if (!ec) {
+    line = boost::json::parse(std::string_view(buffer).substr(0, size - 1), ec);
+  }
+  if (ec || !line.is_object() || line.get_object().contains("error")) {
+    SPDLOG_ERROR("Server on {} didn't send its stats", socket.string());
+    return std::nullopt;
+  }
+  return std::move(line.get_object());
+}
+
+QueryServer::QueryServer(boost::asio::io_context& ioc_in,
+                         std::filesystem::path socket,
+                         const redfish::ClientOptions& options)
+    : ioc_(ioc_in),
+      socket_(std::move(socket)),
+      acceptor_(ioc_in),
+      client_(ioc_in, options) {}
+
+QueryServer::~QueryServer() {
+  if (listening_) {
+    std::error_code ec;
+    std::filesystem::remove(socket_, ec);
+  }
+}
+
+bool QueryServer::Listen() {
+  stream_protocol::endpoint endpoint(socket_.string());
+  boost::system::error_code ec;
+  std::error_code fs_ec;
+  // A socket left behind by a server that's gone is replaced, but one that's
+  // still being served isn't
+  if (std::filesystem::exists(socket_, fs_ec)) {
+    stream_protocol::socket probe(ioc_);
+    probe.connect(endpoint, ec);
+    if (!ec) {
+      SPDLOG_ERROR("A server is already listening on {}", socket_.string());
+      return false;
+    }
+    std::filesystem::remove(socket_, fs_ec);
+  }
+
+  acceptor_.open(endpoint.protocol(), ec);
+  if (ec) {
+    SPDLOG_ERROR("Failed to open {}: {}", socket_.string(), ec.message());
+    return false;
+  }
+  // Queries carry credentials, so the socket is only ever usable by its
+  // owner
+  mode_t old_mask = ::umask(0077);
+  acceptor_.bind(endpoint, ec);
+  ::umask(old_mask);
+  if (ec) {
+    SPDLOG_ERROR("Failed to bind {}: {}", socket_.string(), ec.message());
+    return false;
+  }
+  listening_ = true;
+  acceptor_.listen(boost::asio::socket_base::max_listen_connections, ec);
+  if (ec) {
+    SPDLOG_ERROR("Failed to listen on {}: {}", socket_.string(),
+                 ec.message());
+    return false;
+  }
+  SPDLOG_INFO("Serving queries on {}", socket_.string());
+  Accept();
+  return true;
+}
+
+void QueryServer::Accept() {
+  acceptor_.async_accept(std::bind_front(&QueryServer::OnAccept, this));
+}
+
+void QueryServer::OnAccept(const boost::system::error_code& ec,
+                           stream_protocol::socket socket) {
+  if (ec) {
+    if (ec == boost::asio::error::operation_aborted) {
+      return;
+    }
+    SPDLOG_ERROR("Failed to accept connection: {}", ec.message());
+  } else {
+    std::make_shared<QuerySession>(client_, logins_, std::move(socket))
+        ->Start();
+  }
+  Accept();
+}
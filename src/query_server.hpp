@@ -0,0 +1,103 @@
+#pragma once
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/json/object.hpp>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "http_client.hpp"
+#include "redfish_client.hpp"
+#include "redpath_query.hpp"
+
+// rtool serve keeps a redfish::Client, with its warm connections and
+// sessions, behind a Unix socket, so that short lived rtool invocations only
+// pay for the requests themselves.
+//
+// Each connection carries one query, framed as newline separated JSON
+// objects.  The client sends
+//   {"host": ..., "port": ..., "username": ..., "password": ...,
+//    "use_tls": ..., "verify_server": ..., "expand_levels": ...,
+//    "select": ..., "redpaths": [...]}
+// and the server replies with one {"redpath": ..., "value": ...} per value
+// found, then {"requests": ..., "failed_requests": ...} once the query is
+// done, or a single {"error": ...} if it can't serve the query.  A host is
+// only ever queried as one user: queries with credentials other than the
+// first ones it was queried with aren't served.
+//
+// A connection may instead send {"stats": true}, and gets back the server's
+// counters (see StatsToJson) as a single object.
+
+struct ForwardedQuery {
+  HostConnectData host;
+  http::ConnectPolicy policy;
+  RedpathQueryOptions options;
+  std::vector<std::string> redpaths;
+};
+
+std::string SerializeQuery(const ForwardedQuery& query);
+
+std::optional<ForwardedQuery> ParseQuery(std::string_view line);
+
+// $XDG_RUNTIME_DIR/rtool.sock, falling back to a per user path in /tmp
+std::filesystem::path DefaultServerSocket();
+
+// Sends query to the server listening on socket, calling on_result with each
+// value it finds.  Returns nullopt, having called nothing, if no server is
+// listening or the server can't serve the query, in which case the caller
+// should run the query itself.  The query carries credentials, so it's only
+// sent to a server run by owner.
+std::optional<QueryStatus> ForwardQuery(const std::filesystem::path& socket,
+                                        const ForwardedQuery& query,
+                                        const ResultCallback& on_result,
+                                        uid_t owner = ::getuid());
+
+// A client's counters, with the per host ones both totalled and by host:port
+boost::json::object StatsToJson(
+    const http::ClientStats& stats,
+    const std::map<std::string, http::HostStats>& hosts);
+
+// Asks the server listening on socket for its counters.  Returns nullopt if
+// no server run by owner is listening.
+std::optional<boost::json::object> FetchStats(
+    const std::filesystem::path& socket, uid_t owner = ::getuid());
+
+class QueryServer {
+ private:
+  boost::asio::io_context& ioc_;
+  std::filesystem::path socket_;
+  boost::asio::local::stream_protocol::acceptor acceptor_;
+  redfish::Client client_;
+  // The credentials each host:port was first queried with.  Queries with
+  // any others are refused, and run by the caller instead.
+  std::unordered_map<std::string, http::Credentials> logins_;
+  // Whether socket_ is ours to remove
+  bool listening_ = false;
+
+  void Accept();
+
+  void OnAccept(const boost::system::error_code& ec,
+                boost::asio::local::stream_protocol::socket socket);
+
+ public:
+  QueryServer(boost::asio::io_context& ioc_in, std::filesystem::path socket,
+              const redfish::ClientOptions& options);
+
+  QueryServer(const QueryServer&) = delete;
+  QueryServer& operator=(const QueryServer&) = delete;
+  QueryServer(QueryServer&&) = delete;
+  QueryServer& operator=(QueryServer&&) = delete;
+  ~QueryServer();
+
+  // Starts accepting queries.  Returns false if the socket can't be bound,
+  // including when another server is already listening on it.
+  bool Listen();
+};
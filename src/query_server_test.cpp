@@ -0,0 +1,197 @@
+#include "query_server.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <optional>
+#include <thread>
+
+#include "gmock/gmock.h"
+
+namespace {
+
+// A port on localhost that nothing is listening on
+uint16_t ClosedPort() {
+  boost::asio::io_context ioc;
+  boost::asio::ip::tcp::acceptor acceptor(
+      ioc, boost::asio::ip::tcp::endpoint(
+               boost::asio::ip::make_address("127.0.0.1"), 0));
+  return acceptor.local_endpoint().port();
+}
+
+TEST(ParseQuery, RoundTrips) {
+  ForwardedQuery query{
+      .host = {.host = "bmc", .port = 8443, .username = "root",
+               .password = "secret"},
+      .policy = {.use_tls = false},
+      .options = {.expand_levels = 0, .select = false},
+      .redpaths = {"Systems", "Chassis/Sensors"},
+  };
+  std::optional<ForwardedQuery> parsed = ParseQuery(SerializeQuery(query));
+  ASSERT_TRUE(parsed);
+  EXPECT_EQ(parsed->host.host, "bmc");
+  EXPECT_EQ(parsed->host.port, 8443);
+  EXPECT_EQ(parsed->host.username, "root");
+  EXPECT_EQ(parsed->host.password, "secret");
+  EXPECT_FALSE(parsed->policy.use_tls);
+  EXPECT_TRUE(parsed->policy.verify_server_certificate);
+  EXPECT_EQ(parsed->options.expand_levels, 0);
+  EXPECT_FALSE(parsed->options.select);
+  EXPECT_THAT(parsed->redpaths,
+              testing::ElementsAre("Systems", "Chassis/Sensors"));
+}
+
+TEST(ParseQuery, RejectsMalformedQueries) {
+  EXPECT_FALSE(ParseQuery("not json"));
+  EXPECT_FALSE(ParseQuery(R"({"port": 443, "redpaths": []})"));
+  EXPECT_FALSE(ParseQuery(R"({"host": "bmc", "port": 70000})"));
+  EXPECT_FALSE(ParseQuery(R"({"host": "bmc", "port": 443})"));
+  EXPECT_FALSE(
+      ParseQuery(R"({"host": "bmc", "port": 443, "redpaths": [1]})"));
+}
+
+TEST(StatsToJson, TotalsHostsAndKeepsEach) {
+  http::ClientStats stats;
+  stats.logins = 2;
+  std::map<std::string, http::HostStats> hosts;
+  hosts["bmc1:443"] = {.requests = 3, .queued_requests = 1,
+                       .peak_queued_requests = 4};
+  hosts["bmc2:443"] = {.requests = 5, .peak_queued_requests = 2};
+
+  boost::json::object out = StatsToJson(stats, hosts);
+  EXPECT_EQ(out.at("logins").to_number<uint64_t>(), 2U);
+  EXPECT_EQ(out.at("requests").to_number<uint64_t>(), 8U);
+  EXPECT_EQ(out.at("queued_requests").to_number<uint64_t>(), 1U);
+  // The highest any one host reached
+  EXPECT_EQ(out.at("peak_queued_requests").to_number<uint64_t>(), 4U);
+  const boost::json::object& by_host = out.at("hosts").as_object();
+  ASSERT_EQ(by_host.size(), 2U);
+  EXPECT_EQ(by_host.at("bmc2:443").at("requests").to_number<uint64_t>(), 5U);
+}
+
+class QueryServerTest : public ::testing::Test {
+ protected:
+  std::filesystem::path socket_ = std::filesystem::temp_directory_path() /
+                                  ("rtool_test_" +
+                                   std::to_string(::getpid()) + ".sock");
+  ForwardedQuery query_{
+      .host = {.host = "127.0.0.1", .port = ClosedPort()},
+      .policy = {.use_tls = false},
+      .redpaths = {"Systems"},
+  };
+
+  void TearDown() override { std::filesystem::remove(socket_); }
+};
+
+TEST_F(QueryServerTest, FallsBackWithoutServer) {
+  bool called = false;
+  EXPECT_EQ(ForwardQuery(socket_, query_,
+                         [&called](std::string_view, std::string_view) {
+                           called = true;
+                         }),
+            std::nullopt);
+  EXPECT_FALSE(called);
+}
+
+TEST_F(QueryServerTest, ForwardsQueries) {
+  boost::asio::io_context ioc;
+  QueryServer server(ioc, socket_,
+                     redfish::ClientOptions{.connect = {.use_tls = false}});
+  ASSERT_TRUE(server.Listen());
+  // Only the owner may connect
+  struct stat info{};
+  ASSERT_EQ(::stat(socket_.c_str(), &info), 0);
+  EXPECT_EQ(info.st_mode & 077, 0U);
+
+  auto work = boost::asio::make_work_guard(ioc);
+  std::thread thread([&ioc]() { ioc.run(); });
+
+  std::optional<QueryStatus> status = ForwardQuery(
+      socket_, query_, [](std::string_view, std::string_view) {});
+  ASSERT_TRUE(status);
+  EXPECT_EQ(status->requests, 1U);
+  EXPECT_EQ(status->failed_requests, 1U);
+
+  // Queries the server can't run the way they ask are left to the caller
+  query_.policy.use_tls = true;
+  EXPECT_EQ(ForwardQuery(socket_, query_,
+                         [](std::string_view, std::string_view) {}),
+            std::nullopt);
+  // Including ones as a user other than the host was first queried as
+  query_.policy.use_tls = false;
+  query_.host.username = "root";
+  EXPECT_EQ(ForwardQuery(socket_, query_,
+                         [](std::string_view, std::string_view) {}),
+            std::nullopt);
+
+  work.reset();
+  ioc.stop();
+  thread.join();
+}
+
+TEST_F(QueryServerTest, RefusesServerRunByAnotherUser) {
+  boost::asio::io_context ioc;
+  boost::asio::local::stream_protocol::acceptor acceptor(
+      ioc, boost::asio::local::stream_protocol::endpoint(socket_.string()));
+  query_.host.username = "root";
+  query_.host.password = "secret";
+  uid_t other_user = ::getuid() + 1;
+  EXPECT_EQ(ForwardQuery(socket_, query_,
+                         [](std::string_view, std::string_view) {},
+                         other_user),
+            std::nullopt);
+  EXPECT_EQ(FetchStats(socket_, other_user), std::nullopt);
+
+  // Neither the query, nor its credentials, were sent
+  for (int connection = 0; connection < 2; connection++) {
+    boost::asio::local::stream_protocol::socket conn(ioc);
+    acceptor.accept(conn);
+    std::array<char, 64> buffer{};
+    boost::system::error_code ec;
+    EXPECT_EQ(conn.read_some(boost::asio::buffer(buffer), ec), 0U);
+    EXPECT_EQ(ec, boost::asio::error::eof);
+  }
+}
+
+TEST_F(QueryServerTest, ServesStats) {
+  EXPECT_EQ(FetchStats(socket_), std::nullopt);
+
+  boost::asio::io_context ioc;
+  QueryServer server(ioc, socket_,
+                     redfish::ClientOptions{.connect = {.use_tls = false}});
+  ASSERT_TRUE(server.Listen());
+  auto work = boost::asio::make_work_guard(ioc);
+  std::thread thread([&ioc]() { ioc.run(); });
+
+  ASSERT_TRUE(ForwardQuery(socket_, query_,
+                           [](std::string_view, std::string_view) {}));
+  std::optional<boost::json::object> stats = FetchStats(socket_);
+  ASSERT_TRUE(stats);
+  // Nothing listens on the host's port, so nothing was sent
+  EXPECT_EQ(stats->at("requests").to_number<uint64_t>(), 0U);
+  EXPECT_EQ(stats->at("opened_connections").to_number<uint64_t>(), 0U);
+  const boost::json::object& hosts = stats->at("hosts").as_object();
+  EXPECT_TRUE(
+      hosts.contains(std::format("127.0.0.1:{}", query_.host.port)));
+
+  work.reset();
+  ioc.stop();
+  thread.join();
+}
+
+TEST_F(QueryServerTest, RefusesSocketInUse) {
+  boost::asio::io_context ioc;
+  QueryServer first(ioc, socket_, redfish::ClientOptions{});
+  ASSERT_TRUE(first.Listen());
+  QueryServer second(ioc, socket_, redfish::ClientOptions{});
+  EXPECT_FALSE(second.Listen());
+}
+
+}  // namespace
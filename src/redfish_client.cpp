@@ -0,0 +1,72 @@
+#include "redfish_client.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <boost/asio/dispatch.hpp>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "path_parser.hpp"
+#include "session_cache.hpp"
+
+namespace redfish {
+
+Client::Client(boost::asio::io_context& ioc_in, const ClientOptions& options)
+    : ioc_(ioc_in),
+      options_(options),
+      client_(std::make_shared<http::Client>(ioc_in, options.connect)) {
+  client_->SetResponseCacheSize(options_.response_cache_size);
+  if (!options_.session_cache_file.empty()) {
+    client_->SetSessionCache(
+        std::make_shared<http::SessionCache>(options_.session_cache_file));
+  }
+}
+
+bool Client::Query(const HostConnectData& host,
+                   const std::vector<std::string>& redpaths,
+                   const RedpathQueryOptions& options,
+                   ResultCallback&& on_result, DoneCallback&& on_done) {
+  // Parsing touches no shared state, so it's done on the calling thread where
+  // a bad redpath can be reported straight back
+  std::vector<filter_ast::path> paths;
+  for (const std::string& redpath : redpaths) {
+    std::optional<filter_ast::path> path = parseRedfishPath(redpath);
+    if (!path) {
+      SPDLOG_DEBUG("Path {} was not valid", redpath);
+      return false;
+    }
+    paths.emplace_back(std::move(*path));
+  }
+  boost::asio::dispatch(ioc_, [this, host, paths = std::move(paths), options,
+                               on_result = std::move(on_result),
+                               on_done = std::move(on_done)]() mutable {
+    StartQuery(host, std::move(paths), options, std::move(on_result),
+               std::move(on_done));
+  });
+  return true;
+}
+
+void Client::StartQuery(const HostConnectData& host,
+                        std::vector<filter_ast::path>&& redpaths,
+                        const RedpathQueryOptions& options,
+                        ResultCallback&& on_result, DoneCallback&& on_done) {
+  // Cheap when the host already has these credentials, and picks up
+  // corrected or different ones when it doesn't
+  if (!host.username.empty()) {
+    client_->Authenticate(host.host, host.port,
+                          http::Credentials{.username = host.username,
+                                            .password = host.password});
+  }
+  auto query = std::make_shared<RedpathQuery>(
+      client_, host, std::move(redpaths), options, std::move(on_result));
+  query->Start(std::move(on_done));
+}
+
+void Client::Close(const HostConnectData& host) {
+  boost::asio::dispatch(ioc_, [this, host]() {
+    client_->Close(host.host, host.port);
+  });
+}
+
+}  // namespace redfish
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/io_context.hpp>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "async_handler.hpp"
+#include "http_client.hpp"
+#include "redpath_query.hpp"
+
+namespace redfish {
+
+struct ClientOptions {
+  http::ConnectPolicy connect;
+  RedpathQueryOptions query;
+  // Completed responses kept and reused by later queries.  A long lived
+  // client would otherwise serve stale readings, so it's off by default.
+  std::size_t response_cache_size = 0;
+  // File to persist session tokens in between processes.  Empty keeps them
+  // in memory only.
+  std::filesystem::path session_cache_file;
+};
+
+struct QueryValue {
+  std::string redpath;
+  std::string value;
+};
+
+struct QueryResult {
+  std::vector<QueryValue> values;
+  QueryStatus status;
+  // Set if the query couldn't be started
+  std::string error;
+};
+
+// A long lived Redfish client, for embedding rtool in another program.
+// Connections, TLS sessions and Redfish sessions are kept per host and reused
+// by every query, so polling a host doesn't pay for a new handshake or login
+// each time.
+//
+// All work runs on the io_context given at construction, which the caller
+// runs.  Query, AsyncQuery and Close may be called from any thread.
+class Client {
+ private:
+  boost::asio::io_context& ioc_;
+  ClientOptions options_;
+  std::shared_ptr<http::Client> client_;
+
+  void StartQuery(const HostConnectData& host,
+                  std::vector<filter_ast::path>&& redpaths,
+                  const RedpathQueryOptions& options,
+                  ResultCallback&& on_result, DoneCallback&& on_done);
+
+ public:
+  Client(boost::asio::io_context& ioc_in, const ClientOptions& options);
+
+  Client(const Client&) = delete;
+  Client& operator=(const Client&) = delete;
+  Client(Client&&) = delete;
+  Client& operator=(Client&&) = delete;
+  ~Client() = default;
+
+  // Resolves redpaths on host.  on_result is called with each value as it's
+  // found, and on_done once the query is finished, both on the io_context.
+  // Returns false, without calling either, if a redpath doesn't parse.
+  bool Query(const HostConnectData& host,
+             const std::vector<std::string>& redpaths,
+             ResultCallback&& on_result, DoneCallback&& on_done) {
+    return Query(host, redpaths, options_.query, std::move(on_result),
+                 std::move(on_done));
+  }
+
+  // Query with options other than the ones the client was created with
+  bool Query(const HostConnectData& host,
+             const std::vector<std::string>& redpaths,
+             const RedpathQueryOptions& options, ResultCallback&& on_result,
+             DoneCallback&& on_done);
+
+  // Query for any asio completion token, completing with every value found.
+  // For example, with boost::asio::use_future from outside the io_context:
+  //   std::future<QueryResult> result =
+  //       client.AsyncQuery(host, {"Systems"}, boost::asio::use_future);
+  template <typename CompletionToken>
+  auto AsyncQuery(const HostConnectData& host,
+                  std::vector<std::string> redpaths, CompletionToken&& token) {
+    return boost::asio::async_initiate<CompletionToken, void(QueryResult)>(
+        [this](auto handler, const HostConnectData& host,
+               const std::vector<std::string>& redpaths) {
+          auto result = std::make_shared<QueryResult>();
+          auto complete = http::BindHandler<QueryResult>(std::move(handler),
+                                                         ioc_.get_executor());
+          bool started = Query(
+              host, redpaths,
+              [result](std::string_view redpath, std::string_view value) {
+                result->values.emplace_back(std::string(redpath),
+                                            std::string(value));
+              },
+              [result, complete](const QueryStatus& status) {
+                result->status = status;
+                complete(std::move(*result));
+              });
+          if (!started) {
+            result->error = "Invalid redpath";
+            complete(std::move(*result));
+          }
+        },
+        token, host, std::move(redpaths));
+  }
+
+  const http::ConnectPolicy& Policy() const { return options_.connect; }
+
+  // What the client's done so far.  Read on the io_context.
+  const http::ClientStats& Stats() const { return client_->Stats(); }
+  std::map<std::string, http::HostStats> StatsByHost() const {
+    return client_->StatsByHost();
+  }
+
+  // Closes the connections to host.  Its session is kept, and reused if it's
+  // queried again.
+  void Close(const HostConnectData& host);
+};
+
+}  // namespace redfish
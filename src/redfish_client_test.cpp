@@ -0,0 +1,136 @@
+// Uses the library the way an embedding program would, through
+// redfish_client.hpp alone, against a MockBmc
+#include "redfish_client.hpp"
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/use_future.hpp>
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include "gmock/gmock.h"
+#include "mock_bmc.hpp"
+
+namespace {
+
+// A port on localhost that nothing is listening on
+uint16_t ClosedPort() {
+  boost::asio::io_context ioc;
+  boost::asio::ip::tcp::acceptor acceptor(
+      ioc, boost::asio::ip::tcp::endpoint(
+               boost::asio::ip::make_address("127.0.0.1"), 0));
+  return acceptor.local_endpoint().port();
+}
+
+// Runs an io_context on its own thread, the way a program embedding the
+// client alongside other work would
+class RedfishClientTest : public testing::Test {
+ protected:
+  boost::asio::io_context ioc;
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type>
+      work = boost::asio::make_work_guard(ioc);
+  redfish::Client client{ioc, redfish::ClientOptions{
+                                  .connect = {.use_tls = false},
+                              }};
+  std::thread thread{[this]() { ioc.run(); }};
+
+  ~RedfishClientTest() override {
+    work.reset();
+    thread.join();
+  }
+};
+
+TEST_F(RedfishClientTest, RejectsInvalidRedpaths) {
+  HostConnectData host{.host = "127.0.0.1", .port = ClosedPort()};
+  EXPECT_FALSE(client.Query(host, {"Systems["}, nullptr, nullptr));
+
+  std::future<redfish::QueryResult> result =
+      client.AsyncQuery(host, {"Systems["}, boost::asio::use_future);
+  redfish::QueryResult done = result.get();
+  EXPECT_FALSE(done.error.empty());
+  EXPECT_EQ(done.status.requests, 0U);
+}
+
+TEST_F(RedfishClientTest, CompletesWhenHostIsUnreachable) {
+  HostConnectData host{.host = "127.0.0.1", .port = ClosedPort()};
+  std::future<redfish::QueryResult> result =
+      client.AsyncQuery(host, {"Systems"}, boost::asio::use_future);
+  redfish::QueryResult done = result.get();
+  EXPECT_TRUE(done.error.empty());
+  EXPECT_TRUE(done.values.empty());
+  EXPECT_EQ(done.status.requests, 1U);
+  EXPECT_EQ(done.status.failed_requests, 1U);
+
+  // The client stays usable once a host has failed
+  result = client.AsyncQuery(host, {"Systems"}, boost::asio::use_future);
+  EXPECT_EQ(result.get().status.failed_requests, 1U);
+  client.Close(host);
+}
+
+TEST_F(RedfishClientTest, KeepsLoggedInAcrossClose) {
+  boost::asio::io_context bmc_ioc;
+  MockBmc bmc(bmc_ioc, {.chassis = 2,
+                        .sensors_per_chassis = 2,
+                        .require_session = true});
+  ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+  auto bmc_work = boost::asio::make_work_guard(bmc_ioc);
+  std::thread bmc_thread([&bmc_ioc]() { bmc_ioc.run(); });
+
+  HostConnectData host{.host = "127.0.0.1",
+                       .port = bmc.Port(),
+                       .username = "root",
+                       .password = "secret",
+                       .session_cache = false};
+  auto read_sensors = [this, &host]() {
+    return client
+        .AsyncQuery(host, {"Chassis[*]/Sensors[*]/Reading"},
+                    boost::asio::use_future)
+        .get();
+  };
+  redfish::QueryResult first = read_sensors();
+  EXPECT_EQ(first.status.failed_requests, 0U);
+  EXPECT_EQ(first.values.size(), 4U);
+
+  // Queried again with the session from before the close
+  client.Close(host);
+  redfish::QueryResult second = read_sensors();
+  EXPECT_EQ(second.status.failed_requests, 0U);
+  EXPECT_EQ(second.values.size(), 4U);
+
+  // Other credentials get a session of their own
+  host.username = "operator";
+  redfish::QueryResult third = read_sensors();
+  EXPECT_EQ(third.status.failed_requests, 0U);
+  EXPECT_EQ(third.values.size(), 4U);
+  client.Close(host);
+
+  bmc_work.reset();
+  bmc_ioc.stop();
+  bmc_thread.join();
+  EXPECT_EQ(bmc.Stats().logins, 2U);
+}
+
+TEST_F(RedfishClientTest, CompletesWhenClosedWithRequestsQueued) {
+  boost::asio::io_context bmc_ioc;
+  MockBmc bmc(bmc_ioc, {.latency = std::chrono::milliseconds(200)});
+  ASSERT_TRUE(bmc.Listen("127.0.0.1", 0));
+  auto bmc_work = boost::asio::make_work_guard(bmc_ioc);
+  std::thread bmc_thread([&bmc_ioc]() { bmc_ioc.run(); });
+
+  HostConnectData host{.host = "127.0.0.1", .port = bmc.Port()};
+  std::future<redfish::QueryResult> result = client.AsyncQuery(
+      host, {"Chassis[*]/Sensors[*]/Reading"}, boost::asio::use_future);
+  // Closed before the query's first request has been taken by a connection
+  client.Close(host);
+  ASSERT_EQ(result.wait_for(std::chrono::seconds(10)),
+            std::future_status::ready);
+  EXPECT_GT(result.get().status.failed_requests, 0U);
+
+  bmc_work.reset();
+  bmc_ioc.stop();
+  bmc_thread.join();
+}
+
+}  // namespace
@@ -0,0 +1,105 @@
+#include "redpath_matcher.hpp"
+
+#include <algorithm>
+#include <variant>
+
+namespace redfish {
+
+namespace {
+struct KeyLess {
+  bool operator()(const std::pair<std::string, RedpathMatcher::State>& child,
+                  std::string_view key) const {
+    return child.first < key;
+  }
+};
+
+std::string_view ComponentKey(const filter_ast::path_component& component) {
+  if (const filter_ast::key_filter* filter =
+          std::get_if<filter_ast::key_filter>(&component)) {
+    return filter->key;
+  }
+  return std::get<filter_ast::key_name>(component).str();
+}
+}  // namespace
+
+RedpathMatcher::RedpathMatcher(std::span<const filter_ast::path> redpaths)
+    : nodes_(1) {
+  for (uint32_t index = 0; index < redpaths.size(); index++) {
+    const filter_ast::path& redpath = redpaths[index];
+    // States the next component can continue from.  Arrays don't add a key
+    // segment, so they're matched transparently.
+    std::vector<State> frontier = {kRoot};
+    for (uint32_t component = 0; component < redpath.component_count();
+         component++) {
+      const filter_ast::path_component& part = redpath.component(component);
+      std::vector<State> next_frontier;
+      for (State from : frontier) {
+        State state = AddSegment(from, ComponentKey(part));
+        next_frontier.push_back(state);
+
+        State link = AddSegment(state, "@odata.id");
+        nodes_[link].matches.push_back(Match{.redpath = index,
+                                             .component = component,
+                                             .kind = MatchKind::kLink});
+
+        const filter_ast::key_filter* filter =
+            std::get_if<filter_ast::key_filter>(&part);
+        if (filter != nullptr && filter->key != "Members") {
+          // An expanded collection holds its members inline
+          State members = AddSegment(state, "Members");
+          next_frontier.push_back(members);
+          State member_link = AddSegment(members, "@odata.id");
+          nodes_[member_link].matches.push_back(
+              Match{.redpath = index,
+                    .component = component,
+                    .kind = MatchKind::kLink});
+        }
+
+        if (component + 1 == redpath.component_count()) {
+          nodes_[state].matches.push_back(Match{.redpath = index,
+                                                .component = component,
+                                                .kind = MatchKind::kValue});
+        }
+      }
+      frontier = std::move(next_frontier);
+    }
+  }
+}
+
+RedpathMatcher::State RedpathMatcher::AddSegment(State from,
+                                                 std::string_view key) {
+  std::vector<std::pair<std::string, State>>& children = nodes_[from].children;
+  auto it = std::lower_bound(children.begin(), children.end(), key, KeyLess());
+  if (it != children.end() && it->first == key) {
+    return it->second;
+  }
+  State next = static_cast<State>(nodes_.size());
+  children.emplace(it, std::string(key), next);
+  // Note, this may reallocate nodes_, so children can't be used after it
+  nodes_.emplace_back();
+  return next;
+}
+
+RedpathMatcher::State RedpathMatcher::Next(State state,
+                                           std::string_view key) const {
+  if (state == kDead) {
+    return kDead;
+  }
+  const std::vector<std::pair<std::string, State>>& children =
+      nodes_[state].children;
+  auto it = std::lower_bound(children.begin(), children.end(), key, KeyLess());
+  if (it == children.end() || it->first != key) {
+    return kDead;
+  }
+  return it->second;
+}
+
+std::span<const RedpathMatcher::Match> RedpathMatcher::Matches(
+    State state) const {
+  if (state == kDead) {
+    return {};
+  }
+  return nodes_[state].matches;
+}
+
+}  // namespace redfish
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "path_parser_ast.hpp"
+
+namespace redfish {
+
+// A set of redpaths compiled into a trie keyed on JSON key segments.  A parser
+// tracks one State per nesting depth, and checking whether a value matches
+// any redpath is a single transition per key, with no string building.
+//
+// Every component of a redpath is compiled inline, so that a resource which
+// has had its links expanded (by $expand, or because the properties were
+// never links to begin with) is matched without any further requests.  Where
+// a component could instead be a link to another resource, the @odata.id of
+// that link is matched as well, and the caller decides which applies.
+class RedpathMatcher {
+ public:
+  using State = uint32_t;
+
+  enum class MatchKind : uint8_t {
+    // The @odata.id of a link that the component at `component` refers to
+    kLink,
+    // The value of the last component
+    kValue,
+  };
+
+  struct Match {
+    // Index into the redpaths the matcher was built from
+    uint32_t redpath;
+    // Index of the redpath component that matched
+    uint32_t component;
+    MatchKind kind;
+  };
+
+  static constexpr State kRoot = 0;
+  // No redpath can match at, or anywhere beneath, this state
+  static constexpr State kDead = std::numeric_limits<State>::max();
+
+  explicit RedpathMatcher(std::span<const filter_ast::path> redpaths);
+
+  // Returns the state reached by descending into key from state
+  State Next(State state, std::string_view key) const;
+
+  // Redpaths that match a value found at state
+  std::span<const Match> Matches(State state) const;
+
+  std::size_t StateCount() const { return nodes_.size(); }
+
+ private:
+  struct Node {
+    // Sorted by key
+    std::vector<std::pair<std::string, State>> children;
+    std::vector<Match> matches;
+  };
+  std::vector<Node> nodes_;
+
+  State AddSegment(State from, std::string_view key);
+};
+
+}  // namespace redfish
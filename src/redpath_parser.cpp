@@ -0,0 +1,287 @@
+#include "redpath_parser.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <boost/json/basic_parser_impl.hpp>
+#include <format>
+#include <string>
+
+#include "boost_formatter.hpp"
+
+// Handler methods don't follow the naming convention.
+// NOLINTBEGIN
+RedpathParser::Handler::Handler(
+    std::vector<redfish::filter_ast::path>&& redpaths_in,
+    MatchCallback&& on_match_in)
+    : redpaths(std::move(redpaths_in)),
+      matcher(redpaths),
+      on_match(std::move(on_match_in)) {}
+
+bool RedpathParser::Handler::begin_container(bool is_array) {
+  if (skip_depth > 0) {
+    skip_depth++;
+    return true;
+  }
+  if (value_state == redfish::RedpathMatcher::kDead) {
+    // Nothing beneath here can match, so don't bother tracking it
+    skip_depth = 1;
+    return true;
+  }
+  frames.push_back(Frame{.state = value_state,
+                         .key_offset = key_buffer.size(),
+                         .is_array = is_array,
+                         .properties = 0});
+  return true;
+}
+
+bool RedpathParser::Handler::end_container() {
+  if (skip_depth > 0) {
+    skip_depth--;
+    if (skip_depth == 0) {
+      end_value();
+    }
+    return true;
+  }
+  while (!pending_links.empty() &&
+         pending_links.back().depth == frames.size()) {
+    if (frames.back().properties == 0) {
+      follow_links(pending_links.back());
+    }
+    pending_links.pop_back();
+  }
+  frames.pop_back();
+  end_value();
+  return true;
+}
+
+void RedpathParser::Handler::follow_links(const PendingLink& link) {
+  // frames.back() is the object holding the @odata.id
+  bool in_array = frames.size() >= 2 && frames[frames.size() - 2].is_array;
+  for (const redfish::RedpathMatcher::Match& match :
+       matcher.Matches(link.state)) {
+    if (match.kind != redfish::RedpathMatcher::MatchKind::kLink) {
+      continue;
+    }
+    const redfish::filter_ast::path& redpath = redpaths[match.redpath];
+    std::optional<redfish::filter_ast::path> remaining =
+        redpath.suffix_after(match.component);
+    const redfish::filter_ast::key_filter* filter =
+        std::get_if<redfish::filter_ast::key_filter>(
+            &redpath.component(match.component));
+    if (!in_array && filter != nullptr && filter->key != "Members") {
+      // A link to a collection.  The rest of the redpath applies to each of
+      // its members.
+      redfish::filter_ast::path members{
+          .first = redfish::filter_ast::key_filter{.key = "Members",
+                                                   .filter = filter->filter},
+          .filters = {}};
+      if (remaining) {
+        members.filters.push_back(remaining->first);
+        members.filters.insert(members.filters.end(),
+                               remaining->filters.begin(),
+                               remaining->filters.end());
+      }
+      remaining = std::move(members);
+    }
+    SPDLOG_DEBUG("Following {} for {}", link.uri, redpath.to_path_string());
+    on_match(RedpathMatch{.redpath = match.redpath,
+                          .remaining = std::move(remaining),
+                          .value = link.uri});
+  }
+}
+
+void RedpathParser::Handler::on_scalar(std::string_view value) {
+  bool is_link = false;
+  for (const redfish::RedpathMatcher::Match& match :
+       matcher.Matches(value_state)) {
+    if (match.kind == redfish::RedpathMatcher::MatchKind::kLink) {
+      is_link = true;
+      continue;
+    }
+    SPDLOG_DEBUG("Found match {}", current_key());
+    on_match(RedpathMatch{.redpath = match.redpath,
+                          .remaining = std::nullopt,
+                          .value = std::string(value)});
+  }
+  if (is_link) {
+    pending_links.push_back(PendingLink{
+        .depth = frames.size(), .state = value_state, .uri = std::string(value)});
+  }
+}
+
+// Called when any value, scalar or otherwise, has been completely parsed
+void RedpathParser::Handler::end_value() {
+  if (frames.empty()) {
+    key_buffer.clear();
+    return;
+  }
+  const Frame& parent = frames.back();
+  key_buffer.resize(parent.key_offset);
+  if (parent.is_array) {
+    // Array elements are matched as if they were the array itself
+    value_state = parent.state;
+  }
+}
+
+bool RedpathParser::Handler::on_object_begin(std::error_code& /*unused*/) {
+  return begin_container(false);
+}
+
+bool RedpathParser::Handler::on_object_end(std::size_t /*unused*/,
+                                           std::error_code& /*unused*/) {
+  return end_container();
+}
+
+bool RedpathParser::Handler::on_array_begin(std::error_code& /*unused*/) {
+  return begin_container(true);
+}
+
+bool RedpathParser::Handler::on_array_end(std::size_t /*unused*/,
+                                          std::error_code& /*unused*/) {
+  return end_container();
+}
+
+bool RedpathParser::Handler::on_key_part(std::string_view key,
+                                         std::size_t /*key_size*/,
+                                         std::error_code& /*unused*/) {
+  if (skip_depth > 0) {
+    return true;
+  }
+  if (!in_key) {
+    key_buffer += '/';
+    key_start = key_buffer.size();
+    in_key = true;
+  }
+  key_buffer += key;
+  return true;
+}
+
+bool RedpathParser::Handler::on_key(std::string_view key, std::size_t key_size,
+                                    std::error_code& ec) {
+  if (skip_depth > 0) {
+    return true;
+  }
+  if (!on_key_part(key, key_size, ec)) {
+    return false;
+  }
+  in_key = false;
+  std::string_view name = current_key().substr(key_start);
+  if (!name.starts_with('@')) {
+    frames.back().properties++;
+  }
+  value_state = matcher.Next(frames.back().state, name);
+  return true;
+}
+
+bool RedpathParser::Handler::on_string_part(std::string_view str,
+                                            std::size_t /*unused*/,
+                                            std::error_code& /*unused*/) {
+  if (skip_depth > 0 || matcher.Matches(value_state).empty()) {
+    return true;
+  }
+  current_value += str;
+  return true;
+}
+
+bool RedpathParser::Handler::on_string(std::string_view str,
+                                       std::size_t str_size,
+                                       std::error_code& ec) {
+  if (skip_depth > 0) {
+    return true;
+  }
+  if (!on_string_part(str, str_size, ec)) {
+    return false;
+  }
+
+  on_scalar(current_value);
+
+  end_value();
+  current_value.clear();
+
+  return true;
+}
+
+bool RedpathParser::Handler::on_bool(bool value, std::error_code& /*unused*/) {
+  if (skip_depth > 0) {
+    return true;
+  }
+  if (!matcher.Matches(value_state).empty()) {
+    on_scalar(value ? "true" : "false");
+  }
+  end_value();
+
+  return true;
+}
+
+bool RedpathParser::Handler::on_int64(std::int64_t value,
+                                      std::string_view /*unused*/,
+                                      std::error_code& /*unused*/) {
+  if (skip_depth > 0) {
+    return true;
+  }
+  if (!matcher.Matches(value_state).empty()) {
+    on_scalar(std::to_string(value));
+  }
+  end_value();
+
+  return true;
+}
+
+bool RedpathParser::Handler::on_uint64(std::uint64_t value,
+                                       std::string_view /*unused*/,
+                                       std::error_code& /*unused*/) {
+  if (skip_depth > 0) {
+    return true;
+  }
+  if (!matcher.Matches(value_state).empty()) {
+    on_scalar(std::to_string(value));
+  }
+  end_value();
+  return true;
+}
+
+bool RedpathParser::Handler::on_double(double value,
+                                       std::string_view /*unused*/,
+                                       std::error_code& /*unused*/) {
+  if (skip_depth > 0) {
+    return true;
+  }
+  if (!matcher.Matches(value_state).empty()) {
+    on_scalar(std::format("{}", value));
+  }
+  end_value();
+  return true;
+}
+
+bool RedpathParser::Handler::on_null(std::error_code& /*unused*/) {
+  if (skip_depth > 0) {
+    return true;
+  }
+  if (!matcher.Matches(value_state).empty()) {
+    on_scalar("null");
+  }
+  end_value();
+
+  return true;
+}
+// NOLINTEND
+
+RedpathParser::RedpathParser(std::vector<redfish::filter_ast::path>&& redpaths,
+                             MatchCallback&& on_match)
+    : p_(boost::json::parse_options(), std::move(redpaths),
+         std::move(on_match)) {}
+
+RedpathParser::~RedpathParser() = default;
+
+std::size_t RedpathParser::Write(char const* data, std::size_t size,
+                                 boost::system::error_code& ec) {
+  auto const n = p_.write_some(true, data, size, ec);
+  if (!ec && n < size) {
+    ec = boost::json::error::extra_data;
+  }
+  return n;
+}
+
+void RedpathParser::Finish(boost::system::error_code& ec) {
+  p_.write_some(false, nullptr, 0, ec);
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <boost/json/basic_parser.hpp>
+#include <boost/system/error_code.hpp>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "path_parser_ast.hpp"
+#include "redpath_matcher.hpp"
+
+struct RedpathMatch {
+  // Index of the matching redpath in the list the parser was built with
+  uint32_t redpath;
+  // If set, value is the URI of a resource that the rest of the redpath has
+  // to be resolved against.  Otherwise value is the result of the redpath.
+  std::optional<redfish::filter_ast::path> remaining;
+  std::string value;
+};
+
+// Called for every value that matches a redpath, as soon as the parser sees
+// it
+using MatchCallback = std::function<void(RedpathMatch&&)>;
+
+// SAX style parser that finds the values matching a set of redpaths in a
+// Redfish resource, without building a DOM.
+class RedpathParser {
+  // Handler methods don't follow the naming convention.
+  // NOLINTBEGIN
+  struct Handler {
+    Handler(std::vector<redfish::filter_ast::path>&& redpaths_in,
+            MatchCallback&& on_match_in);
+
+    std::vector<redfish::filter_ast::path> redpaths;
+    redfish::RedpathMatcher matcher;
+    MatchCallback on_match;
+
+    struct Frame {
+      redfish::RedpathMatcher::State state;
+      // Size of key_buffer when this object or array was opened
+      std::size_t key_offset;
+      bool is_array;
+      // Keys seen in this object that aren't annotations
+      uint32_t properties;
+    };
+    // The matcher state of each open object or array
+    std::vector<Frame> frames;
+    // The matcher state of the value currently being parsed
+    redfish::RedpathMatcher::State value_state = redfish::RedpathMatcher::kRoot;
+
+    // "/"-separated path of the current value, reused across values.  Only
+    // maintained outside of skipped subtrees.
+    std::string key_buffer;
+    std::size_t key_start = 0;
+    bool in_key = false;
+
+    // Number of objects/arrays deep into a subtree that no redpath can match.
+    // While non-zero, every event is ignored until the subtree closes.
+    std::size_t skip_depth = 0;
+
+    // Only filled in for values that match a redpath
+    std::string current_value;
+
+    // An @odata.id that matched a redpath.  Whether it's a link to follow
+    // isn't known until its object closes; an object with any properties
+    // besides annotations has already been expanded inline.
+    struct PendingLink {
+      std::size_t depth;
+      redfish::RedpathMatcher::State state;
+      std::string uri;
+    };
+    std::vector<PendingLink> pending_links;
+    constexpr static std::size_t max_object_size = std::size_t(-1);
+    constexpr static std::size_t max_array_size = std::size_t(-1);
+    constexpr static std::size_t max_key_size = std::size_t(-1);
+    constexpr static std::size_t max_string_size = std::size_t(-1);
+
+    std::string_view current_key() const { return key_buffer; }
+    bool begin_container(bool is_array);
+    bool end_container();
+    void end_value();
+    void on_scalar(std::string_view value);
+    void follow_links(const PendingLink& link);
+
+    static bool on_document_begin(std::error_code& /*unused*/) { return true; }
+    static bool on_document_end(std::error_code& /*unused*/) { return true; }
+    bool on_object_begin(std::error_code& ec);
+    bool on_object_end(std::size_t size, std::error_code& ec);
+    bool on_array_begin(std::error_code& ec);
+    bool on_array_end(std::size_t size, std::error_code& ec);
+    bool on_key_part(std::string_view key, std::size_t key_size,
+                     std::error_code& ec);
+    bool on_key(std::string_view key, std::size_t key_size,
+                std::error_code& ec);
+    bool on_string_part(std::string_view str, std::size_t str_size,
+                        std::error_code& ec);
+    bool on_string(std::string_view str, std::size_t str_size,
+                   std::error_code& ec);
+    bool on_bool(bool value, std::error_code& ec);
+    static bool on_number_part(std::string_view /*unused*/,
+                               std::error_code& /*unused*/) {
+      return true;
+    }
+    bool on_int64(std::int64_t value, std::string_view str,
+                  std::error_code& ec);
+    bool on_uint64(std::uint64_t value, std::string_view str,
+                   std::error_code& ec);
+    bool on_double(double value, std::string_view str, std::error_code& ec);
+    bool on_null(std::error_code& ec);
+    static bool on_comment_part(std::string_view /*unused*/,
+                                std::error_code& /*unused*/) {
+      return false;
+    }
+    static bool on_comment(std::string_view /*unused*/,
+                           std::error_code& /*unused*/) {
+      return false;
+    }
+    // NOLINTEND
+  };
+
+  boost::json::basic_parser<Handler> p_;
+
+ public:
+  RedpathParser(std::vector<redfish::filter_ast::path>&& redpaths,
+                MatchCallback&& on_match);
+  ~RedpathParser();
+
+  RedpathParser(const RedpathParser&) = delete;
+  RedpathParser(RedpathParser&&) = delete;
+  RedpathParser& operator=(const RedpathParser&) = delete;
+  RedpathParser& operator=(RedpathParser&&) = delete;
+
+  // Feeds the next piece of the document to the parser.  Matches are
+  // reported through the callback before this returns.
+  std::size_t Write(char const* data, std::size_t size,
+                    boost::system::error_code& ec);
+
+  // Signals the end of the document
+  void Finish(boost::system::error_code& ec);
+};
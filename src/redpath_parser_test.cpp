@@ -0,0 +1,115 @@
+#include "redpath_parser.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "path_parser.hpp"
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+namespace {
+// Returns each match as "redpath=value" for results, or
+// "redpath -> remaining @ uri" for links that need to be followed
+std::vector<std::string> ParseAll(const std::vector<std::string>& redpaths,
+                                  const std::vector<std::string_view>& chunks) {
+  std::vector<redfish::filter_ast::path> paths;
+  for (const std::string& redpath : redpaths) {
+    paths.push_back(*parseRedfishPath(redpath));
+  }
+  std::vector<std::string> matches;
+  RedpathParser parser(std::move(paths), [&matches,
+                                          &redpaths](RedpathMatch&& match) {
+    if (match.remaining) {
+      matches.push_back(redpaths[match.redpath] + " -> " +
+                        match.remaining->to_path_string() + " @ " +
+                        match.value);
+    } else {
+      matches.push_back(redpaths[match.redpath] + "=" + match.value);
+    }
+  });
+  boost::system::error_code ec;
+  for (std::string_view chunk : chunks) {
+    parser.Write(chunk.data(), chunk.size(), ec);
+    EXPECT_FALSE(ec);
+  }
+  parser.Finish(ec);
+  EXPECT_FALSE(ec);
+  return matches;
+}
+}  // namespace
+
+TEST(RedpathParser, MatchesLink) {
+  EXPECT_THAT(
+      ParseAll({"Chassis[*]/Sensors", "Systems"},
+               {R"({"Chassis": {"@odata.id": "/redfish/v1/Chassis"},)"
+                R"("Systems": {"@odata.id": "/redfish/v1/Systems"}})"}),
+      ElementsAre(
+          "Chassis[*]/Sensors -> Members[*]/Sensors @ /redfish/v1/Chassis",
+          "Systems=/redfish/v1/Systems"));
+}
+
+TEST(RedpathParser, MatchesEveryArrayMember) {
+  EXPECT_THAT(
+      ParseAll({"Members[*]/Sensors"},
+               {R"({"Members": [{"@odata.id": "/redfish/v1/Chassis/1"},)"
+                R"({"@odata.id": "/redfish/v1/Chassis/2"}]})"}),
+      ElementsAre("Members[*]/Sensors -> Sensors @ /redfish/v1/Chassis/1",
+                  "Members[*]/Sensors -> Sensors @ /redfish/v1/Chassis/2"));
+}
+
+TEST(RedpathParser, MatchesScalarValues) {
+  EXPECT_THAT(ParseAll({"Name", "Reading", "Enabled", "Missing"},
+                       {R"({"Name": "Chassis 1", "Reading": 42,)"
+                        R"("Enabled": false})"}),
+              ElementsAre("Name=Chassis 1", "Reading=42", "Enabled=false"));
+}
+
+TEST(RedpathParser, MatchesExpandedCollection) {
+  EXPECT_THAT(
+      ParseAll({"Members[*]/Sensors", "Members[*]/Name"},
+               {R"({"Members": [)"
+                R"({"@odata.id": "/redfish/v1/Chassis/1", "Name": "One",)"
+                R"("Sensors": {"@odata.id": "/redfish/v1/Chassis/1/Sensors"}},)"
+                R"({"@odata.id": "/redfish/v1/Chassis/2", "Name": "Two",)"
+                R"("Sensors": {"@odata.id": "/redfish/v1/Chassis/2/Sensors"}})"
+                R"(]})"}),
+      ElementsAre("Members[*]/Name=One",
+                  "Members[*]/Sensors=/redfish/v1/Chassis/1/Sensors",
+                  "Members[*]/Name=Two",
+                  "Members[*]/Sensors=/redfish/v1/Chassis/2/Sensors"));
+}
+
+TEST(RedpathParser, MatchesExpandedLinkedCollection) {
+  EXPECT_THAT(
+      ParseAll({"Sensors[*]/Reading"},
+               {R"({"Sensors": {"@odata.id": "/redfish/v1/Chassis/1/Sensors",)"
+                R"("Members": [{"@odata.id": "/redfish/v1/Chassis/1/Sensors/t",)"
+                R"("Reading": 21.5}]}})"}),
+      ElementsAre("Sensors[*]/Reading=21.5"));
+}
+
+TEST(RedpathParser, IgnoresNestedKeysWithSameName) {
+  EXPECT_THAT(
+      ParseAll({"Chassis"},
+               {R"({"Links": {"Chassis": {"@odata.id": "/redfish/v1/C"}}})"}),
+      IsEmpty());
+}
+
+TEST(RedpathParser, MatchesAcrossChunks) {
+  EXPECT_THAT(ParseAll({"Chassis"},
+                       {R"({"Cha)", R"(ssis": {"@odata)",
+                        R"(.id": "/redfish/v1/Ch)", R"(assis"}})"}),
+              ElementsAre("Chassis=/redfish/v1/Chassis"));
+}
+
+TEST(RedpathParser, ResumesMatchingAfterSkippedSubtree) {
+  EXPECT_THAT(
+      ParseAll({"Systems"},
+               {R"({"Oem": {"A": [{"Systems": {"@odata.id": "/bad"}}, [1, 2]],)"
+                R"("B": {"C": null}},)"
+                R"("Systems": {"@odata.id": "/redfish/v1/Systems"}})"}),
+      ElementsAre("Systems=/redfish/v1/Systems"));
+}
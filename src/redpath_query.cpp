@@ -0,0 +1,408 @@
+#include "redpath_query.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <boost/json.hpp>
+#include <format>
+
+#include "boost_formatter.hpp"
+
+namespace {
+bool IsJsonContentType(std::string_view ct) {
+  return ct == "application/json" || ct == "application/json; charset=utf-8";
+}
+
+bool GetBool(const boost::json::object& obj, std::string_view key) {
+  const boost::json::value* value = obj.if_contains(key);
+  return value != nullptr && value->is_bool() && value->get_bool();
+}
+
+void AppendQuery(std::string& uri, std::string_view query) {
+  uri += uri.find('?') == std::string::npos ? '?' : '&';
+  uri += query;
+}
+
+// Draws the time since start spent parsing a response on its request's
+// lane, if it's being traced
+void TraceParse(http::Tracer* tracer, uint64_t lane,
+                http::Tracer::Clock::time_point start) {
+  if (tracer != nullptr && lane != 0) {
+    tracer->Span(lane, "parse", "parse", start, http::Tracer::Clock::now());
+  }
+}
+
+// True if status is how services turn down query parameters they don't
+// support: a resource that's missing, or a host that's struggling, fails the
+// same way without them
+bool IsQueryRejected(boost::beast::http::status status) {
+  return status == boost::beast::http::status::bad_request ||
+         status == boost::beast::http::status::method_not_allowed ||
+         status == boost::beast::http::status::not_implemented;
+}
+
+// True if redpath starts by iterating a collection's members
+bool IsMembersFetch(const redfish::filter_ast::path& path) {
+  const redfish::filter_ast::key_filter* filter =
+      std::get_if<redfish::filter_ast::key_filter>(&path.first);
+  return filter != nullptr && filter->key == "Members";
+}
+
+// True if every redpath starts by iterating a collection's members
+bool IsCollectionFetch(const std::vector<redfish::filter_ast::path>& paths) {
+  return !paths.empty() && std::all_of(paths.begin(), paths.end(),
+                                       IsMembersFetch);
+}
+}  // namespace
+
+ProtocolFeatures ParseProtocolFeatures(std::string_view service_root) {
+  ProtocolFeatures features;
+  boost::system::error_code ec;
+  boost::json::value root = boost::json::parse(service_root, ec);
+  if (ec || !root.is_object()) {
+    return features;
+  }
+  const boost::json::value* supported =
+      root.get_object().if_contains("ProtocolFeaturesSupported");
+  if (supported == nullptr || !supported->is_object()) {
+    return features;
+  }
+  const boost::json::value* expand =
+      supported->get_object().if_contains("ExpandQuery");
+  if (expand != nullptr && expand->is_object()) {
+    const boost::json::object& expand_obj = expand->get_object();
+    features.expand_all = GetBool(expand_obj, "ExpandAll");
+    features.expand_levels = GetBool(expand_obj, "Levels");
+    features.expand_no_links = GetBool(expand_obj, "NoLinks");
+    const boost::json::value* max_levels = expand_obj.if_contains("MaxLevels");
+    if (max_levels != nullptr && max_levels->is_int64()) {
+      features.expand_max_levels = max_levels->get_int64();
+    }
+  }
+  features.select = GetBool(supported->get_object(), "SelectQuery");
+  return features;
+}
+
+std::string ExpandQuery(const ProtocolFeatures& features, int64_t levels) {
+  if (levels <= 0) {
+    return "";
+  }
+  // Prefer expanding only subordinate resources; expanding Links as well
+  // pulls in resources the redpath never asked for
+  std::string_view type;
+  if (features.expand_no_links) {
+    type = ".";
+  } else if (features.expand_all) {
+    type = "*";
+  } else {
+    return "";
+  }
+  if (!features.expand_levels) {
+    // Services that don't take $levels expand a single level
+    return std::format("$expand={}", type);
+  }
+  if (features.expand_max_levels > 0) {
+    levels = std::min(levels, features.expand_max_levels);
+  }
+  return std::format("$expand={}($levels={})", type, levels);
+}
+
+std::string SelectQuery(
+    const std::vector<redfish::filter_ast::path>& redpaths) {
+  std::vector<std::string_view> properties;
+  for (const redfish::filter_ast::path& redpath : redpaths) {
+    if (const redfish::filter_ast::key_filter* filter =
+            std::get_if<redfish::filter_ast::key_filter>(&redpath.first)) {
+      properties.emplace_back(filter->key);
+    } else {
+      properties.emplace_back(
+          std::get<redfish::filter_ast::key_name>(redpath.first).str());
+    }
+  }
+  if (properties.empty()) {
+    return "";
+  }
+  std::sort(properties.begin(), properties.end());
+  properties.erase(std::unique(properties.begin(), properties.end()),
+                   properties.end());
+  std::string query = "$select=";
+  for (std::string_view property : properties) {
+    if (property != properties.front()) {
+      query += ',';
+    }
+    query += property;
+  }
+  return query;
+}
+
+RedpathQuery::RedpathQuery(const std::shared_ptr<http::Client>& client,
+                           HostConnectData host,
+                           std::vector<redfish::filter_ast::path>&& redpaths,
+                           const RedpathQueryOptions& options,
+                           ResultCallback&& on_result)
+    : client_(client),
+      host_(std::move(host)),
+      options_(options),
+      redpaths_(std::move(redpaths)),
+      onResult_(std::move(on_result)) {
+  for (const redfish::filter_ast::path& redpath : redpaths_) {
+    names_.push_back(redpath.to_path_string());
+  }
+}
+
+// Authentication is added by the client, from the session it holds for the
+// host (see http::Client::Authenticate)
+boost::beast::http::fields RedpathQuery::RequestHeaders() {
+  boost::beast::http::fields headers;
+  headers.set(boost::beast::http::field::accept, "application/json");
+  return headers;
+}
+
+uint64_t RedpathQuery::AcquireLane() const {
+  const std::shared_ptr<http::Tracer>& tracer = client_->GetTracer();
+  if (tracer == nullptr) {
+    return 0;
+  }
+  return tracer->AcquireLane(std::format("{} request", host_.host));
+}
+
+void RedpathQuery::EndSpan(uint64_t lane, std::string_view uri,
+                           http::Tracer::Clock::time_point started_at,
+                           const http::Response& res) const {
+  const std::shared_ptr<http::Tracer>& tracer = client_->GetTracer();
+  if (tracer == nullptr || lane == 0) {
+    return;
+  }
+  tracer->Span(lane, "request", std::format("GET {}", uri), started_at,
+               http::Tracer::Clock::now(),
+               res.Result() == boost::beast::http::status::unknown
+                   ? std::string("failed")
+                   : std::to_string(static_cast<int>(res.Result())));
+  tracer->ReleaseLane(lane);
+}
+
+void RedpathQuery::Start(DoneCallback&& on_done) {
+  onDone_ = std::move(on_done);
+  status_.requests++;
+  outstanding_++;
+  rootLane_ = AcquireLane();
+  startedAt_ = http::Tracer::Clock::now();
+  http::Tracer::LaneScope scope(client_->GetTracer().get(), rootLane_);
+  // The service root is small, and what it supports decides how everything
+  // else is fetched, so it's read in full rather than streamed
+  client_->SendData(
+      std::string(), host_.host, host_.port, "/redfish/v1", RequestHeaders(),
+      boost::beast::http::verb::get,
+      std::bind_front(&RedpathQuery::OnServiceRoot, shared_from_this()));
+}
+
+void RedpathQuery::RequestDone(bool succeeded) {
+  if (!succeeded) {
+    status_.failed_requests++;
+  }
+  outstanding_--;
+  if (outstanding_ == 0 && onDone_) {
+    DoneCallback on_done = std::move(onDone_);
+    onDone_ = nullptr;
+    on_done(status_);
+  }
+}
+
+void RedpathQuery::OnServiceRoot(http::Response&& res) {
+  bool succeeded = ReadServiceRoot(res);
+  EndSpan(rootLane_, "/redfish/v1", startedAt_, res);
+  RequestDone(succeeded);
+}
+
+bool RedpathQuery::ReadServiceRoot(http::Response& res) {
+  if (res.Result() != boost::beast::http::status::ok ||
+      !IsJsonContentType(
+          res.GetHeader(boost::beast::http::field::content_type))) {
+    SPDLOG_ERROR("Failed to read service root from {}: {}", host_.host,
+                 static_cast<int>(res.Result()));
+    return false;
+  }
+  features_ = ParseProtocolFeatures(res.Body());
+  SPDLOG_DEBUG("{} supports $expand: {}", host_.host,
+               !ExpandQuery(features_, 1).empty());
+
+  std::vector<uint32_t> origins(redpaths_.size());
+  for (uint32_t index = 0; index < origins.size(); index++) {
+    origins[index] = index;
+  }
+  std::vector<redfish::filter_ast::path> redpaths = redpaths_;
+  RedpathParser parser(std::move(redpaths),
+                       std::bind_front(&RedpathQuery::OnMatch,
+                                       shared_from_this(), rootLane_, origins));
+  http::Tracer::Clock::time_point parse_start = http::Tracer::Clock::now();
+  boost::system::error_code ec;
+  parser.Write(res.Body().data(), res.Body().size(), ec);
+  if (!ec) {
+    parser.Finish(ec);
+  }
+  TraceParse(client_->GetTracer().get(), rootLane_, parse_start);
+  SendFollowUps();
+  if (ec) {
+    SPDLOG_ERROR("Failed to parse service root {}", ec);
+    return false;
+  }
+  return true;
+}
+
+void RedpathQuery::Get(std::string uri,
+                       std::vector<redfish::filter_ast::path>&& redpaths,
+                       std::vector<uint32_t>&& origins, bool allow_query,
+                       uint64_t caused_by) {
+  std::vector<redfish::filter_ast::path> unoptimized;
+  bool collection = IsCollectionFetch(redpaths);
+  bool expanded = false;
+  if (allow_query) {
+    std::string query;
+    if (collection) {
+      query = ExpandQuery(features_, options_.expand_levels);
+      expanded = !query.empty();
+    }
+    // $select applies to the expanded members as well as the collection,
+    // so it's only used when nothing is expanded
+    if (query.empty() && options_.select && features_.select) {
+      query = SelectQuery(redpaths);
+    }
+    if (!query.empty()) {
+      unoptimized = redpaths;
+      AppendQuery(uri, query);
+    }
+  }
+
+  if (collection && !expanded) {
+    // Every member is fetched on its own once the collection's read, so the
+    // connections for them are opened while it is
+    client_->Warm(host_.host, host_.port, http::kMaxPoolSize);
+  }
+
+  status_.requests++;
+  outstanding_++;
+  uint64_t lane = AcquireLane();
+  auto request = std::make_shared<Request>(
+      std::move(redpaths), std::bind_front(&RedpathQuery::OnMatch,
+                                           shared_from_this(), lane, origins));
+  request->origins = std::move(origins);
+  request->unoptimized = std::move(unoptimized);
+  request->uri = uri;
+  request->tracer = client_->GetTracer();
+  request->lane = lane;
+  if (request->tracer != nullptr) {
+    request->started_at = http::Tracer::Clock::now();
+    // From the response the link was found in
+    request->tracer->Flow(caused_by, lane, request->started_at);
+  }
+
+  http::Tracer::LaneScope scope(request->tracer.get(), lane);
+  client_->SendData(
+      std::string(), host_.host, host_.port, uri, RequestHeaders(),
+      boost::beast::http::verb::get,
+      std::bind_front(&RedpathQuery::HandleResponse, shared_from_this(),
+                      request),
+      std::bind_front(&RedpathQuery::StreamResponse, shared_from_this(),
+                      request));
+}
+
+void RedpathQuery::OnMatch(uint64_t lane, const std::vector<uint32_t>& origins,
+                           RedpathMatch&& match) {
+  uint32_t origin = origins[match.redpath];
+  if (!match.remaining) {
+    onResult_(names_[origin], match.value);
+    return;
+  }
+  SPDLOG_DEBUG("Resolving {} at {}", match.remaining->to_path_string(),
+               match.value);
+  auto [index, inserted] = followUpIndex_.try_emplace(
+      std::make_pair(match.value, IsMembersFetch(*match.remaining)),
+      followUps_.size());
+  if (inserted) {
+    followUps_.push_back(
+        FollowUp{.uri = std::move(match.value), .caused_by = lane});
+  }
+  FollowUp& follow_up = followUps_[index->second];
+  follow_up.redpaths.push_back(std::move(*match.remaining));
+  follow_up.origins.push_back(origin);
+}
+
+void RedpathQuery::SendFollowUps() {
+  // Taken first, so that any found while these are sent start a batch of
+  // their own
+  std::vector<FollowUp> follow_ups = std::move(followUps_);
+  followUps_.clear();
+  followUpIndex_.clear();
+  for (FollowUp& follow_up : follow_ups) {
+    Get(std::move(follow_up.uri), std::move(follow_up.redpaths),
+        std::move(follow_up.origins), true, follow_up.caused_by);
+  }
+}
+
+// Feeds body chunks into the parser as they arrive, so that follow up
+// requests go out before the rest of the response has been read
+void RedpathQuery::StreamResponse(const std::shared_ptr<Request>& request,
+                                  const http::ResponseHeader& header,
+                                  std::string_view chunk,
+                                  boost::system::error_code& /*ec*/) {
+  if (request->ec) {
+    return;
+  }
+  if (header.result() != boost::beast::http::status::ok ||
+      !IsJsonContentType(header[boost::beast::http::field::content_type])) {
+    return;
+  }
+  http::Tracer::Clock::time_point parse_start;
+  if (request->tracer != nullptr) {
+    parse_start = http::Tracer::Clock::now();
+  }
+  request->parser.Write(chunk.data(), chunk.size(), request->ec);
+  TraceParse(request->tracer.get(), request->lane, parse_start);
+  SendFollowUps();
+  if (request->ec) {
+    SPDLOG_DEBUG("Failed to parse response {}", request->ec);
+  }
+}
+
+void RedpathQuery::HandleResponse(const std::shared_ptr<Request>& request,
+                                  http::Response&& res) {
+  bool succeeded = ReadResponse(request, res);
+  EndSpan(request->lane, request->uri, request->started_at, res);
+  RequestDone(succeeded);
+}
+
+bool RedpathQuery::ReadResponse(const std::shared_ptr<Request>& request,
+                                http::Response& res) {
+  SPDLOG_DEBUG("Got response {} for {}", static_cast<int>(res.Result()),
+               request->uri);
+  if (res.Result() != boost::beast::http::status::ok) {
+    if (!request->unoptimized.empty() && IsQueryRejected(res.Result())) {
+      // Some services advertise $expand or $select but reject them for some
+      // resources.  Fall back to fetching the whole resource.
+      SPDLOG_DEBUG("Retrying {} without query parameters", request->uri);
+      std::string uri = request->uri.substr(0, request->uri.find('?'));
+      Get(std::move(uri), std::move(request->unoptimized),
+          std::move(request->origins), false, request->lane);
+      // The retry is counted on its own
+      return true;
+    }
+    return false;
+  }
+  if (request->ec ||
+      !IsJsonContentType(
+          res.GetHeader(boost::beast::http::field::content_type))) {
+    return false;
+  }
+  http::Tracer::Clock::time_point parse_start;
+  if (request->tracer != nullptr) {
+    parse_start = http::Tracer::Clock::now();
+  }
+  request->parser.Finish(request->ec);
+  TraceParse(request->tracer.get(), request->lane, parse_start);
+  SendFollowUps();
+  if (request->ec) {
+    SPDLOG_DEBUG("Response was incomplete {}", request->ec);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <boost/asio/async_result.hpp>
+#include <boost/system/error_code.hpp>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "async_handler.hpp"
+#include "http_client.hpp"
+#include "path_parser_ast.hpp"
+#include "redpath_parser.hpp"
+
+struct HostConnectData {
+  std::string host;
+  uint16_t port = 443;
+  std::string username;
+  std::string password;
+  // Keep session tokens in a cache file between runs
+  bool session_cache = true;
+};
+
+// The query parameters a service advertises support for in
+// ProtocolFeaturesSupported on its service root
+struct ProtocolFeatures {
+  bool expand_all = false;
+  bool expand_levels = false;
+  bool expand_no_links = false;
+  int64_t expand_max_levels = 0;
+  bool select = false;
+};
+
+ProtocolFeatures ParseProtocolFeatures(std::string_view service_root);
+
+// Returns the $expand query parameter to fetch a collection with its members
+// inline, or an empty string if the service can't do that
+std::string ExpandQuery(const ProtocolFeatures& features, int64_t levels);
+
+// Returns the $select query parameter that limits a resource to the
+// properties the first component of each redpath needs
+std::string SelectQuery(const std::vector<redfish::filter_ast::path>& redpaths);
+
+struct RedpathQueryOptions {
+  // Levels of links the service is asked to expand inline when fetching a
+  // collection.  0 disables $expand.
+  int64_t expand_levels = 1;
+  // Ask the service for only the properties a redpath needs, if it supports
+  // $select
+  bool select = true;
+};
+
+// Called with each value a redpath resolves to.  redpath is the redpath as
+// given to the query.
+using ResultCallback =
+    std::function<void(std::string_view redpath, std::string_view value)>;
+
+struct QueryStatus {
+  uint64_t requests = 0;
+  // Requests that failed outright, or whose response couldn't be parsed
+  uint64_t failed_requests = 0;
+};
+
+// Called once every request a query made has completed
+using DoneCallback = std::function<void(const QueryStatus& status)>;
+
+// Resolves a set of redpaths against a single host, starting from the service
+// root and following links as far as each redpath requires.
+class RedpathQuery : public std::enable_shared_from_this<RedpathQuery> {
+ private:
+  // State for a single GET issued on behalf of the query
+  struct Request {
+    Request(std::vector<redfish::filter_ast::path>&& redpaths,
+            MatchCallback&& on_match)
+        : parser(std::move(redpaths), std::move(on_match)) {}
+
+    RedpathParser parser;
+    // For each redpath given to the parser, the index of the query redpath
+    // it was derived from
+    std::vector<uint32_t> origins;
+    // Kept so the request can be retried without $expand or $select
+    std::vector<redfish::filter_ast::path> unoptimized;
+    std::string uri;
+    boost::system::error_code ec;
+    // Set if the query's being traced (see http::Client::SetTracer)
+    std::shared_ptr<http::Tracer> tracer;
+    uint64_t lane = 0;
+    http::Tracer::Clock::time_point started_at;
+  };
+
+  std::shared_ptr<http::Client> client_;
+  HostConnectData host_;
+  RedpathQueryOptions options_;
+  std::vector<redfish::filter_ast::path> redpaths_;
+  std::vector<std::string> names_;
+  ResultCallback onResult_;
+  DoneCallback onDone_;
+  ProtocolFeatures features_;
+  QueryStatus status_;
+  // Requests sent that haven't completed yet
+  std::size_t outstanding_ = 0;
+  // The service root's lane, if the query's being traced
+  uint64_t rootLane_ = 0;
+  http::Tracer::Clock::time_point startedAt_;
+
+  // A link found in the response being parsed, and the redpaths to resolve
+  // at it
+  struct FollowUp {
+    std::string uri;
+    std::vector<redfish::filter_ast::path> redpaths;
+    std::vector<uint32_t> origins;
+    uint64_t caused_by = 0;
+  };
+  // Held until the chunk they were found in has been parsed, so that
+  // redpaths needing the same resource share one request, and one $select.
+  // Indexed by uri, and whether the redpaths are fetching a collection's
+  // members, which are expanded rather than selected.
+  std::vector<FollowUp> followUps_;
+  std::map<std::pair<std::string, bool>, std::size_t> followUpIndex_;
+
+  // caused_by is the lane of the request whose response linked to uri
+  void Get(std::string uri, std::vector<redfish::filter_ast::path>&& redpaths,
+           std::vector<uint32_t>&& origins, bool allow_query,
+           uint64_t caused_by);
+
+  // A lane to draw a request on, or 0 if the query isn't being traced
+  uint64_t AcquireLane() const;
+
+  // Draws a request to uri that got res on its lane, and frees the lane
+  void EndSpan(uint64_t lane, std::string_view uri,
+               http::Tracer::Clock::time_point started_at,
+               const http::Response& res) const;
+
+  void RequestDone(bool succeeded);
+
+  void OnServiceRoot(http::Response&& res);
+
+  bool ReadServiceRoot(http::Response& res);
+
+  // lane is the lane of the request the match was found in
+  void OnMatch(uint64_t lane, const std::vector<uint32_t>& origins,
+               RedpathMatch&& match);
+
+  // Sends a request for each resource linked to in what's been parsed
+  void SendFollowUps();
+
+  void StreamResponse(const std::shared_ptr<Request>& request,
+                      const http::ResponseHeader& header,
+                      std::string_view chunk, boost::system::error_code& ec);
+
+  void HandleResponse(const std::shared_ptr<Request>& request,
+                      http::Response&& res);
+
+  bool ReadResponse(const std::shared_ptr<Request>& request,
+                    http::Response& res);
+
+  static boost::beast::http::fields RequestHeaders();
+
+ public:
+  RedpathQuery(const std::shared_ptr<http::Client>& client,
+               HostConnectData host,
+               std::vector<redfish::filter_ast::path>&& redpaths,
+               const RedpathQueryOptions& options, ResultCallback&& on_result);
+
+  // Starts resolving the redpaths.  Results are reported as the responses
+  // they're found in arrive, and on_done is called once there's nothing left
+  // to fetch.
+  void Start(DoneCallback&& on_done = nullptr);
+
+  // Start for any asio completion token, completing with the QueryStatus
+  // once there's nothing left to fetch.  For example, from a coroutine:
+  //   QueryStatus status = co_await query->AsyncRun(use_awaitable);
+  template <typename CompletionToken>
+  auto AsyncRun(CompletionToken&& token) {
+    return boost::asio::async_initiate<CompletionToken, void(QueryStatus)>(
+        [self = shared_from_this()](auto handler) {
+          self->Start(http::BindHandler<QueryStatus>(
+              std::move(handler), self->client_->GetExecutor()));
+        },
+        token);
+  }
+
+  const HostConnectData& Host() const { return host_; }
+
+  const ProtocolFeatures& Features() const { return features_; }
+};
@@ -0,0 +1,60 @@
+#include "redpath_query.hpp"
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "path_parser.hpp"
+
+TEST(ProtocolFeatures, ParsesExpandQuery) {
+  ProtocolFeatures features = ParseProtocolFeatures(
+      R"({"ProtocolFeaturesSupported": {"ExpandQuery": {"ExpandAll": true,)"
+      R"("Levels": true, "Links": true, "NoLinks": true, "MaxLevels": 6}}})");
+  EXPECT_TRUE(features.expand_all);
+  EXPECT_TRUE(features.expand_levels);
+  EXPECT_TRUE(features.expand_no_links);
+  EXPECT_EQ(features.expand_max_levels, 6);
+}
+
+TEST(ProtocolFeatures, MissingFeaturesAreUnsupported) {
+  ProtocolFeatures features = ParseProtocolFeatures(R"({"Name": "Root"})");
+  EXPECT_FALSE(features.expand_all);
+  EXPECT_FALSE(features.expand_no_links);
+  EXPECT_EQ(ExpandQuery(features, 1), "");
+
+  features = ParseProtocolFeatures("not json");
+  EXPECT_EQ(ExpandQuery(features, 1), "");
+}
+
+TEST(ProtocolFeatures, ExpandQuery) {
+  ProtocolFeatures features{.expand_all = true,
+                            .expand_levels = true,
+                            .expand_no_links = true,
+                            .expand_max_levels = 2};
+  EXPECT_EQ(ExpandQuery(features, 1), "$expand=.($levels=1)");
+  EXPECT_EQ(ExpandQuery(features, 3), "$expand=.($levels=2)");
+  EXPECT_EQ(ExpandQuery(features, 0), "");
+
+  features.expand_no_links = false;
+  features.expand_levels = false;
+  EXPECT_EQ(ExpandQuery(features, 3), "$expand=*");
+}
+
+TEST(ProtocolFeatures, ParsesSelectQuery) {
+  EXPECT_TRUE(ParseProtocolFeatures(
+                  R"({"ProtocolFeaturesSupported": {"SelectQuery": true}})")
+                  .select);
+  EXPECT_FALSE(ParseProtocolFeatures(
+                   R"({"ProtocolFeaturesSupported": {"SelectQuery": false}})")
+                   .select);
+}
+
+TEST(SelectQuery, SelectsFirstComponentOfEachRedpath) {
+  std::vector<redfish::filter_ast::path> redpaths;
+  redpaths.push_back(*parseRedfishPath("Status/Health"));
+  redpaths.push_back(*parseRedfishPath("Reading"));
+  redpaths.push_back(*parseRedfishPath("Status/State"));
+  redpaths.push_back(*parseRedfishPath("Sensors[*]/Reading"));
+  EXPECT_EQ(SelectQuery(redpaths), "$select=Reading,Sensors,Status");
+
+  EXPECT_EQ(SelectQuery({}), "");
+}
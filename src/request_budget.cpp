@@ -0,0 +1,74 @@
+#include "request_budget.hpp"
+
+#include <algorithm>
+#include <boost/asio/post.hpp>
+#include <utility>
+
+namespace http {
+
+RequestBudget::Slot::~Slot() {
+  std::shared_ptr<RequestBudget> budget = budget_.lock();
+  if (budget != nullptr) {
+    budget->Release();
+  }
+}
+
+RequestBudget::RequestBudget(boost::asio::io_context& ioc_in,
+                             std::size_t limit, std::size_t max_waiting)
+    : ioc_(ioc_in), limit_(std::max<std::size_t>(limit, 1)),
+      maxWaiting_(max_waiting) {}
+
+bool RequestBudget::Acquire(StartCallback&& start) {
+  if (inFlight_ < limit_ && waiting_.empty()) {
+    inFlight_++;
+    start(std::make_shared<Slot>(weak_from_this()));
+    return true;
+  }
+  if (maxWaiting_ != 0 && waiting_.size() >= maxWaiting_) {
+    return false;
+  }
+  waiting_.emplace_back(std::move(start));
+  return true;
+}
+
+void RequestBudget::WhenRoom(std::function<void()>&& callback) {
+  if (HasRoom() && roomWaiters_.empty()) {
+    callback();
+    return;
+  }
+  roomWaiters_.emplace_back(std::move(callback));
+}
+
+void RequestBudget::Release() {
+  inFlight_--;
+  // Slots are released from wherever a request's callback is destroyed,
+  // which can be in the middle of tearing down a host's connections, so the
+  // next requests are started once that's unwound
+  if (admitPosted_ || (waiting_.empty() && roomWaiters_.empty())) {
+    return;
+  }
+  admitPosted_ = true;
+  boost::asio::post(ioc_, [weak_self = weak_from_this()]() {
+    std::shared_ptr<RequestBudget> self = weak_self.lock();
+    if (self != nullptr) {
+      self->Admit();
+    }
+  });
+}
+
+void RequestBudget::Admit() {
+  admitPosted_ = false;
+  while (inFlight_ < limit_ && !waiting_.empty()) {
+    StartCallback start = std::move(waiting_.front());
+    waiting_.pop_front();
+    inFlight_++;
+    start(std::make_shared<Slot>(weak_from_this()));
+  }
+  while (HasRoom() && !roomWaiters_.empty()) {
+    std::function<void()> callback = std::move(roomWaiters_.front());
+    roomWaiters_.pop_front();
+    callback();
+  }
+}
+
+}  // namespace http
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace http {
+
+// Caps the requests a Client has outstanding across every host, so that the
+// memory held by queued requests and their responses stays bounded however
+// many hosts are being queried.  Requests over the limit wait their turn
+// rather than being dropped, and producers that can hold off making more
+// requests can wait for room with WhenRoom.
+class RequestBudget : public std::enable_shared_from_this<RequestBudget> {
+ public:
+  // One request's share of the budget, given back when the last copy is
+  // destroyed.  Holding it in the request's callback means it's given back
+  // however the request ends, including being dropped with its host.
+  class Slot {
+   private:
+    std::weak_ptr<RequestBudget> budget_;
+
+   public:
+    explicit Slot(const std::weak_ptr<RequestBudget>& budget)
+        : budget_(budget) {}
+    Slot(const Slot&) = delete;
+    Slot& operator=(const Slot&) = delete;
+    Slot(Slot&&) = delete;
+    Slot& operator=(Slot&&) = delete;
+    ~Slot();
+  };
+
+  using StartCallback = std::function<void(const std::shared_ptr<Slot>&)>;
+
+ private:
+  boost::asio::io_context& ioc_;
+  std::size_t limit_;
+  std::size_t maxWaiting_;
+  std::size_t inFlight_ = 0;
+  std::deque<StartCallback> waiting_;
+  std::deque<std::function<void()> > roomWaiters_;
+  bool admitPosted_ = false;
+
+  void Release();
+
+  void Admit();
+
+ public:
+  // limit requests are let through at a time.  Past that, up to max_waiting
+  // wait for a slot, or any number if max_waiting is 0.
+  RequestBudget(boost::asio::io_context& ioc_in, std::size_t limit,
+                std::size_t max_waiting);
+
+  // Calls start with a slot once there's room in the budget, which may be
+  // straight away.  Returns false, without calling start, if max_waiting
+  // requests are already waiting.
+  bool Acquire(StartCallback&& start);
+
+  // Whether a request made now would go out without waiting
+  bool HasRoom() const { return inFlight_ + waiting_.size() < limit_; }
+
+  // Calls callback once HasRoom, straight away if it already does
+  void WhenRoom(std::function<void()>&& callback);
+
+  std::size_t InFlight() const { return inFlight_; }
+
+  std::size_t Waiting() const { return waiting_.size(); }
+};
+
+}  // namespace http
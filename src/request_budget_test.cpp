@@ -0,0 +1,75 @@
+#include "request_budget.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <memory>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+namespace http {
+namespace {
+
+using Slot = std::shared_ptr<RequestBudget::Slot>;
+
+TEST(RequestBudget, HoldsRequestsPastTheLimit) {
+  boost::asio::io_context ioc;
+  auto budget = std::make_shared<RequestBudget>(ioc, 2, 0);
+  std::vector<Slot> slots;
+  std::vector<int> started;
+  for (int request = 0; request < 4; request++) {
+    EXPECT_TRUE(budget->Acquire([&slots, &started, request](const Slot& slot) {
+      slots.push_back(slot);
+      started.push_back(request);
+    }));
+  }
+  EXPECT_THAT(started, testing::ElementsAre(0, 1));
+  EXPECT_EQ(budget->InFlight(), 2U);
+  EXPECT_EQ(budget->Waiting(), 2U);
+  EXPECT_FALSE(budget->HasRoom());
+
+  // Finishing a request lets the next one through, in order, once the
+  // io_context runs
+  slots.erase(slots.begin());
+  EXPECT_THAT(started, testing::ElementsAre(0, 1));
+  ioc.run();
+  EXPECT_THAT(started, testing::ElementsAre(0, 1, 2));
+  EXPECT_EQ(budget->Waiting(), 1U);
+
+  slots.clear();
+  ioc.restart();
+  ioc.run();
+  EXPECT_THAT(started, testing::ElementsAre(0, 1, 2, 3));
+  slots.clear();
+  EXPECT_EQ(budget->InFlight(), 0U);
+}
+
+TEST(RequestBudget, RejectsPastMaxWaiting) {
+  boost::asio::io_context ioc;
+  auto budget = std::make_shared<RequestBudget>(ioc, 1, 1);
+  Slot held;
+  EXPECT_TRUE(budget->Acquire([&held](const Slot& slot) { held = slot; }));
+  EXPECT_TRUE(budget->Acquire([](const Slot&) {}));
+  EXPECT_FALSE(budget->Acquire([](const Slot&) { FAIL(); }));
+}
+
+TEST(RequestBudget, SignalsRoom) {
+  boost::asio::io_context ioc;
+  auto budget = std::make_shared<RequestBudget>(ioc, 1, 0);
+  int signalled = 0;
+  budget->WhenRoom([&signalled]() { signalled++; });
+  EXPECT_EQ(signalled, 1);
+
+  Slot held;
+  budget->Acquire([&held](const Slot& slot) { held = slot; });
+  budget->WhenRoom([&signalled]() { signalled++; });
+  ioc.run();
+  EXPECT_EQ(signalled, 1);
+
+  held.reset();
+  ioc.restart();
+  ioc.run();
+  EXPECT_EQ(signalled, 2);
+}
+
+}  // namespace
+}  // namespace http
@@ -0,0 +1,111 @@
+#include "request_timings.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace http {
+
+std::size_t LatencyHistogram::Bucket(uint64_t micros) {
+  if (micros < kSubBuckets) {
+    return static_cast<std::size_t>(micros);
+  }
+  // Each power of two past kSubBuckets gets kSubBuckets buckets, picked by
+  // the bits just below the top one
+  std::size_t shift =
+      static_cast<std::size_t>(std::bit_width(micros)) - 1 - kSubBucketBits;
+  return shift * kSubBuckets + static_cast<std::size_t>(micros >> shift);
+}
+
+uint64_t LatencyHistogram::BucketMax(std::size_t bucket) {
+  if (bucket < 2 * kSubBuckets) {
+    return bucket;
+  }
+  std::size_t shift = bucket / kSubBuckets - 1;
+  uint64_t lowest = static_cast<uint64_t>(bucket % kSubBuckets + kSubBuckets)
+                    << shift;
+  return lowest + (uint64_t{1} << shift) - 1;
+}
+
+void LatencyHistogram::Add(Clock::duration value) {
+  value = std::max(value, Clock::duration::zero());
+  uint64_t micros = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(value).count());
+  std::size_t bucket = Bucket(micros);
+  if (bucket >= counts_.size()) {
+    counts_.resize(bucket + 1);
+  }
+  counts_[bucket]++;
+  count_++;
+  sum_ += value;
+  max_ = std::max(max_, value);
+}
+
+LatencyHistogram::Clock::duration LatencyHistogram::Mean() const {
+  if (count_ == 0) {
+    return Clock::duration::zero();
+  }
+  return sum_ / static_cast<Clock::rep>(count_);
+}
+
+LatencyHistogram::Clock::duration LatencyHistogram::Percentile(
+    double percentile) const {
+  if (count_ == 0) {
+    return Clock::duration::zero();
+  }
+  auto rank = static_cast<uint64_t>(
+      std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 *
+                static_cast<double>(count_)));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (std::size_t bucket = 0; bucket < counts_.size(); bucket++) {
+    seen += counts_[bucket];
+    if (seen >= rank) {
+      // The top of the bucket, as the sample could have been anywhere in
+      // it, but never past the largest actually seen
+      return std::min<Clock::duration>(
+          std::chrono::microseconds(BucketMax(bucket)), max_);
+    }
+  }
+  return max_;
+}
+
+LatencyHistogram& LatencyHistogram::operator+=(const LatencyHistogram& other) {
+  if (other.counts_.size() > counts_.size()) {
+    counts_.resize(other.counts_.size());
+  }
+  for (std::size_t bucket = 0; bucket < other.counts_.size(); bucket++) {
+    counts_[bucket] += other.counts_[bucket];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  max_ = std::max(max_, other.max_);
+  return *this;
+}
+
+void HostTimings::Add(const RequestTimings& timings) {
+  queued.Add(timings.queued);
+  if (timings.connected) {
+    resolve.Add(timings.resolve);
+    connect.Add(timings.connect);
+    if (timings.tls_handshake != RequestTimings::Clock::duration::zero()) {
+      tls_handshake.Add(timings.tls_handshake);
+    }
+  }
+  wait.Add(timings.wait);
+  transfer.Add(timings.transfer);
+  total.Add(timings.Total());
+}
+
+HostTimings& HostTimings::operator+=(const HostTimings& other) {
+  queued += other.queued;
+  resolve += other.resolve;
+  connect += other.connect;
+  tls_handshake += other.tls_handshake;
+  wait += other.wait;
+  transfer += other.transfer;
+  total += other.total;
+  return *this;
+}
+
+}  // namespace http
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace http {
+
+// Where the time went for one request, measured on a monotonic clock.
+// Phases the request didn't wait on are zero: one written to a connection
+// that was already open spent nothing resolving, connecting or handshaking.
+struct RequestTimings {
+  using Clock = std::chrono::steady_clock;
+
+  // From being handed to the host's connections until one started writing
+  // it, less any time spent connecting for it
+  Clock::duration queued{};
+  Clock::duration resolve{};
+  Clock::duration connect{};
+  Clock::duration tls_handshake{};
+  // From starting to write the request until the response's headers were
+  // read: a round trip plus however long the host took to answer.  For
+  // HTTP/2 this runs to the end of the body, and transfer is zero.
+  Clock::duration wait{};
+  // Reading the body
+  Clock::duration transfer{};
+  // Whether a connection was opened for this request
+  bool connected = false;
+
+  Clock::duration Total() const {
+    return queued + resolve + connect + tls_handshake + wait + transfer;
+  }
+};
+
+// Counts durations in buckets that each span a fixed fraction of their
+// value, the way an HDR histogram does, so percentiles from a microsecond
+// up to hours are accurate to within 1 / kSubBuckets without keeping the
+// samples.
+class LatencyHistogram {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::size_t kSubBucketBits = 4;
+  // Buckets each power of two microseconds is split into
+  static constexpr std::size_t kSubBuckets = std::size_t{1} << kSubBucketBits;
+
+ private:
+  // Grown to the largest bucket used, so a fast host costs little
+  std::vector<uint64_t> counts_;
+  uint64_t count_ = 0;
+  Clock::duration sum_{};
+  Clock::duration max_{};
+
+  static std::size_t Bucket(uint64_t micros);
+
+  // The largest value, in microseconds, that lands in bucket
+  static uint64_t BucketMax(std::size_t bucket);
+
+ public:
+  void Add(Clock::duration value);
+
+  uint64_t Count() const { return count_; }
+
+  Clock::duration Max() const { return max_; }
+
+  Clock::duration Mean() const;
+
+  // The duration percentile percent of samples took at most, or zero if
+  // there are none
+  Clock::duration Percentile(double percentile) const;
+
+  LatencyHistogram& operator+=(const LatencyHistogram& other);
+};
+
+// The phase timings of every request answered by one host.  Connection
+// phases only count the requests a connection was opened for.
+struct HostTimings {
+  LatencyHistogram queued;
+  LatencyHistogram resolve;
+  LatencyHistogram connect;
+  LatencyHistogram tls_handshake;
+  LatencyHistogram wait;
+  LatencyHistogram transfer;
+  LatencyHistogram total;
+
+  void Add(const RequestTimings& timings);
+
+  HostTimings& operator+=(const HostTimings& other);
+};
+
+}  // namespace http
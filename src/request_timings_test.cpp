@@ -0,0 +1,80 @@
+#include "request_timings.hpp"
+
+#include <chrono>
+
+#include "gmock/gmock.h"
+
+namespace http {
+namespace {
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+TEST(LatencyHistogram, EmptyIsZero) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.Count(), 0U);
+  EXPECT_EQ(histogram.Percentile(50), LatencyHistogram::Clock::duration{});
+  EXPECT_EQ(histogram.Mean(), LatencyHistogram::Clock::duration{});
+}
+
+TEST(LatencyHistogram, SmallValuesAreExact) {
+  LatencyHistogram histogram;
+  for (int micros = 1; micros <= 10; micros++) {
+    histogram.Add(microseconds(micros));
+  }
+  EXPECT_EQ(histogram.Count(), 10U);
+  EXPECT_EQ(histogram.Percentile(50), microseconds(5));
+  EXPECT_EQ(histogram.Percentile(100), microseconds(10));
+  EXPECT_EQ(histogram.Max(), microseconds(10));
+}
+
+TEST(LatencyHistogram, PercentilesWithinBucketPrecision) {
+  LatencyHistogram histogram;
+  for (int millis = 1; millis <= 1000; millis++) {
+    histogram.Add(milliseconds(millis));
+  }
+  // Never under the true value, and over by no more than a bucket's width
+  for (double percentile : {50.0, 90.0, 99.0}) {
+    auto expected = milliseconds(static_cast<int>(percentile * 10));
+    auto actual = histogram.Percentile(percentile);
+    EXPECT_GE(actual, expected);
+    EXPECT_LE(actual, expected + expected / LatencyHistogram::kSubBuckets);
+  }
+  EXPECT_EQ(histogram.Percentile(100), milliseconds(1000));
+}
+
+TEST(LatencyHistogram, MergesCounts) {
+  LatencyHistogram fast;
+  LatencyHistogram slow;
+  for (int sample = 0; sample < 90; sample++) {
+    fast.Add(milliseconds(1));
+  }
+  for (int sample = 0; sample < 10; sample++) {
+    slow.Add(milliseconds(500));
+  }
+  fast += slow;
+  EXPECT_EQ(fast.Count(), 100U);
+  EXPECT_LE(fast.Percentile(90), milliseconds(2));
+  EXPECT_GE(fast.Percentile(95), milliseconds(500));
+  EXPECT_EQ(fast.Max(), milliseconds(500));
+}
+
+TEST(HostTimings, OnlyCountsConnectionsOpenedForTheRequest) {
+  HostTimings host;
+  host.Add(RequestTimings{.queued = milliseconds(1),
+                          .resolve = milliseconds(2),
+                          .connect = milliseconds(3),
+                          .tls_handshake = milliseconds(4),
+                          .wait = milliseconds(5),
+                          .transfer = milliseconds(6),
+                          .connected = true});
+  host.Add(RequestTimings{.wait = milliseconds(5),
+                          .transfer = milliseconds(6)});
+  EXPECT_EQ(host.connect.Count(), 1U);
+  EXPECT_EQ(host.tls_handshake.Count(), 1U);
+  EXPECT_EQ(host.wait.Count(), 2U);
+  EXPECT_EQ(host.total.Max(), milliseconds(21));
+}
+
+}  // namespace
+}  // namespace http
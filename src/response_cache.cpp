@@ -0,0 +1,175 @@
+#include "response_cache.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <boost/asio/post.hpp>
+#include <boost/beast/http/error.hpp>
+
+#include "http_client.hpp"
+
+namespace http {
+
+namespace {
+bool HasBufferedWaiter(const std::deque<CacheWaiter>& waiters) {
+  for (const CacheWaiter& waiter : waiters) {
+    if (!waiter.sink) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// A read that failed part way still hands back what it got, so only keep
+// responses whose body is as long as the server said it would be
+bool IsComplete(const ResponseHeader& header, std::string_view body) {
+  std::string_view length =
+      header[boost::beast::http::field::content_length];
+  return length.empty() || length == std::to_string(body.size());
+}
+}  // namespace
+
+ResponseCache::ResponseCache(boost::asio::io_context& ioc_in,
+                             const std::shared_ptr<ClientStats>& stats)
+    : ioc_(ioc_in), stats_(stats) {}
+
+void ResponseCache::SetMaxEntries(std::size_t max_entries) {
+  maxEntries_ = max_entries;
+  Evict();
+}
+
+Response ResponseCache::MakeResponse(const Entry& entry, bool with_body) {
+  Response::ResponseType res(*entry.header);
+  if (with_body) {
+    res.body() = entry.body;
+  }
+  return Response(std::move(res));
+}
+
+void ResponseCache::Replay(const std::shared_ptr<Entry>& entry,
+                           CacheWaiter& waiter) {
+  if (waiter.sink && !entry->body.empty()) {
+    waiter.sink(*entry->header, entry->body, waiter.ec);
+  }
+  waiter.callback(MakeResponse(*entry, !waiter.sink));
+}
+
+bool ResponseCache::Join(const std::string& key, CacheWaiter&& waiter) {
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+  std::shared_ptr<Entry> entry = it->second;
+  if (entry->complete) {
+    SPDLOG_DEBUG("Answering {} from cache", key);
+    stats_->cached_responses++;
+    lru_.splice(lru_.begin(), lru_, entry->lruPos);
+    // Callers don't expect to be called back before SendData returns
+    boost::asio::post(ioc_, [entry, waiter{std::move(waiter)}]() mutable {
+      Replay(entry, waiter);
+    });
+    return true;
+  }
+
+  SPDLOG_DEBUG("Joining in flight request for {}", key);
+  stats_->coalesced_requests++;
+  CacheWaiter& joined = entry->waiters.emplace_back(std::move(waiter));
+  // Catch up on the part of the body that's already arrived
+  if (joined.sink && entry->header && !entry->body.empty()) {
+    joined.sink(*entry->header, entry->body, joined.ec);
+  }
+  return true;
+}
+
+std::pair<std::function<void(Response&&)>, BodySink> ResponseCache::Begin(
+    const std::string& key, CacheWaiter&& waiter) {
+  auto entry = std::make_shared<Entry>();
+  entry->key = key;
+  entry->waiters.emplace_back(std::move(waiter));
+  entries_.insert_or_assign(key, entry);
+  return {std::bind_front(&ResponseCache::OnComplete, weak_from_this(), entry),
+          std::bind_front(&ResponseCache::OnChunk, weak_from_this(), entry)};
+}
+
+void ResponseCache::OnChunk(const std::weak_ptr<ResponseCache>& weak_self,
+                            const std::shared_ptr<Entry>& entry,
+                            const ResponseHeader& header,
+                            std::string_view chunk,
+                            boost::system::error_code& ec) {
+  if (!entry->header) {
+    entry->header = header;
+  }
+  if (entry->shareable) {
+    if (entry->body.size() + chunk.size() > kHttpReadBodyLimit) {
+      if (HasBufferedWaiter(entry->waiters)) {
+        // The same limit a buffered request has on its own
+        ec = boost::beast::http::error::body_limit;
+        return;
+      }
+      SPDLOG_DEBUG("{} is too large to share", entry->key);
+      entry->shareable = false;
+      entry->body.clear();
+      entry->body.shrink_to_fit();
+      std::shared_ptr<ResponseCache> self = weak_self.lock();
+      if (self != nullptr) {
+        auto it = self->entries_.find(entry->key);
+        if (it != self->entries_.end() && it->second == entry) {
+          self->entries_.erase(it);
+        }
+      }
+    } else {
+      entry->body += chunk;
+    }
+  }
+
+  // Waiters that join from inside a sink have already been caught up with
+  // this chunk
+  std::size_t count = entry->waiters.size();
+  for (std::size_t index = 0; index < count; index++) {
+    CacheWaiter& waiter = entry->waiters[index];
+    if (waiter.sink && !waiter.ec) {
+      waiter.sink(header, chunk, waiter.ec);
+    }
+  }
+}
+
+void ResponseCache::OnComplete(const std::weak_ptr<ResponseCache>& weak_self,
+                               const std::shared_ptr<Entry>& entry,
+                               Response&& res) {
+  // The body was all streamed through OnChunk
+  entry->header = std::move(res.string_response->base());
+  std::deque<CacheWaiter> waiters = std::move(entry->waiters);
+  entry->waiters.clear();
+
+  std::shared_ptr<ResponseCache> self = weak_self.lock();
+  if (self != nullptr) {
+    auto it = self->entries_.find(entry->key);
+    if (it != self->entries_.end() && it->second == entry) {
+      if (self->maxEntries_ > 0 && entry->shareable &&
+          entry->header->result() == boost::beast::http::status::ok &&
+          IsComplete(*entry->header, entry->body)) {
+        entry->complete = true;
+        self->lru_.push_front(entry->key);
+        entry->lruPos = self->lru_.begin();
+        self->Evict();
+      } else {
+        self->entries_.erase(it);
+      }
+    }
+  }
+
+  for (CacheWaiter& waiter : waiters) {
+    // Every waiter waited on the one exchange
+    Response shared = MakeResponse(*entry, !waiter.sink);
+    shared.timings = res.timings;
+    waiter.callback(std::move(shared));
+  }
+}
+
+void ResponseCache::Evict() {
+  while (lru_.size() > maxEntries_) {
+    entries_.erase(lru_.back());
+    lru_.pop_back();
+  }
+}
+
+}  // namespace http
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/system/error_code.hpp>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "http_response.hpp"
+#include "sink_body.hpp"
+
+namespace http {
+
+struct ClientStats;
+
+// One caller waiting on a shared response
+struct CacheWaiter {
+  std::function<void(Response&&)> callback;
+  BodySink sink;
+  // Set once the sink has asked to stop receiving the body
+  boost::system::error_code ec;
+};
+
+// Shares GET responses between identical requests.  A request made while an
+// identical one is in flight joins it rather than going out on the network,
+// and if a cache size is set, completed responses are kept, least recently
+// used first out, and replayed to later requests.
+//
+// Streamed bodies are buffered so that a request joining late can be caught
+// up, up to kHttpReadBodyLimit.  Beyond that the response stops being shared.
+class ResponseCache : public std::enable_shared_from_this<ResponseCache> {
+ private:
+  struct Entry {
+    std::string key;
+    std::optional<ResponseHeader> header;
+    std::string body;
+    bool complete = false;
+    // False once the body is too large to share
+    bool shareable = true;
+    // A deque, so that waiters joining from inside a sink don't invalidate
+    // the waiter whose sink is running
+    std::deque<CacheWaiter> waiters;
+    std::list<std::string>::iterator lruPos;
+  };
+
+  boost::asio::io_context& ioc_;
+  std::shared_ptr<ClientStats> stats_;
+  std::size_t maxEntries_ = 0;
+  // In flight and completed responses, by key
+  std::unordered_map<std::string, std::shared_ptr<Entry> > entries_;
+  // Keys of completed responses, most recently used first
+  std::list<std::string> lru_;
+
+  static Response MakeResponse(const Entry& entry, bool with_body);
+
+  static void Replay(const std::shared_ptr<Entry>& entry, CacheWaiter& waiter);
+
+  static void OnChunk(const std::weak_ptr<ResponseCache>& weak_self,
+                      const std::shared_ptr<Entry>& entry,
+                      const ResponseHeader& header, std::string_view chunk,
+                      boost::system::error_code& ec);
+
+  static void OnComplete(const std::weak_ptr<ResponseCache>& weak_self,
+                         const std::shared_ptr<Entry>& entry, Response&& res);
+
+  void Evict();
+
+ public:
+  ResponseCache(boost::asio::io_context& ioc_in,
+                const std::shared_ptr<ClientStats>& stats);
+
+  // Number of completed responses to keep.  0 only coalesces requests that
+  // are in flight at the same time.
+  void SetMaxEntries(std::size_t max_entries);
+
+  // Attaches waiter to an identical request that's in flight or cached.
+  // Returns false if there isn't one, in which case the caller should send
+  // the request with the callback and sink returned by Begin.
+  bool Join(const std::string& key, CacheWaiter&& waiter);
+
+  std::pair<std::function<void(Response&&)>, BodySink> Begin(
+      const std::string& key, CacheWaiter&& waiter);
+};
+
+}  // namespace http
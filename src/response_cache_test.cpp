@@ -0,0 +1,110 @@
+#include "response_cache.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "http_client.hpp"
+
+namespace http {
+namespace {
+
+using ::testing::ElementsAre;
+
+class ResponseCacheTest : public ::testing::Test {
+ protected:
+  boost::asio::io_context ioc_;
+  std::shared_ptr<ClientStats> stats_ = std::make_shared<ClientStats>();
+  std::shared_ptr<ResponseCache> cache_ =
+      std::make_shared<ResponseCache>(ioc_, stats_);
+  ResponseHeader header_;
+  // Everything each waiter was given, in order
+  std::vector<std::string> events_;
+
+  ResponseCacheTest() {
+    header_.result(boost::beast::http::status::ok);
+    header_.set(boost::beast::http::field::content_length, "6");
+  }
+
+  CacheWaiter Buffered(const std::string& name) {
+    return CacheWaiter{.callback = [this, name](Response&& res) {
+      events_.push_back(name + " done " + res.Body());
+    }};
+  }
+
+  CacheWaiter Streamed(const std::string& name) {
+    return CacheWaiter{
+        .callback =
+            [this, name](Response&& res) {
+              events_.push_back(name + " done " + res.Body());
+            },
+        .sink = [this, name](const ResponseHeader&, std::string_view chunk,
+                             boost::system::error_code&) {
+          events_.push_back(name + " chunk " + std::string(chunk));
+        }};
+  }
+};
+
+TEST_F(ResponseCacheTest, CoalescesInFlightRequests) {
+  EXPECT_FALSE(cache_->Join("/a", Streamed("first")));
+  auto [callback, sink] = cache_->Begin("/a", Streamed("first"));
+  boost::system::error_code ec;
+  sink(header_, "abc", ec);
+
+  // Joiners are caught up on what's already arrived
+  EXPECT_TRUE(cache_->Join("/a", Streamed("second")));
+  EXPECT_TRUE(cache_->Join("/a", Buffered("third")));
+  sink(header_, "def", ec);
+  callback(Response(Response::ResponseType(header_)));
+
+  EXPECT_THAT(events_,
+              ElementsAre("first chunk abc", "second chunk abc",
+                          "first chunk def", "second chunk def", "first done ",
+                          "second done ", "third done abcdef"));
+  EXPECT_EQ(stats_->coalesced_requests, 2U);
+
+  // Without a cache size, nothing is kept once the request completes
+  EXPECT_FALSE(cache_->Join("/a", Buffered("fourth")));
+}
+
+TEST_F(ResponseCacheTest, ReplaysCachedResponses) {
+  cache_->SetMaxEntries(1);
+  auto [callback, sink] = cache_->Begin("/a", Buffered("first"));
+  boost::system::error_code ec;
+  sink(header_, "abcdef", ec);
+  callback(Response(Response::ResponseType(header_)));
+
+  EXPECT_TRUE(cache_->Join("/a", Streamed("second")));
+  // Replays happen asynchronously
+  EXPECT_THAT(events_, ElementsAre("first done abcdef"));
+  ioc_.run();
+  EXPECT_THAT(events_, ElementsAre("first done abcdef", "second chunk abcdef",
+                                   "second done "));
+  EXPECT_EQ(stats_->cached_responses, 1U);
+
+  // Caching another response evicts the first
+  auto [callback_b, sink_b] = cache_->Begin("/b", Buffered("third"));
+  sink_b(header_, "ghijkl", ec);
+  callback_b(Response(Response::ResponseType(header_)));
+  EXPECT_FALSE(cache_->Join("/a", Buffered("fourth")));
+}
+
+TEST_F(ResponseCacheTest, DoesNotCacheErrorsOrTruncatedBodies) {
+  cache_->SetMaxEntries(4);
+  auto [callback, sink] = cache_->Begin("/a", Buffered("first"));
+  boost::system::error_code ec;
+  sink(header_, "abc", ec);
+  callback(Response(Response::ResponseType(header_)));
+  EXPECT_FALSE(cache_->Join("/a", Buffered("second")));
+
+  header_.result(boost::beast::http::status::not_found);
+  auto [callback_b, sink_b] = cache_->Begin("/b", Buffered("third"));
+  sink_b(header_, "abcdef", ec);
+  callback_b(Response(Response::ResponseType(header_)));
+  EXPECT_FALSE(cache_->Join("/b", Buffered("fourth")));
+}
+
+}  // namespace
+}  // namespace http
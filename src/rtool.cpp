@@ -2,272 +2,318 @@
 #include <spdlog/spdlog.h>
 
 #include <CLI/CLI.hpp>
+#include <algorithm>
+#include <array>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/use_awaitable.hpp>
 #include <boost/json.hpp>
-#include <boost/json/basic_parser_impl.hpp>
 #include <boost/stacktrace.hpp>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <iostream>
 #include <limits>
+#include <map>
+#include <mutex>
 #include <optional>
+#include <string_view>
+#include <thread>
+#include <utility>
 
 #include "boost_formatter.hpp"
+#include "fleet_query.hpp"
 #include "http_client.hpp"
 #include "json.hpp"
 #include "path_parser.hpp"
 #include "path_parser_fmt_printers.hpp"
+#include "query_server.hpp"
+#include "redpath_query.hpp"
+
+// The session cache, if sessions are being used and it's enabled
+std::shared_ptr<http::SessionCache> MakeSessionCache(
+    const HostConnectData& host) {
+  if (host.username.empty() || !host.session_cache) {
+    return nullptr;
+  }
+  return std::make_shared<http::SessionCache>(
+      http::SessionCache::DefaultPath());
+}
 
-class RedpathParser {
-  // Handler methods don't follow the naming convention.
-  // NOLINTBEGIN
-  struct MatchedProperty {
-    redfish::filter_ast::path key_path;
-    std::string value;
-  };
-  struct Handler {
-    explicit Handler(std::vector<redfish::filter_ast::path>&& redpaths_in) {
-      for (const redfish::filter_ast::path& redpath : redpaths_in) {
-        redpaths.emplace_back(MatchedProperty{std::move(redpath), ""});
-      }
-    }
-    std::vector<MatchedProperty> release() { return std::move(redpaths); }
-
-    // Each redpath in order, as well as how many key strings have been matched
-    std::vector<MatchedProperty> redpaths;
-    std::string current_key = "/";
-    std::string current_value;
-    constexpr static std::size_t max_object_size = std::size_t(-1);
-    constexpr static std::size_t max_array_size = std::size_t(-1);
-    constexpr static std::size_t max_key_size = std::size_t(-1);
-    constexpr static std::size_t max_string_size = std::size_t(-1);
-
-    static bool on_document_begin(std::error_code& /*unused*/) { return true; }
-    static bool on_document_end(std::error_code& /*unused*/) { return true; }
-    bool on_object_begin(std::error_code& /*unused*/) {
-      // SPDLOG_DEBUG("Object begin in object {}", current_key);
-      // current_key += "/";
-      return true;
-    }
-
-    void pop_value() {
-      current_key = current_key.substr(0, current_key.rfind('/'));
-      current_key = current_key.substr(0, current_key.rfind('/') + 1);
-    }
+std::shared_ptr<http::Client> MakeClient(
+    boost::asio::io_context& ioc, const http::ConnectPolicy& policy,
+    const std::shared_ptr<http::SessionCache>& session_cache) {
+  auto client = std::make_shared<http::Client>(ioc, policy);
+  if (session_cache != nullptr) {
+    client->SetSessionCache(session_cache);
+  }
+  return client;
+}
 
-    bool on_object_end(std::size_t /*unused*/, std::error_code& /*unused*/) {
-      // SPDLOG_DEBUG("Object end in object {}", current_key);
-      pop_value();
-      return true;
-    }
-    bool on_array_begin(std::error_code& /*unused*/) { return true; }
-    bool on_array_end(std::size_t /*unused*/, std::error_code& /*unused*/) {
-      return true;
-    }
-    bool on_key_part(std::string_view key, std::size_t /*key_size*/,
-                     std::error_code& /*unused*/) {
-      current_key += key;
-      return true;
-    }
-    bool on_key(std::string_view key, std::size_t key_size,
-                std::error_code& ec) {
-      if (!on_key_part(key, key_size, ec)) {
-        return false;
-      }
-      current_key += "/";
-      return true;
-    }
-    bool on_string_part(std::string_view str, std::size_t /*unused*/,
-                        std::error_code& /*unused*/) {
-      current_value += str;
-      return true;
-    }
-    bool on_string(std::string_view str, std::size_t str_size,
-                   std::error_code& ec) {
-      if (!on_string_part(str, str_size, ec)) {
-        return false;
-      }
-      SPDLOG_DEBUG("value for {} was {}",
-                   current_key.substr(0, current_key.size() - 1), str);
-
-      for (auto& redpath : redpaths) {
-        if (const redfish::filter_ast::key_name* match =
-                std::get_if<redfish::filter_ast::key_name>(
-                    &redpath.key_path.first)) {
-          std::string odata = match->str() + "/@odata.id";
-          SPDLOG_DEBUG("checking {} == {}", odata, current_key);
-
-          if (odata == current_key) {
-            // Found match
-            SPDLOG_DEBUG("Found match {}", current_key);
-            redpath.value = std::move(current_value);
-            break;
-          }
-        }
-        if (const redfish::filter_ast::key_filter* path =
-                std::get_if<redfish::filter_ast::key_filter>(
-                    &redpath.key_path.first)) {
-          if (path->key + "/@odata.id" == current_key) {
-            redpath.value = std::move(current_value);
-          }
-        }
-      }
+// Authenticates to host with a Redfish session, if a username was given
+void Authenticate(http::Client& client, const HostConnectData& host) {
+  if (host.username.empty()) {
+    return;
+  }
+  client.Authenticate(
+      host.host, host.port,
+      http::Credentials{.username = host.username, .password = host.password});
+}
 
-      pop_value();
+struct RawGetOptions {
+  std::vector<std::string> redpaths;
+  RedpathQueryOptions query;
+  std::size_t cache_size = 256;
+  // Query every host listed in this file ("-" for stdin) instead of --host
+  std::string hosts_file;
+  FleetOptions fleet;
+  // Threads the hosts are sharded across, each with its own io_context
+  std::size_t threads = 1;
+  // Hand single host queries to the rtool serve listening here, if there is
+  // one
+  std::string socket = DefaultServerSocket().string();
+  bool use_server = true;
+  // "table" or "json" to print how long each phase of the requests took.
+  // Queries are run here rather than by rtool serve, to time them.
+  std::string timings;
+  // Write a Chrome trace of the run here.  Like timings, bypasses rtool
+  // serve.
+  std::string trace;
+  // Print the client's counters as json once done.  Also bypasses rtool
+  // serve, whose counters are read with rtool stats.
+  bool stats = false;
+};
 
-      // current_key = "";
-      current_value = "";
+// One thread's share of a fleet.  Nothing in a shard is touched by any other
+// thread, so the connections need no locking.
+struct FleetShard {
+  boost::asio::io_context ioc;
+  std::shared_ptr<http::Client> client;
+  std::shared_ptr<FleetQuery> fleet;
+  std::shared_ptr<http::Tracer> tracer;
+};
 
-      return true;
-    }
-    bool on_bool(bool value, std::error_code& /*unused*/) {
-      SPDLOG_DEBUG("Value of {} was {}",
-                   current_key.substr(0, current_key.size() - 1), value);
-      pop_value();
+void LogStats(const http::ClientStats& stats) {
+  SPDLOG_INFO("TLS handshakes: {} full, {} resumed", stats.full_handshakes,
+              stats.resumed_handshakes);
+  SPDLOG_INFO("Sessions: {} logins, {} reused from cache", stats.logins,
+              stats.cached_sessions);
+  SPDLOG_INFO("Requests saved: {} coalesced, {} from cache",
+              stats.coalesced_requests, stats.cached_responses);
+  SPDLOG_INFO("Requests held back: {} waited for room, {} rejected",
+              stats.deferred_requests, stats.rejected_requests);
+  SPDLOG_INFO("Failures: {} retried, {} failed fast on hosts that were down",
+              stats.retried_requests, stats.short_circuited_requests);
+  SPDLOG_INFO("Hedges: {} sent, {} answered first", stats.hedged_requests,
+              stats.hedges_won);
+  SPDLOG_INFO("Pipelining: {} requests pipelined, {} hosts fell back",
+              stats.pipelined_requests, stats.pipeline_fallbacks);
+  SPDLOG_INFO("HTTP/2: {} connections, {} requests", stats.http2_connections,
+              stats.http2_requests);
+  SPDLOG_INFO("Connections: {} opened ahead of requests, {} idle recycled",
+              stats.prewarmed_connections, stats.recycled_connections);
+}
 
-      return true;
-    }
-    bool on_number_part(std::string_view /*unused*/,
-                        std::error_code& /*unused*/) {
-      return true;
-    }
-    bool on_int64(std::int64_t value, std::string_view /*unused*/,
-                  std::error_code& /*unused*/) {
-      SPDLOG_DEBUG("Value of {} was {}",
-                   current_key.substr(0, current_key.size() - 1), value);
-      pop_value();
+double Millis(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
 
-      return true;
-    }
-    bool on_uint64(std::uint64_t value, std::string_view /*unused*/,
-                   std::error_code& /*unused*/) {
-      SPDLOG_DEBUG("Value of {} was {}",
-                   current_key.substr(0, current_key.size() - 1), value);
-      pop_value();
-      return true;
-    }
-    bool on_double(double value, std::string_view /*unused*/,
-                   std::error_code& /*unused*/) {
-      SPDLOG_DEBUG("Value of {} was {}",
-                   current_key.substr(0, current_key.size() - 1), value);
-      pop_value();
-      return true;
-    }
-    bool on_null(std::error_code& /*unused*/) {
-      SPDLOG_DEBUG("Value of {} was null",
-                   current_key.substr(0, current_key.size() - 1));
-      pop_value();
+std::array<std::pair<std::string_view, const http::LatencyHistogram*>, 7>
+Phases(const http::HostTimings& timings) {
+  return {{{"queued", &timings.queued},
+           {"resolve", &timings.resolve},
+           {"connect", &timings.connect},
+           {"tls", &timings.tls_handshake},
+           {"wait", &timings.wait},
+           {"transfer", &timings.transfer},
+           {"total", &timings.total}}};
+}
 
-      return true;
-    }
-    static bool on_comment_part(std::string_view /*unused*/,
-                                std::error_code& /*unused*/) {
-      return false;
+// Prints percentiles of each phase of the requests to each host, as a table
+// or as json
+void PrintTimings(std::string_view format,
+                  const std::map<std::string, http::HostTimings>& hosts) {
+  if (format == "json") {
+    boost::json::object out;
+    for (const auto& [host, timings] : hosts) {
+      boost::json::object& phases = out[host].emplace_object();
+      for (const auto& [phase, histogram] : Phases(timings)) {
+        if (histogram->Count() == 0) {
+          continue;
+        }
+        phases[phase] = {
+            {"count", histogram->Count()},
+            {"mean_ms", Millis(histogram->Mean())},
+            {"p50_ms", Millis(histogram->Percentile(50))},
+            {"p90_ms", Millis(histogram->Percentile(90))},
+            {"p99_ms", Millis(histogram->Percentile(99))},
+            {"max_ms", Millis(histogram->Max())},
+        };
+      }
     }
-    static bool on_comment(std::string_view /*unused*/,
-                           std::error_code& /*unused*/) {
-      return false;
+    PrettyPrint(std::cout, out);
+    std::cout << "\n";
+    return;
+  }
+  std::cout << std::format("{:<24} {:<9} {:>8} {:>10} {:>10} {:>10} {:>10} "
+                           "{:>10}\n",
+                           "host", "phase", "count", "mean ms", "p50 ms",
+                           "p90 ms", "p99 ms", "max ms");
+  for (const auto& [host, timings] : hosts) {
+    for (const auto& [phase, histogram] : Phases(timings)) {
+      if (histogram->Count() == 0) {
+        continue;
+      }
+      std::cout << std::format(
+          "{:<24} {:<9} {:>8} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f} "
+          "{:>10.3f}\n",
+          host, phase, histogram->Count(), Millis(histogram->Mean()),
+          Millis(histogram->Percentile(50)), Millis(histogram->Percentile(90)),
+          Millis(histogram->Percentile(99)), Millis(histogram->Max()));
     }
-    // NOLINTEND
-  };
-
-  boost::json::basic_parser<Handler> p_;
+  }
+}
 
- public:
-  explicit RedpathParser(std::vector<redfish::filter_ast::path>&& redpaths)
-      : p_(boost::json::parse_options(), std::move(redpaths)) {}
+void PrintStats(const http::ClientStats& stats,
+                const std::map<std::string, http::HostStats>& hosts) {
+  PrettyPrint(std::cout, StatsToJson(stats, hosts));
+  std::cout << "\n";
+}
 
-  std::vector<MatchedProperty> release() { return p_.handler().release(); }
+void WriteTrace(const std::string& path,
+                const std::vector<const http::Tracer*>& tracers) {
+  std::ofstream out(path);
+  if (!out) {
+    SPDLOG_ERROR("Failed to open {}", path);
+    return;
+  }
+  http::Tracer::Write(out, tracers);
+  out.close();
+  if (!out) {
+    SPDLOG_ERROR("Failed to write trace to {}", path);
+    return;
+  }
+  SPDLOG_INFO("Wrote trace to {}", path);
+}
 
-  std::size_t Write(char const* data, std::size_t size,
-                    boost::system::error_code& ec) {
-    auto const n = p_.write_some(false, data, size, ec);
-    if (!ec && n < size) {
-      ec = boost::json::error::extra_data;
+void run_fleet_get_cmd(const RawGetOptions& opts,
+                       const http::ConnectPolicy& policy,
+                       const HostConnectData& defaults,
+                       std::vector<redfish::filter_ast::path>&& paths) {
+  std::optional<std::vector<HostConnectData>> hosts;
+  if (opts.hosts_file == "-") {
+    hosts = ParseHostList(std::cin, defaults);
+  } else {
+    std::ifstream in(opts.hosts_file);
+    if (!in) {
+      SPDLOG_ERROR("Failed to open {}", opts.hosts_file);
+      return;
     }
-    return n;
+    hosts = ParseHostList(in, defaults);
   }
-};
-
-struct HostConnectData {
-  std::string host;
-  uint16_t port = 443;
-  std::string username;
-  std::string password;
-};
-
-static void GetRedpath(const std::string& base_uri, HostConnectData host,
-                       const std::shared_ptr<http::Client>& client,
-                       std::vector<redfish::filter_ast::path>&& redpaths);
-
-static void HandleResponse(std::vector<redfish::filter_ast::path> redpaths,
-                           const std::shared_ptr<http::Client>& client,
-                           HostConnectData host, http::Response&& res) {
-  SPDLOG_DEBUG("Got response {}", res.Body());
-  std::string_view ct = res.GetHeader(boost::beast::http::field::content_type);
-  if (ct != "application/json" && ct != "application/json; charset=utf-8") {
+  if (!hosts) {
     return;
   }
-  boost::system::error_code ec;
+  std::size_t host_count = hosts->size();
 
-  RedpathParser p(std::move(redpaths));
-  p.Write(res.Body().data(), res.Body().size(), ec);
-  auto redpaths_out = p.release();
-  for (auto& redpath : redpaths_out) {
-    if (const redfish::filter_ast::key_filter* filter =
-            std::get_if<redfish::filter_ast::key_filter>(
-                &redpath.key_path.first)) {
-      if (filter->key == "") {
-      } else if (filter->filter == '*') {
-        std::optional<redfish::filter_ast::path> parent =
-            redpath.key_path.strip_parent();
-        if (parent) {
-          SPDLOG_DEBUG("Resolving {}", parent->to_path_string());
-          std::vector<redfish::filter_ast::path> new_paths;
-          new_paths.push_back(*parent);
-          GetRedpath(redpath.value, host, client, std::move(new_paths));
-        } else {
-          SPDLOG_DEBUG("Couldn't resolve parent of {}",
-                       redpath.key_path.to_path_string());
-        }
-      }
-    } else if (!redpath.value.empty()) {
-      SPDLOG_DEBUG("{}={}", redpath.key_path.to_path_string(), redpath.value);
+  std::size_t thread_count = std::clamp<std::size_t>(
+      opts.threads, 1, std::max<std::size_t>(host_count, 1));
+  std::vector<std::vector<HostConnectData>> shard_hosts(thread_count);
+  for (std::size_t index = 0; index < host_count; index++) {
+    shard_hosts[index % thread_count].emplace_back(std::move((*hosts)[index]));
+  }
+  // The in flight limit is for the whole fleet
+  FleetOptions shard_options = opts.fleet;
+  shard_options.max_hosts_in_flight =
+      (opts.fleet.max_hosts_in_flight + thread_count - 1) / thread_count;
+
+  std::shared_ptr<http::SessionCache> session_cache =
+      MakeSessionCache(defaults);
+  // Guards std::cout and failed_hosts, the only state shards share
+  std::mutex output_mutex;
+  std::size_t failed_hosts = 0;
+
+  std::vector<std::unique_ptr<FleetShard>> shards;
+  for (std::vector<HostConnectData>& shard_host_list : shard_hosts) {
+    auto shard = std::make_unique<FleetShard>();
+    shard->client = MakeClient(shard->ioc, policy, session_cache);
+    shard->client->SetResponseCacheSize(opts.cache_size);
+    if (!opts.trace.empty()) {
+      shard->tracer =
+          std::make_shared<http::Tracer>(std::format("shard {}", shards.size()));
+      shard->client->SetTracer(shard->tracer);
     }
+    shard->fleet = std::make_shared<FleetQuery>(
+        shard->ioc, shard->client, std::move(shard_host_list),
+        std::vector<redfish::filter_ast::path>(paths), opts.query,
+        shard_options,
+        [&output_mutex](const HostConnectData& host, std::string_view redpath,
+                        std::string_view value) {
+          std::lock_guard<std::mutex> lock(output_mutex);
+          std::cout << host.host << " " << redpath << "=" << value << "\n";
+        },
+        [&output_mutex, &failed_hosts](const HostConnectData& host,
+                                       const QueryStatus& status) {
+          if (status.failed_requests != 0) {
+            std::lock_guard<std::mutex> lock(output_mutex);
+            failed_hosts++;
+            SPDLOG_ERROR("{}: {} of {} requests failed", host.host,
+                         status.failed_requests, status.requests);
+          } else {
+            SPDLOG_DEBUG("{}: done after {} requests", host.host,
+                         status.requests);
+          }
+        });
+    shard->fleet->Start();
+    shards.emplace_back(std::move(shard));
   }
-  if (ec) {
-    return;
+
+  // The first shard runs on this thread
+  std::vector<std::thread> threads;
+  for (std::size_t index = 1; index < shards.size(); index++) {
+    threads.emplace_back([&ioc = shards[index]->ioc]() { ioc.run(); });
+  }
+  shards.front()->ioc.run();
+  for (std::thread& thread : threads) {
+    thread.join();
   }
-}
 
-static void GetRedpath(const std::string& base_uri, HostConnectData host,
-                       const std::shared_ptr<http::Client>& client,
-                       std::vector<redfish::filter_ast::path>&& redpaths) {
-  boost::beast::http::fields headers;
-  std::string auth = host.username + ":" + host.password;
-  std::string auth_out;
-  /*
-  auth_out.resize(boost::beast::detail::base64::encoded_size(auth.size()));
-  auth_out.resize(boost::beast::detail::base64::encode(
-      auth_out.data(), auth.data(), auth.size()));
-  SPDLOG_DEBUG("Got base64 {}", auth_out);
-  headers.set(boost::beast::http::field::authorization, "Basic " + auth_out);
-  */
-  client->SendData(
-      std::string(), host.host, host.port, base_uri, headers,
-      boost::beast::http::verb::get,
-      std::bind_front(&HandleResponse, std::move(redpaths), client, host));
+  // Each shard's client counted on its own thread, and they're summed here
+  http::ClientStats stats;
+  std::map<std::string, http::HostStats> host_stats;
+  std::map<std::string, http::HostTimings> timings;
+  for (const std::unique_ptr<FleetShard>& shard : shards) {
+    stats += shard->client->Stats();
+    for (const auto& [host, counters] : shard->client->StatsByHost()) {
+      host_stats[host] += counters;
+    }
+    for (const auto& [host, host_timings] : shard->client->Timings()) {
+      timings[host] += host_timings;
+    }
+  }
+  SPDLOG_INFO("Queried {} hosts on {} threads, {} with failures", host_count,
+              thread_count, failed_hosts);
+  LogStats(stats);
+  if (!opts.timings.empty()) {
+    PrintTimings(opts.timings, timings);
+  }
+  if (opts.stats) {
+    PrintStats(stats, host_stats);
+  }
+  if (!opts.trace.empty()) {
+    std::vector<const http::Tracer*> tracers;
+    for (const std::unique_ptr<FleetShard>& shard : shards) {
+      tracers.push_back(shard->tracer.get());
+    }
+    WriteTrace(opts.trace, tracers);
+  }
 }
 
-struct RawGetOptions {
-  std::vector<std::string> redpaths;
-};
-
 void run_raw_get_cmd(const RawGetOptions& opts,
                      const http::ConnectPolicy& policy,
                      const HostConnectData& host) {
-  boost::asio::io_context ioc;
-
-  std::shared_ptr<http::Client> http =
-      std::make_shared<http::Client>(ioc, policy);
-
   std::vector<redfish::filter_ast::path> paths;
   for (const auto& redpath : opts.redpaths) {
     std::optional<redfish::filter_ast::path> path = parseRedfishPath(redpath);
@@ -281,10 +327,124 @@ void run_raw_get_cmd(const RawGetOptions& opts,
     SPDLOG_DEBUG("{}", path);
   }
 
-  GetRedpath("/redfish/v1", host, http, std::move(paths));
+  if (!opts.hosts_file.empty()) {
+    run_fleet_get_cmd(opts, policy, host, std::move(paths));
+    return;
+  }
+
+  if (opts.use_server && opts.timings.empty() && opts.trace.empty() &&
+      !opts.stats) {
+    std::optional<QueryStatus> status = ForwardQuery(
+        opts.socket,
+        ForwardedQuery{.host = host,
+                       .policy = policy,
+                       .options = opts.query,
+                       .redpaths = opts.redpaths},
+        [](std::string_view redpath, std::string_view value) {
+          std::cout << redpath << "=" << value << "\n";
+        });
+    if (status) {
+      if (status->failed_requests != 0) {
+        SPDLOG_ERROR("{} of {} requests failed", status->failed_requests,
+                     status->requests);
+      }
+      return;
+    }
+  }
+
+  boost::asio::io_context ioc;
+  std::shared_ptr<http::Client> http =
+      MakeClient(ioc, policy, MakeSessionCache(host));
+  http->SetResponseCacheSize(opts.cache_size);
+  if (!opts.trace.empty()) {
+    http->SetTracer(std::make_shared<http::Tracer>("rtool"));
+  }
+  Authenticate(*http, host);
+
+  auto query = std::make_shared<RedpathQuery>(
+      http, host, std::move(paths), opts.query,
+      [](std::string_view redpath, std::string_view value) {
+        std::cout << redpath << "=" << value << "\n";
+      });
+  boost::asio::co_spawn(
+      ioc,
+      [query]() -> boost::asio::awaitable<void> {
+        QueryStatus status =
+            co_await query->AsyncRun(boost::asio::use_awaitable);
+        if (status.failed_requests != 0) {
+          SPDLOG_ERROR("{} of {} requests failed", status.failed_requests,
+                       status.requests);
+        }
+      },
+      boost::asio::detached);
+  ioc.run();
+
+  LogStats(http->Stats());
+  if (!opts.timings.empty()) {
+    PrintTimings(opts.timings, http->Timings());
+  }
+  if (opts.stats) {
+    PrintStats(http->Stats(), http->StatsByHost());
+  }
+  if (!opts.trace.empty()) {
+    WriteTrace(opts.trace, {http->GetTracer().get()});
+  }
+}
+
+void run_logout_cmd(const http::ConnectPolicy& policy,
+                    const HostConnectData& host) {
+  if (host.username.empty()) {
+    SPDLOG_ERROR("logout requires --user");
+    return;
+  }
+  boost::asio::io_context ioc;
+  std::shared_ptr<http::Client> http =
+      MakeClient(ioc, policy, MakeSessionCache(host));
+  Authenticate(*http, host);
+  http->Logout(host.host, host.port, [&host](bool deleted) {
+    if (deleted) {
+      SPDLOG_INFO("Logged out of {}", host.host);
+    } else {
+      SPDLOG_INFO("No session with {} to log out of", host.host);
+    }
+  });
   ioc.run();
 }
 
+struct ServeOptions {
+  std::string socket = DefaultServerSocket().string();
+  std::size_t cache_size = 0;
+};
+
+void run_serve_cmd(const ServeOptions& opts,
+                   const http::ConnectPolicy& policy) {
+  boost::asio::io_context ioc;
+  QueryServer server(
+      ioc, opts.socket,
+      redfish::ClientOptions{
+          .connect = policy,
+          .response_cache_size = opts.cache_size,
+          .session_cache_file = http::SessionCache::DefaultPath()});
+  if (!server.Listen()) {
+    return;
+  }
+  // Stopped by a signal, rather than killed, so the socket is removed
+  boost::asio::signal_set signals(ioc, SIGINT, SIGTERM);
+  signals.async_wait(
+      [&ioc](const boost::system::error_code&, int) { ioc.stop(); });
+  ioc.run();
+}
+
+void run_stats_cmd(const std::string& socket) {
+  std::optional<boost::json::object> stats = FetchStats(socket);
+  if (!stats) {
+    SPDLOG_ERROR("No rtool serve listening on {}", socket);
+    return;
+  }
+  PrettyPrint(std::cout, *stats);
+  std::cout << "\n";
+}
+
 void my_signal_handler(int signum) {
   ::signal(signum, SIG_DFL);
   boost::stacktrace::safe_dump_to("./backtrace.dump");
@@ -338,11 +498,67 @@ int main(int argc, char** argv) {
 
   app.add_option("--pass", host->password, "Password to use");
 
+  app.add_flag("--session-cache,!--no-session-cache", host->session_cache,
+               "Reuse sessions from earlier runs, and save new ones for "
+               "later runs");
+
   std::optional<uint16_t> port;
   app.add_option("--port", port, "Port to connect to");
 
   app.add_flag("--tls,!--no-tls", policy->use_tls, "Use TLS+HTTP");
 
+  app.add_option("--connections-per-host", policy->max_connections_per_host,
+                 "Most connections to open to each host")
+      ->check(CLI::Range(std::size_t{1}, std::size_t{http::kMaxPoolSize}));
+
+  app.add_flag("--adaptive-connections,!--no-adaptive-connections",
+               policy->adaptive_connections,
+               "Learn how many connections each host copes with, up to "
+               "--connections-per-host, rather than always opening that many");
+
+  app.add_flag("--prewarm,!--no-prewarm", policy->prewarm_connections,
+               "Open connections to a host up to its limit as soon as it's "
+               "first used, rather than one per request");
+
+  app.add_option_function<uint64_t>(
+      "--max-idle-time",
+      [policy](uint64_t seconds) {
+        policy->max_idle_time = std::chrono::seconds(seconds);
+      },
+      "Seconds a connection may sit idle before it's closed, so the host "
+      "can't close it first.  0 leaves idle connections open");
+
+  app.add_option("--max-in-flight", policy->max_requests_in_flight,
+                 "Requests outstanding at once across every host.  Requests "
+                 "past this wait for one to finish")
+      ->check(CLI::PositiveNumber);
+
+  app.add_option("--retries", policy->max_retries,
+                 "Times to retry a GET that failed, or was answered 503 or "
+                 "429");
+
+  app.add_option("--hedge-percentile", policy->hedge_percentile,
+                 "Send a GET again on another connection once it's taken "
+                 "longer than this percentile of the host's recent "
+                 "latencies, and use whichever answers first.  0 never "
+                 "hedges")
+      ->check(CLI::Range(0.0, 100.0));
+
+  app.add_option("--pipeline-depth", policy->pipeline_depth,
+                 "GETs sent down one connection without waiting for each "
+                 "other's responses, once every connection to a host is "
+                 "busy.  Hosts that mishandle it fall back to one at a "
+                 "time.  1 never pipelines")
+      ->check(CLI::PositiveNumber);
+
+  app.add_flag("--http2,!--no-http2", policy->http2,
+               "Offer HTTP/2, and send every request to hosts that take it "
+               "over one connection");
+
+  app.add_option("--breaker-threshold", policy->breaker_threshold,
+                 "Failed requests in a row after which a host is treated as "
+                 "down for a while.  0 never gives up on a host");
+
   app.add_flag("--verify_server,!--no-verify-server",
                policy->verify_server_certificate,
                "Verify the servers TLS certificate");
@@ -359,9 +575,74 @@ int main(int argc, char** argv) {
   raw_get->add_option("redpaths", raw_opt->redpaths,
                       "Gets a list of properties");
 
+  raw_get->add_option("--expand-levels", raw_opt->query.expand_levels,
+                      "Levels of links to expand inline when fetching "
+                      "collections, if the server supports $expand.  0 "
+                      "disables $expand");
+  raw_get->add_option("--hosts-file", raw_opt->hosts_file,
+                      "Query every host listed in this file, one per line as "
+                      "host[:port], instead of --host.  - reads stdin");
+  raw_get->add_option("--parallel-hosts",
+                      raw_opt->fleet.max_hosts_in_flight,
+                      "Hosts to query at the same time with --hosts-file");
+  raw_get->add_option("--threads", raw_opt->threads,
+                      "Threads to shard --hosts-file hosts across")
+      ->check(CLI::PositiveNumber);
+  raw_get->add_option("--cache-size", raw_opt->cache_size,
+                      "Number of responses to keep for reuse within the run.  "
+                      "0 only shares responses between identical requests in "
+                      "flight at the same time");
+  raw_get->add_flag("--select,!--no-select", raw_opt->query.select,
+                    "Ask for only the properties a redpath needs, if the "
+                    "server supports $select");
+  raw_get->add_option("--socket", raw_opt->socket,
+                      "Socket of the rtool serve to hand queries to");
+  raw_get->add_flag("--server,!--no-server", raw_opt->use_server,
+                    "Run single host queries through rtool serve, if it's "
+                    "running");
+  raw_get->add_option("--timings", raw_opt->timings,
+                      "Print percentiles of how long requests to each host "
+                      "spent queued, resolving, connecting, handshaking, "
+                      "waiting on the host and reading the body, as a table "
+                      "or json")
+      ->check(CLI::IsMember({"table", "json"}));
+  raw_get->add_option("--trace", raw_opt->trace,
+                      "Write a trace of every request, queue wait and "
+                      "connection to this file, for chrome://tracing or "
+                      "Perfetto");
+  raw_get->add_flag("--stats", raw_opt->stats,
+                    "Print counts of the requests, bytes, connections, "
+                    "handshakes, timeouts and queueing for each host as json "
+                    "once done");
+
   raw->callback(
       [raw_opt, policy, host]() { run_raw_get_cmd(*raw_opt, *policy, *host); });
 
+  CLI::App* logout =
+      app.add_subcommand("logout", "Delete the session with the host");
+  logout->callback([policy, host]() { run_logout_cmd(*policy, *host); });
+
+  auto serve_opt = std::make_shared<ServeOptions>();
+  CLI::App* serve = app.add_subcommand(
+      "serve",
+      "Keep connections and sessions open for later rtool runs to use");
+  serve->add_option("--socket", serve_opt->socket,
+                    "Unix socket to accept queries on");
+  serve->add_option("--cache-size", serve_opt->cache_size,
+                    "Number of responses to keep and serve to later queries.  "
+                    "0 only shares responses between identical requests in "
+                    "flight at the same time");
+  serve->callback(
+      [serve_opt, policy]() { run_serve_cmd(*serve_opt, *policy); });
+
+  auto stats_socket =
+      std::make_shared<std::string>(DefaultServerSocket().string());
+  CLI::App* stats = app.add_subcommand(
+      "stats", "Print the counters of a running rtool serve as json");
+  stats->add_option("--socket", *stats_socket,
+                    "Socket the rtool serve is listening on");
+  stats->callback([stats_socket]() { run_stats_cmd(*stats_socket); });
+
   // Make sure we get at least one subcommand
   app.require_subcommand();
 
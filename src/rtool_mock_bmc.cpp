@@ -0,0 +1,107 @@
+#include <spdlog/spdlog.h>
+
+#include <CLI/CLI.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "mock_bmc.hpp"
+
+int main(int argc, char** argv) {
+  CLI::App app{"Mock Redfish BMC, for testing and benchmarking rtool on "
+               "localhost"};
+
+  MockBmcOptions options;
+  std::string address = "127.0.0.1";
+  uint16_t port = 0;
+  bool verbose = false;
+
+  app.add_option("--address", address, "Address to listen on");
+  app.add_option("--port", port,
+                 "Port to listen on.  0 picks a free one, which is printed "
+                 "once listening");
+  app.add_option("--chassis", options.chassis, "Chassis in the tree");
+  app.add_option("--sensors", options.sensors_per_chassis,
+                 "Sensors in each chassis");
+  app.add_flag("--expand,!--no-expand", options.expand,
+               "Advertise and honour $expand");
+  app.add_flag("--select,!--no-select", options.select,
+               "Advertise and honour $select");
+  app.add_option_function<uint64_t>(
+      "--latency",
+      [&options](uint64_t ms) {
+        options.latency = std::chrono::milliseconds(ms);
+      },
+      "Milliseconds to hold back every response");
+  app.add_option_function<uint64_t>(
+      "--jitter",
+      [&options](uint64_t ms) {
+        options.jitter = std::chrono::milliseconds(ms);
+      },
+      "Up to this many more milliseconds to hold back each response, at "
+      "random");
+  app.add_option("--max-connections", options.max_connections,
+                 "Connections served at once.  Any more are closed as soon "
+                 "as they're accepted.  0 serves any number");
+  app.add_flag("--keep-alive,!--no-keep-alive", options.keep_alive,
+               "Keep connections open between requests");
+  app.add_flag("--tls,!--no-tls", options.use_tls,
+               "Serve HTTPS, with a self-signed certificate");
+  app.add_flag("--require-session", options.require_session,
+               "Answer 401 to requests without a session token");
+  app.add_option("--drop-after", options.drop_after_requests,
+                 "Drop each connection, unanswered, once this many requests "
+                 "have been answered on it.  0 never drops them");
+  app.add_option_function<uint64_t>(
+      "--idle-timeout",
+      [&options](uint64_t ms) {
+        options.idle_timeout = std::chrono::milliseconds(ms);
+      },
+      "Milliseconds a connection may wait for a request before it's closed.  "
+      "0 leaves it open");
+  app.add_option("--busy-requests", options.busy_requests,
+                 "Answer this many requests 503 before serving any");
+  app.add_option_function<uint64_t>(
+      "--retry-after",
+      [&options](uint64_t seconds) {
+        options.retry_after = std::chrono::seconds(seconds);
+      },
+      "Seconds to ask busy requests to wait before retrying.  0 leaves "
+      "Retry-After off");
+  app.add_option("--slow-every", options.slow_every,
+                 "Hold back every nth response for --slow-latency instead.  0 "
+                 "never does");
+  app.add_option_function<uint64_t>(
+      "--slow-latency",
+      [&options](uint64_t ms) {
+        options.slow_latency = std::chrono::milliseconds(ms);
+      },
+      "Milliseconds to hold back the responses picked by --slow-every");
+  app.add_flag("--verbose", verbose, "Log every request");
+
+  CLI11_PARSE(app, argc, argv);
+  spdlog::set_level(verbose ? spdlog::level::debug : spdlog::level::info);
+
+  boost::asio::io_context ioc;
+  MockBmc bmc(ioc, options);
+  if (!bmc.Listen(address, port)) {
+    return 1;
+  }
+  // On a line of its own, so scripts can read the port if it was picked
+  std::cout << bmc.Port() << std::endl;
+
+  boost::asio::signal_set signals(ioc, SIGINT, SIGTERM);
+  signals.async_wait(
+      [&ioc](const boost::system::error_code&, int) { ioc.stop(); });
+  ioc.run();
+
+  const MockBmcStats& stats = bmc.Stats();
+  SPDLOG_INFO("Served {} requests over {} connections, refused {}, {} logins",
+              stats.requests, stats.connections, stats.refused_connections,
+              stats.logins);
+  return 0;
+}
@@ -0,0 +1,210 @@
+#include "session_cache.hpp"
+
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <boost/json.hpp>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+namespace http {
+
+namespace {
+std::string_view GetString(const boost::json::object& obj,
+                           std::string_view key) {
+  const boost::json::value* value = obj.if_contains(key);
+  if (value == nullptr || !value->is_string()) {
+    return "";
+  }
+  return value->get_string();
+}
+
+bool WriteAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t written = ::write(fd, data.data(), data.size());
+    if (written < 0) {
+      return false;
+    }
+    data.remove_prefix(static_cast<std::size_t>(written));
+  }
+  return true;
+}
+
+// Holds an exclusive lock on the file at path, shared with other processes,
+// for as long as it's alive.  If the lock can't be had, it carries on
+// without one, as the worst that can happen is a lost session.
+class FileLock {
+ private:
+  int fd_;
+
+ public:
+  explicit FileLock(const std::filesystem::path& path)
+      : fd_(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)) {
+    if (fd_ < 0) {
+      SPDLOG_DEBUG("Failed to open lock {}", path.string());
+      return;
+    }
+    while (::flock(fd_, LOCK_EX) != 0) {
+      if (errno != EINTR) {
+        SPDLOG_DEBUG("Failed to lock {}", path.string());
+        return;
+      }
+    }
+  }
+
+  FileLock(const FileLock&) = delete;
+  FileLock& operator=(const FileLock&) = delete;
+  FileLock(FileLock&&) = delete;
+  FileLock& operator=(FileLock&&) = delete;
+
+  ~FileLock() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+};
+
+// Locks the cache at file against other runs changing it.  The cache itself
+// is replaced by rename, so the lock is held on a file beside it.
+FileLock LockCache(const std::filesystem::path& file) {
+  std::error_code ec;
+  std::filesystem::path dir = file.parent_path();
+  if (!dir.empty() && std::filesystem::create_directories(dir, ec)) {
+    std::filesystem::permissions(dir, std::filesystem::perms::owner_all, ec);
+  }
+  std::filesystem::path lock = file;
+  lock += ".lock";
+  return FileLock(lock);
+}
+}  // namespace
+
+SessionCache::SessionCache(std::filesystem::path file)
+    : file_(std::move(file)) {
+  Load();
+}
+
+std::filesystem::path SessionCache::DefaultPath() {
+  std::filesystem::path dir;
+  const char* xdg_cache = std::getenv("XDG_CACHE_HOME");
+  const char* home = std::getenv("HOME");
+  if (xdg_cache != nullptr && *xdg_cache != '\0') {
+    dir = xdg_cache;
+  } else if (home != nullptr && *home != '\0') {
+    dir = std::filesystem::path(home) / ".cache";
+  } else {
+    dir = std::filesystem::temp_directory_path();
+  }
+  return dir / "rtool" / "sessions.json";
+}
+
+void SessionCache::Load() {
+  sessions_.clear();
+  std::error_code ec;
+  std::filesystem::file_status status = std::filesystem::status(file_, ec);
+  if (ec || !std::filesystem::is_regular_file(status)) {
+    return;
+  }
+  constexpr std::filesystem::perms kNotOwner =
+      std::filesystem::perms::group_all | std::filesystem::perms::others_all;
+  if ((status.permissions() & kNotOwner) != std::filesystem::perms::none) {
+    SPDLOG_ERROR("Ignoring session cache {}, it's readable by other users",
+                 file_.string());
+    return;
+  }
+
+  std::ifstream in(file_);
+  std::string contents((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  boost::system::error_code parse_ec;
+  boost::json::value root = boost::json::parse(contents, parse_ec);
+  if (parse_ec || !root.is_object()) {
+    SPDLOG_DEBUG("Ignoring malformed session cache {}", file_.string());
+    return;
+  }
+  for (const boost::json::key_value_pair& entry : root.get_object()) {
+    if (!entry.value().is_object()) {
+      continue;
+    }
+    const boost::json::object& session = entry.value().get_object();
+    std::string_view token = GetString(session, "token");
+    if (token.empty()) {
+      continue;
+    }
+    sessions_.insert_or_assign(
+        std::string(entry.key()),
+        Session{.token = std::string(token),
+                .location = std::string(GetString(session, "location"))});
+  }
+}
+
+void SessionCache::Save() const {
+  std::error_code ec;
+  boost::json::object root;
+  for (const auto& [key, session] : sessions_) {
+    root[key] = boost::json::object{{"token", session.token},
+                                    {"location", session.location}};
+  }
+  std::string contents = boost::json::serialize(root);
+
+  // Written to a temporary file and renamed over the cache, so that a
+  // concurrent run never sees a partially written file.  The file is created
+  // 0600, rather than having its mode fixed up afterwards, so the tokens are
+  // never readable by anyone else.
+  std::filesystem::path tmp = file_;
+  tmp += ".tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    SPDLOG_ERROR("Failed to write session cache {}", tmp.string());
+    return;
+  }
+  bool written = WriteAll(fd, contents);
+  ::close(fd);
+  if (!written) {
+    SPDLOG_ERROR("Failed to write session cache {}", tmp.string());
+    std::filesystem::remove(tmp, ec);
+    return;
+  }
+  std::filesystem::rename(tmp, file_, ec);
+  if (ec) {
+    SPDLOG_ERROR("Failed to replace session cache {}", file_.string());
+    std::filesystem::remove(tmp, ec);
+  }
+}
+
+std::optional<Session> SessionCache::Find(std::string_view key) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = sessions_.find(key);
+  if (it == sessions_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+// Each change is made to what's in the file now, rather than to what was
+// read when the cache was made, so that other runs' changes are kept
+void SessionCache::Store(std::string_view key, const Session& session) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FileLock file_lock = LockCache(file_);
+  Load();
+  sessions_.insert_or_assign(std::string(key), session);
+  Save();
+}
+
+void SessionCache::Erase(std::string_view key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FileLock file_lock = LockCache(file_);
+  Load();
+  auto it = sessions_.find(key);
+  if (it == sessions_.end()) {
+    return;
+  }
+  sessions_.erase(it);
+  Save();
+}
+
+}  // namespace http
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace http {
+
+// A Redfish session created through the SessionService
+struct Session {
+  std::string token;
+  // URI of the session resource, which is deleted to log out
+  std::string location;
+};
+
+// Persists session tokens between invocations, so that back to back runs
+// against the same host reuse a session instead of logging in again.  The
+// file holds credentials, so it's only ever written readable by its owner,
+// and a file that's readable by anyone else is ignored.
+//
+// One cache may be shared by clients running on different threads.  Runs
+// sharing the file each merge their changes into it, under a lock on a file
+// beside it, so none of them loses the sessions the others stored.
+class SessionCache {
+ private:
+  std::filesystem::path file_;
+  mutable std::mutex mutex_;
+  std::map<std::string, Session, std::less<> > sessions_;
+
+  // Replaces sessions_ with what's in the file
+  void Load();
+  void Save() const;
+
+ public:
+  explicit SessionCache(std::filesystem::path file);
+
+  // $XDG_CACHE_HOME/rtool/sessions.json, falling back to ~/.cache
+  static std::filesystem::path DefaultPath();
+
+  std::optional<Session> Find(std::string_view key) const;
+
+  void Store(std::string_view key, const Session& session);
+
+  void Erase(std::string_view key);
+};
+
+}  // namespace http
@@ -0,0 +1,76 @@
+#include "session_cache.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+
+#include "gmock/gmock.h"
+
+namespace http {
+namespace {
+
+class SessionCacheTest : public ::testing::Test {
+ protected:
+  std::filesystem::path dir_ = std::filesystem::temp_directory_path() /
+                               ::testing::UnitTest::GetInstance()
+                                   ->current_test_info()
+                                   ->name();
+  std::filesystem::path file_ = dir_ / "rtool" / "sessions.json";
+
+  void TearDown() override { std::filesystem::remove_all(dir_); }
+};
+
+TEST_F(SessionCacheTest, PersistsAcrossInstances) {
+  {
+    SessionCache cache(file_);
+    EXPECT_EQ(cache.Find("root@https://bmc:443"), std::nullopt);
+    cache.Store("root@https://bmc:443",
+                Session{.token = "abc",
+                        .location = "/redfish/v1/SessionService/Sessions/1"});
+  }
+  SessionCache cache(file_);
+  std::optional<Session> session = cache.Find("root@https://bmc:443");
+  ASSERT_TRUE(session);
+  EXPECT_EQ(session->token, "abc");
+  EXPECT_EQ(session->location, "/redfish/v1/SessionService/Sessions/1");
+
+  cache.Erase("root@https://bmc:443");
+  EXPECT_EQ(SessionCache(file_).Find("root@https://bmc:443"), std::nullopt);
+}
+
+TEST_F(SessionCacheTest, KeepsOtherInstancesSessions) {
+  // Two runs at once, each storing a session the other hasn't seen
+  SessionCache first(file_);
+  SessionCache second(file_);
+  first.Store("root@https://bmc1:443", Session{.token = "abc"});
+  second.Store("root@https://bmc2:443", Session{.token = "def"});
+  first.Erase("root@https://bmc1:443");
+
+  SessionCache cache(file_);
+  EXPECT_EQ(cache.Find("root@https://bmc1:443"), std::nullopt);
+  std::optional<Session> session = cache.Find("root@https://bmc2:443");
+  ASSERT_TRUE(session);
+  EXPECT_EQ(session->token, "def");
+}
+
+TEST_F(SessionCacheTest, FileIsOnlyReadableByOwner) {
+  SessionCache cache(file_);
+  cache.Store("root@https://bmc:443", Session{.token = "abc"});
+  EXPECT_EQ(std::filesystem::status(file_).permissions() &
+                std::filesystem::perms::all,
+            std::filesystem::perms::owner_read |
+                std::filesystem::perms::owner_write);
+}
+
+TEST_F(SessionCacheTest, IgnoresFileReadableByOthers) {
+  {
+    SessionCache cache(file_);
+    cache.Store("root@https://bmc:443", Session{.token = "abc"});
+  }
+  std::filesystem::permissions(file_, std::filesystem::perms::others_read,
+                               std::filesystem::perm_options::add);
+  EXPECT_EQ(SessionCache(file_).Find("root@https://bmc:443"), std::nullopt);
+}
+
+}  // namespace
+}  // namespace http
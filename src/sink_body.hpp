@@ -0,0 +1,78 @@
+#pragma once
+
+#include <boost/beast/core/buffers_range.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+#include <boost/system/error_code.hpp>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace http {
+
+using ResponseHeader = boost::beast::http::response_header<>;
+
+// Receives the response body in chunks as they come off the socket.  Setting
+// ec aborts the read.
+using BodySink =
+    std::function<void(const ResponseHeader& header, std::string_view chunk,
+                       boost::system::error_code& ec)>;
+
+// A response body that either hands each chunk to a BodySink as it arrives,
+// or, if no sink is set, buffers it into a string like string_body.
+struct SinkBody {
+  struct value_type {
+    std::string buffered;
+    BodySink sink;
+  };
+
+  class reader {
+    const ResponseHeader* header_ = nullptr;
+    value_type& body_;
+
+   public:
+    // Beast requires readers to be constructible from request headers too,
+    // but only responses are ever read through this body
+    template <bool IsRequest, class Fields>
+    reader(boost::beast::http::header<IsRequest, Fields>& h, value_type& b)
+        : body_(b) {
+      if constexpr (!IsRequest) {
+        header_ = &h;
+      }
+    }
+
+    void init(const boost::optional<std::uint64_t>& length,
+              boost::system::error_code& ec) {
+      ec = {};
+      if (!body_.sink && length) {
+        body_.buffered.reserve(static_cast<std::size_t>(*length));
+      }
+    }
+
+    template <class ConstBufferSequence>
+    std::size_t put(const ConstBufferSequence& buffers,
+                    boost::system::error_code& ec) {
+      ec = {};
+      std::size_t bytes = 0;
+      for (const auto buffer : boost::beast::buffers_range_ref(buffers)) {
+        std::string_view chunk(static_cast<const char*>(buffer.data()),
+                               buffer.size());
+        if (body_.sink && header_ != nullptr) {
+          body_.sink(*header_, chunk, ec);
+          if (ec) {
+            return bytes;
+          }
+        } else {
+          body_.buffered += chunk;
+        }
+        bytes += chunk.size();
+      }
+      return bytes;
+    }
+
+    static void finish(boost::system::error_code& ec) { ec = {}; }
+  };
+};
+
+}  // namespace http
@@ -0,0 +1,165 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <boost/json.hpp>
+#include <format>
+#include <ostream>
+
+namespace http {
+
+namespace {
+
+double Micros(Tracer::Clock::duration duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+}  // namespace
+
+Tracer::Tracer(std::string name) : name_(std::move(name)) {}
+
+uint64_t Tracer::AcquireLane(std::string_view kind) {
+  std::vector<uint64_t>& free = freeLanes_[std::string(kind)];
+  if (!free.empty()) {
+    // The lowest numbered first, so the busy lanes stay at the top
+    auto lowest = std::min_element(free.begin(), free.end());
+    uint64_t lane = *lowest;
+    free.erase(lowest);
+    return lane;
+  }
+  std::size_t& count = laneCounts_[std::string(kind)];
+  count++;
+  tracks_.push_back(
+      Track{.kind = std::string(kind), .name = std::format("{} {}", kind, count)});
+  return tracks_.size();
+}
+
+void Tracer::ReleaseLane(uint64_t lane) {
+  if (lane == 0 || lane > tracks_.size()) {
+    return;
+  }
+  freeLanes_[tracks_[lane - 1].kind].push_back(lane);
+}
+
+void Tracer::Span(uint64_t track, std::string_view category,
+                  std::string_view name, Clock::time_point start,
+                  Clock::time_point end, std::string_view detail) {
+  events_.push_back(Event{.phase = 'X',
+                          .category = category,
+                          .name = std::string(name),
+                          .start = start,
+                          .duration = std::max(end - start, Clock::duration{}),
+                          .track = track,
+                          .detail = std::string(detail)});
+}
+
+void Tracer::Instant(uint64_t track, std::string_view category,
+                     std::string_view name, Clock::time_point at,
+                     std::string_view detail) {
+  events_.push_back(Event{.phase = 'i',
+                          .category = category,
+                          .name = std::string(name),
+                          .start = at,
+                          .track = track,
+                          .detail = std::string(detail)});
+}
+
+void Tracer::Flow(uint64_t from, uint64_t to, Clock::time_point at) {
+  if (from == 0 || to == 0) {
+    return;
+  }
+  uint64_t flow = nextFlow_++;
+  events_.push_back(Event{.phase = 's',
+                          .category = "flow",
+                          .name = "caused",
+                          .start = at,
+                          .track = from,
+                          .flow = flow});
+  events_.push_back(Event{.phase = 'f',
+                          .category = "flow",
+                          .name = "caused",
+                          .start = at,
+                          .track = to,
+                          .flow = flow});
+}
+
+Tracer::LaneScope::LaneScope(Tracer* tracer, uint64_t lane) : tracer_(tracer) {
+  if (tracer_ != nullptr) {
+    previous_ = tracer_->currentLane_;
+    tracer_->currentLane_ = lane;
+  }
+}
+
+Tracer::LaneScope::~LaneScope() {
+  if (tracer_ != nullptr) {
+    tracer_->currentLane_ = previous_;
+  }
+}
+
+void Tracer::Write(std::ostream& os, const std::vector<const Tracer*>& tracers) {
+  Clock::time_point epoch = Clock::time_point::max();
+  for (const Tracer* tracer : tracers) {
+    epoch = std::min(epoch, tracer->started_);
+  }
+  // Written an event at a time, as a long run can record a lot of them
+  os << R"({"displayTimeUnit":"ms","traceEvents":[)";
+  bool first = true;
+  auto write = [&os, &first](const boost::json::object& event) {
+    if (!first) {
+      os << ",\n";
+    }
+    first = false;
+    os << boost::json::serialize(event);
+  };
+  for (std::size_t index = 0; index < tracers.size(); index++) {
+    const Tracer& tracer = *tracers[index];
+    uint64_t pid = index + 1;
+    write({{"ph", "M"},
+           {"name", "process_name"},
+           {"pid", pid},
+           {"args", {{"name", tracer.name_}}}});
+    for (std::size_t track = 1; track <= tracer.tracks_.size(); track++) {
+      write({{"ph", "M"},
+             {"name", "thread_name"},
+             {"pid", pid},
+             {"tid", track},
+             {"args", {{"name", tracer.tracks_[track - 1].name}}}});
+      write({{"ph", "M"},
+             {"name", "thread_sort_index"},
+             {"pid", pid},
+             {"tid", track},
+             {"args", {{"sort_index", track}}}});
+    }
+    for (const Event& event : tracer.events_) {
+      boost::json::object out{{"ph", std::string_view(&event.phase, 1)},
+                              {"cat", event.category},
+                              {"name", event.name},
+                              {"ts", Micros(event.start - epoch)},
+                              {"pid", pid},
+                              {"tid", event.track}};
+      switch (event.phase) {
+        case 'X':
+          out["dur"] = Micros(event.duration);
+          break;
+        case 'i':
+          // Drawn on its own track rather than across the whole process
+          out["s"] = "t";
+          break;
+        case 'f':
+          // Bound to the span that starts at the arrow's end
+          out["bp"] = "e";
+          out["id"] = event.flow;
+          break;
+        default:
+          out["id"] = event.flow;
+          break;
+      }
+      if (!event.detail.empty()) {
+        out["args"] = {{"detail", event.detail}};
+      }
+      write(out);
+    }
+  }
+  os << "]}\n";
+}
+
+}  // namespace http
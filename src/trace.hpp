@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace http {
+
+// Records what a client and the queries using it did, as spans on tracks,
+// and writes them out in the Chrome trace event format that
+// chrome://tracing and Perfetto open.
+//
+// Concurrent work gets a lane each: a track taken while the work runs and
+// handed back after, so spans on one track never overlap and lanes are
+// reused rather than one track being made per request.  Flows draw an arrow
+// from the work that caused something to the work it caused.
+//
+// Not thread safe.  Each io_context gets its own Tracer, and they're
+// written out together.
+class Tracer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+ private:
+  struct Event {
+    // 'X' for a span, 'i' for an instant, 's' and 'f' for the two ends of a
+    // flow
+    char phase;
+    std::string_view category;
+    std::string name;
+    Clock::time_point start;
+    Clock::duration duration{};
+    uint64_t track;
+    uint64_t flow = 0;
+    std::string detail;
+  };
+
+  std::string name_;
+  Clock::time_point started_ = Clock::now();
+  std::vector<Event> events_;
+  struct Track {
+    std::string kind;
+    std::string name;
+  };
+  // Indexed by track - 1
+  std::vector<Track> tracks_;
+  // Lanes of each kind not in use, and how many of each kind there are
+  std::unordered_map<std::string, std::vector<uint64_t> > freeLanes_;
+  std::unordered_map<std::string, std::size_t> laneCounts_;
+  uint64_t nextFlow_ = 1;
+  // The lane of the work currently running, if it's said (see LaneScope)
+  uint64_t currentLane_ = 0;
+
+ public:
+  // name labels this tracer's events in the viewer
+  explicit Tracer(std::string name);
+
+  // Takes a lane of kind that's not in use, making a new one if they all
+  // are.  Lanes are numbered from 1, and 0 is never a lane.
+  uint64_t AcquireLane(std::string_view kind);
+
+  void ReleaseLane(uint64_t lane);
+
+  // Records a span of work on track from start to end.  category must
+  // outlive the tracer.
+  void Span(uint64_t track, std::string_view category, std::string_view name,
+            Clock::time_point start, Clock::time_point end,
+            std::string_view detail = {});
+
+  void Instant(uint64_t track, std::string_view category,
+               std::string_view name, Clock::time_point at,
+               std::string_view detail = {});
+
+  // Links the span running on from at time at to the one starting on to at
+  // the same time
+  void Flow(uint64_t from, uint64_t to, Clock::time_point at);
+
+  // The lane set by the innermost LaneScope, or 0
+  uint64_t CurrentLane() const { return currentLane_; }
+
+  // Says which lane's work is running, for code called from it that
+  // doesn't otherwise know (see Client::SendData)
+  class LaneScope {
+   private:
+    Tracer* tracer_;
+    uint64_t previous_ = 0;
+
+   public:
+    // tracer may be null, in which case this does nothing
+    LaneScope(Tracer* tracer, uint64_t lane);
+    ~LaneScope();
+
+    LaneScope(const LaneScope&) = delete;
+    LaneScope& operator=(const LaneScope&) = delete;
+    LaneScope(LaneScope&&) = delete;
+    LaneScope& operator=(LaneScope&&) = delete;
+  };
+
+  // Writes tracers as one trace, each as its own process, with times
+  // relative to the earliest of them
+  static void Write(std::ostream& os, const std::vector<const Tracer*>& tracers);
+};
+
+}  // namespace http
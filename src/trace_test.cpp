@@ -0,0 +1,93 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <boost/json.hpp>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+namespace http {
+namespace {
+
+using std::chrono::milliseconds;
+
+TEST(Tracer, ReusesReleasedLanes) {
+  Tracer tracer("test");
+  uint64_t first = tracer.AcquireLane("request");
+  uint64_t second = tracer.AcquireLane("request");
+  uint64_t connection = tracer.AcquireLane("connection");
+  EXPECT_NE(first, 0U);
+  EXPECT_NE(first, second);
+  EXPECT_NE(second, connection);
+
+  tracer.ReleaseLane(first);
+  // Only reused by the same kind of work
+  EXPECT_NE(tracer.AcquireLane("connection"), first);
+  EXPECT_EQ(tracer.AcquireLane("request"), first);
+}
+
+TEST(Tracer, ScopesNest) {
+  Tracer tracer("test");
+  EXPECT_EQ(tracer.CurrentLane(), 0U);
+  {
+    Tracer::LaneScope outer(&tracer, 1);
+    {
+      Tracer::LaneScope inner(&tracer, 2);
+      EXPECT_EQ(tracer.CurrentLane(), 2U);
+    }
+    EXPECT_EQ(tracer.CurrentLane(), 1U);
+  }
+  EXPECT_EQ(tracer.CurrentLane(), 0U);
+  // Does nothing without a tracer
+  Tracer::LaneScope none(nullptr, 3);
+}
+
+TEST(Tracer, WritesTraceEvents) {
+  Tracer tracer("rtool");
+  Tracer::Clock::time_point start = Tracer::Clock::now();
+  uint64_t parent = tracer.AcquireLane("request");
+  uint64_t child = tracer.AcquireLane("request");
+  tracer.Span(parent, "request", "GET /redfish/v1", start,
+              start + milliseconds(10), "200");
+  tracer.Flow(parent, child, start + milliseconds(5));
+  tracer.Span(child, "request", "GET /redfish/v1/Chassis",
+              start + milliseconds(5), start + milliseconds(20));
+  tracer.Instant(child, "connection", "closed", start + milliseconds(20));
+
+  std::ostringstream out;
+  Tracer::Write(out, {&tracer});
+  boost::system::error_code ec;
+  boost::json::value trace = boost::json::parse(out.str(), ec);
+  ASSERT_FALSE(ec) << out.str();
+  const boost::json::array& events =
+      trace.as_object().at("traceEvents").as_array();
+
+  std::vector<std::string> phases;
+  for (const boost::json::value& event : events) {
+    const boost::json::object& object = event.as_object();
+    std::string phase(object.at("ph").as_string());
+    phases.push_back(phase);
+    if (phase == "X" && object.at("name").as_string() == "GET /redfish/v1") {
+      EXPECT_EQ(object.at("tid").to_number<uint64_t>(), parent);
+      EXPECT_DOUBLE_EQ(object.at("dur").as_double(), 10000.0);
+      EXPECT_EQ(object.at("args").as_object().at("detail").as_string(),
+                "200");
+    }
+    if (phase == "f") {
+      EXPECT_EQ(object.at("tid").to_number<uint64_t>(), child);
+      EXPECT_EQ(object.at("bp").as_string(), "e");
+    }
+  }
+  // A process name, then a name and sort index for each lane
+  EXPECT_EQ(std::count(phases.begin(), phases.end(), "M"), 5);
+  EXPECT_EQ(std::count(phases.begin(), phases.end(), "X"), 2);
+  EXPECT_EQ(std::count(phases.begin(), phases.end(), "s"), 1);
+  EXPECT_EQ(std::count(phases.begin(), phases.end(), "f"), 1);
+  EXPECT_EQ(std::count(phases.begin(), phases.end(), "i"), 1);
+}
+
+}  // namespace
+}  // namespace http